@@ -0,0 +1,818 @@
+// Compile-time and runtime benchmark of the compiler.
+//
+// Every input is compiled in a forked child process, so that the peak
+// resident set size (getrusage's ru_maxrss, a high-water mark) belongs to
+// that one input. The child times each phase (lexing, parsing, AST
+// building, IR generation, every pass of the pipeline, emission), records
+// the peak RSS after each of them and how much the phase raised it, and
+// reports back over a pipe. With --run, the emitted IR of the functional
+// tests is linked against sylib.c and executed, and the TOTAL line that
+// sylib prints at exit is collected. Results are written as JSON.
+
+#include "ASTBuilder.h"
+#include "FastLexer.h"
+#include "FastParser.h"
+#include "IRGen.h"
+#include "IRPrinter.h"
+#include "PassManager.h"
+#include "SourceFile.h"
+#include "SysYLexer.h"
+#include "SysYParser.h"
+#include "antlr4-runtime.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+long peakRssKB() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+struct Options {
+  unsigned optLevel = 2;
+  bool fastFrontend = false;
+  unsigned repeat = 1;
+  std::vector<unsigned> scales{10, 100};
+  bool run = false;
+  std::string cc = "clang";
+  std::string testDir = "test/resources/functional";
+  std::string sylib = "test/resources/sylib.c";
+  std::string workDir = "benchmark-out";
+  std::string output;
+  std::string filter;
+};
+
+struct Input {
+  std::string name;
+  std::string path;
+  // "functional" or "synthetic"; only functional tests have expected output.
+  const char *kind;
+  unsigned scale;
+};
+
+//===----------------------------------------------------------------------===//
+// Synthetic inputs
+//===----------------------------------------------------------------------===//
+
+// The programs that are scaled up into stress inputs.
+const char *const kStressSeeds[] = {"83_long_array", "85_long_code",
+                                    "89_many_globals"};
+
+bool isRuntimeName(std::string_view name) {
+  static const char *const kNames[] = {"getint",   "getch",     "getarray",
+                                       "putint",   "putch",     "putarray",
+                                       "starttime", "stoptime"};
+  for (const char *n : kNames)
+    if (name == n)
+      return true;
+  return false;
+}
+
+// Makes `copies` copies of a program, renaming every identifier except the
+// runtime functions with a per-copy suffix, and adds a main that runs the
+// copies' mains in turn. Renaming all identifiers consistently, locals
+// included, keeps each copy's meaning.
+std::string scaleProgram(std::string_view source, unsigned copies) {
+  std::string out;
+  out.reserve(source.size() * copies + 64 + 24 * copies);
+  for (unsigned k = 0; k < copies; ++k) {
+    std::string suffix = "_s" + std::to_string(k);
+    FastLexer lexer(source);
+    size_t copied = 0;
+    for (Token tok = lexer.next(); tok.kind != TokenKind::Eof;
+         tok = lexer.next()) {
+      if (tok.kind != TokenKind::Ident || isRuntimeName(tok.text))
+        continue;
+      size_t end = tok.text.data() - source.data() + tok.text.size();
+      out.append(source.substr(copied, end - copied));
+      out += suffix;
+      copied = end;
+    }
+    out.append(source.substr(copied));
+    out += '\n';
+  }
+  out += "int main() {\n";
+  for (unsigned k = 0; k + 1 < copies; ++k)
+    out += "  main_s" + std::to_string(k) + "();\n";
+  out += "  return main_s" + std::to_string(copies - 1) + "();\n}\n";
+  return out;
+}
+
+bool readFile(const std::string &path, std::string &contents) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  contents = ss.str();
+  return true;
+}
+
+bool writeFile(const std::string &path, std::string_view contents) {
+  std::ofstream out(path, std::ios::binary);
+  out.write(contents.data(), contents.size());
+  return static_cast<bool>(out);
+}
+
+//===----------------------------------------------------------------------===//
+// Compiling one input (in the child process)
+//===----------------------------------------------------------------------===//
+
+// Statistics of one phase or pass. Memory is the peak RSS after it and how
+// much it raised the peak.
+struct PhaseResult {
+  std::string name;
+  double seconds = 0;
+  long peakKB = 0;
+  long growthKB = 0;
+  // Pipeline entries only.
+  unsigned runs = 0;
+  unsigned changed = 0;
+  uint64_t instsBefore = 0;
+  uint64_t instsAfter = 0;
+};
+
+struct CompileResult {
+  bool ok = false;
+  std::string error;
+  double seconds = 0;
+  long peakKB = 0;
+  std::vector<PhaseResult> phases;
+  std::vector<PhaseResult> passes;
+};
+
+class PhaseRecorder {
+public:
+  explicit PhaseRecorder(CompileResult &result)
+      : result_(result), lastPeak_(peakRssKB()) {}
+
+  void start() { start_ = Clock::now(); }
+  void finish(const char *name) {
+    PhaseResult p;
+    p.name = name;
+    p.seconds = secondsSince(start_);
+    p.peakKB = peakRssKB();
+    p.growthKB = p.peakKB - lastPeak_;
+    lastPeak_ = p.peakKB;
+    result_.phases.push_back(p);
+  }
+  long lastPeak() const { return lastPeak_; }
+  void setLastPeak(long kb) { lastPeak_ = kb; }
+
+private:
+  CompileResult &result_;
+  Clock::time_point start_;
+  long lastPeak_;
+};
+
+CompUnit *parseWithAntlr(const std::string &path, ASTContext &ctx,
+                         PhaseRecorder &rec, std::string &error) {
+  std::ifstream in(path);
+  if (!in) {
+    error = "cannot open " + path;
+    return nullptr;
+  }
+  rec.start();
+  antlr4::ANTLRInputStream input(in);
+  SysYLexer lexer(&input);
+  lexer.removeErrorListeners();
+  antlr4::CommonTokenStream tokens(&lexer);
+  tokens.fill();
+  rec.finish("lex");
+  rec.start();
+  SysYParser parser(&tokens);
+  parser.removeErrorListeners();
+  SysYParser::ProgramContext *tree = parser.program();
+  rec.finish("parse");
+  if (lexer.getNumberOfSyntaxErrors() || parser.getNumberOfSyntaxErrors()) {
+    error = "syntax error";
+    return nullptr;
+  }
+  rec.start();
+  CompUnit *unit = ASTBuilder(ctx).build(tree);
+  rec.finish("ast");
+  return unit;
+}
+
+// The fast front end lexes on demand while it builds the AST, so "lex" is
+// a separate scan of the whole file and "parse" covers parsing and AST
+// building together.
+CompUnit *parseWithFastFrontend(const std::string &path, SourceFile &source,
+                                ASTContext &ctx, PhaseRecorder &rec,
+                                std::string &error) {
+  if (!source.open(path.c_str(), error))
+    return nullptr;
+  rec.start();
+  FastLexer lexer(source.contents());
+  while (lexer.next().kind != TokenKind::Eof)
+    ;
+  rec.finish("lex");
+  rec.start();
+  CompUnit *unit = FastParser(source.contents(), ctx).parse(error);
+  rec.finish("parse");
+  return unit;
+}
+
+CompileResult compileInput(const Options &opts, const Input &input,
+                           const std::string &output) {
+  CompileResult result;
+  Clock::time_point start = Clock::now();
+  PhaseRecorder rec(result);
+  SourceFile source;
+  ASTContext astContext;
+  CompUnit *unit =
+      opts.fastFrontend
+          ? parseWithFastFrontend(input.path, source, astContext, rec,
+                                  result.error)
+          : parseWithAntlr(input.path, astContext, rec, result.error);
+  if (!unit)
+    return result;
+
+  rec.start();
+  Module module;
+  try {
+    IRGen(module).run(unit);
+  } catch (const CompileError &e) {
+    result.error = e.what();
+    return result;
+  }
+  rec.finish("irgen");
+
+  PassManager passes;
+  buildPipeline(passes, opts.optLevel);
+  passes.setTimePasses(true);
+  std::vector<PhaseResult> passResults(passes.getNumEntries());
+  passes.setAfterPassCallback([&](size_t entry) {
+    long peak = peakRssKB();
+    passResults[entry].peakKB = peak;
+    passResults[entry].growthKB += peak - rec.lastPeak();
+    rec.setLastPeak(peak);
+  });
+  rec.start();
+  passes.run(module);
+  rec.finish("optimize");
+  for (size_t i = 0; i < passes.getNumEntries(); ++i) {
+    const PassManager::Stats &s = passes.getEntryStats(i);
+    PhaseResult &p = passResults[i];
+    p.name = passes.getEntryName(i);
+    p.seconds = s.seconds;
+    p.runs = s.runs;
+    p.changed = s.changed;
+    p.instsBefore = s.instsBefore;
+    p.instsAfter = s.instsAfter;
+  }
+  // The callback has moved the baseline past every pass, so the growth of
+  // "optimize" is only what the pass manager itself added.
+  result.passes = std::move(passResults);
+
+  rec.start();
+  std::string text;
+  printModule(module, text);
+  if (!writeFile(output, text)) {
+    result.error = "cannot write " + output;
+    return result;
+  }
+  rec.finish("emit");
+
+  result.ok = true;
+  result.seconds = secondsSince(start);
+  result.peakKB = peakRssKB();
+  return result;
+}
+
+// The child reports one record per line; names never contain spaces.
+void writeResult(const CompileResult &r, std::ostream &out) {
+  out.precision(9);
+  for (const PhaseResult &p : r.phases)
+    out << "phase " << p.name << ' ' << p.seconds << ' ' << p.peakKB << ' '
+        << p.growthKB << '\n';
+  for (const PhaseResult &p : r.passes)
+    out << "pass " << p.name << ' ' << p.seconds << ' ' << p.peakKB << ' '
+        << p.growthKB << ' ' << p.runs << ' ' << p.changed << ' '
+        << p.instsBefore << ' ' << p.instsAfter << '\n';
+  if (r.ok)
+    out << "total " << r.seconds << ' ' << r.peakKB << '\n';
+  else
+    out << "error " << r.error << '\n';
+}
+
+CompileResult readResult(std::istream &in) {
+  CompileResult r;
+  std::string line;
+  r.error = "compiler crashed";
+  while (std::getline(in, line)) {
+    std::istringstream ss(line);
+    std::string tag;
+    ss >> tag;
+    PhaseResult p;
+    if (tag == "phase") {
+      ss >> p.name >> p.seconds >> p.peakKB >> p.growthKB;
+      r.phases.push_back(p);
+    } else if (tag == "pass") {
+      ss >> p.name >> p.seconds >> p.peakKB >> p.growthKB >> p.runs >>
+          p.changed >> p.instsBefore >> p.instsAfter;
+      r.passes.push_back(p);
+    } else if (tag == "total") {
+      ss >> r.seconds >> r.peakKB;
+      r.ok = true;
+      r.error.clear();
+    } else if (tag == "error") {
+      std::getline(ss >> std::ws, r.error);
+    }
+  }
+  return r;
+}
+
+CompileResult compileInChild(const Options &opts, const Input &input,
+                             const std::string &output) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    CompileResult r;
+    r.error = "pipe failed";
+    return r;
+  }
+  std::cout.flush();
+  std::cerr.flush();
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    std::ostringstream ss;
+    writeResult(compileInput(opts, input, output), ss);
+    std::string text = ss.str();
+    for (size_t done = 0; done < text.size();) {
+      ssize_t n = write(fds[1], text.data() + done, text.size() - done);
+      if (n <= 0)
+        break;
+      done += n;
+    }
+    _exit(0);
+  }
+  close(fds[1]);
+  std::string text;
+  char buf[4096];
+  for (ssize_t n; (n = read(fds[0], buf, sizeof(buf))) > 0;)
+    text.append(buf, n);
+  close(fds[0]);
+  int status = 0;
+  if (pid > 0)
+    waitpid(pid, &status, 0);
+  std::istringstream in(text);
+  return readResult(in);
+}
+
+// Keeps the fastest time and the largest memory figures of the repeats.
+void mergeRepeat(CompileResult &best, const CompileResult &r) {
+  auto merge = [](std::vector<PhaseResult> &a,
+                  const std::vector<PhaseResult> &b) {
+    for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+      a[i].seconds = std::min(a[i].seconds, b[i].seconds);
+      a[i].peakKB = std::max(a[i].peakKB, b[i].peakKB);
+      a[i].growthKB = std::max(a[i].growthKB, b[i].growthKB);
+    }
+  };
+  merge(best.phases, r.phases);
+  merge(best.passes, r.passes);
+  best.seconds = std::min(best.seconds, r.seconds);
+  best.peakKB = std::max(best.peakKB, r.peakKB);
+}
+
+//===----------------------------------------------------------------------===//
+// Running the compiled program
+//===----------------------------------------------------------------------===//
+
+struct RunResult {
+  bool built = false;
+  int exitCode = -1;
+  bool correct = false;
+  double seconds = 0;
+  // The TOTAL line of sylib's timer, or -1 if the program printed none.
+  int64_t totalMicroseconds = -1;
+};
+
+std::string quote(const std::string &s) {
+  std::string q = "'";
+  for (char c : s) {
+    if (c == '\'')
+      q += "'\\''";
+    else
+      q += c;
+  }
+  return q + "'";
+}
+
+// Trailing whitespace on each line and trailing empty lines are ignored, as
+// in run-test.py.
+std::string normalizeOutput(const std::string &s) {
+  std::vector<std::string> lines;
+  std::istringstream in(s);
+  for (std::string line; std::getline(in, line);) {
+    line.erase(line.find_last_not_of(" \t\r\n") + 1);
+    lines.push_back(line);
+  }
+  while (!lines.empty() && lines.back().empty())
+    lines.pop_back();
+  std::string out;
+  for (const std::string &line : lines)
+    out += line + '\n';
+  return out;
+}
+
+RunResult runProgram(const Options &opts, const Input &input,
+                     const std::string &ll) {
+  RunResult r;
+  std::string base = opts.workDir + "/" + input.name;
+  std::string exe = base + ".bin";
+  std::string build = opts.cc + " -w " + quote(ll) + " " + quote(opts.sylib) +
+                      " -o " + quote(exe);
+  if (std::system(build.c_str()) != 0)
+    return r;
+  r.built = true;
+
+  std::string in = opts.testDir + "/" + input.name + ".in";
+  struct stat st;
+  std::string stdinPath = stat(in.c_str(), &st) == 0 ? in : "/dev/null";
+  std::string out = base + ".stdout", err = base + ".stderr";
+  std::string cmd = "timeout 60s " + quote(exe) + " < " + quote(stdinPath) +
+                    " > " + quote(out) + " 2> " + quote(err);
+  Clock::time_point start = Clock::now();
+  int status = std::system(cmd.c_str());
+  r.seconds = secondsSince(start);
+  r.exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+  std::string stderrText, stdoutText, expected;
+  readFile(err, stderrText);
+  std::istringstream lines(stderrText);
+  for (std::string line; std::getline(lines, line);) {
+    int h, m, s, us;
+    if (std::sscanf(line.c_str(), "TOTAL: %dH-%dM-%dS-%dus", &h, &m, &s,
+                    &us) == 4)
+      r.totalMicroseconds = ((h * 60LL + m) * 60 + s) * 1000000 + us;
+  }
+  readFile(out, stdoutText);
+  if (!stdoutText.empty() && stdoutText.back() != '\n')
+    stdoutText += '\n';
+  stdoutText += std::to_string(r.exitCode);
+  if (readFile(opts.testDir + "/" + input.name + ".out", expected))
+    r.correct = normalizeOutput(stdoutText) == normalizeOutput(expected);
+  return r;
+}
+
+//===----------------------------------------------------------------------===//
+// JSON output
+//===----------------------------------------------------------------------===//
+
+// A minimal pretty-printing JSON writer; it inserts commas and indentation
+// and leaves well-formedness to the caller.
+class JsonWriter {
+public:
+  explicit JsonWriter(std::string &out) : out_(out) {}
+
+  void beginObject() { open('{'); }
+  void endObject() { close('}'); }
+  void beginArray() { open('['); }
+  void endArray() { close(']'); }
+  void key(std::string_view k) {
+    separate();
+    string(k);
+    out_ += ": ";
+    afterKey_ = true;
+  }
+  void value(std::string_view v) {
+    separate();
+    string(v);
+  }
+  void value(const char *v) { value(std::string_view(v)); }
+  void value(bool v) {
+    separate();
+    out_ += v ? "true" : "false";
+  }
+  void value(double v) {
+    separate();
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", v);
+    out_ += buf;
+  }
+  void value(int64_t v) {
+    separate();
+    out_ += std::to_string(v);
+  }
+  template <typename T> void field(std::string_view k, T v) {
+    key(k);
+    value(v);
+  }
+
+private:
+  void open(char c) {
+    separate();
+    out_ += c;
+    first_ = true;
+    ++depth_;
+  }
+  void close(char c) {
+    --depth_;
+    if (!first_)
+      newline();
+    out_ += c;
+    first_ = false;
+  }
+  void separate() {
+    if (afterKey_) {
+      afterKey_ = false;
+      return;
+    }
+    if (depth_ == 0)
+      return;
+    if (!first_)
+      out_ += ',';
+    newline();
+    first_ = false;
+  }
+  void newline() {
+    out_ += '\n';
+    out_.append(2 * depth_, ' ');
+  }
+  void string(std::string_view s) {
+    out_ += '"';
+    for (char c : s) {
+      if (c == '"' || c == '\\') {
+        out_ += '\\';
+        out_ += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+        out_ += buf;
+      } else {
+        out_ += c;
+      }
+    }
+    out_ += '"';
+  }
+
+  std::string &out_;
+  unsigned depth_ = 0;
+  bool first_ = true;
+  bool afterKey_ = false;
+};
+
+void writePhase(JsonWriter &json, const PhaseResult &p, bool isPass) {
+  json.beginObject();
+  json.field("name", p.name);
+  json.field("seconds", p.seconds);
+  json.field("peakRssKB", static_cast<int64_t>(p.peakKB));
+  json.field("peakRssGrowthKB", static_cast<int64_t>(p.growthKB));
+  if (isPass) {
+    json.field("runs", static_cast<int64_t>(p.runs));
+    json.field("changed", static_cast<int64_t>(p.changed));
+    json.field("instsBefore", static_cast<int64_t>(p.instsBefore));
+    json.field("instsAfter", static_cast<int64_t>(p.instsAfter));
+  }
+  json.endObject();
+}
+
+// Phase times summed over all inputs, in order of first appearance.
+void addTotals(std::vector<std::pair<std::string, double>> &totals,
+               const std::vector<PhaseResult> &phases) {
+  for (const PhaseResult &p : phases) {
+    auto it = std::find_if(totals.begin(), totals.end(),
+                           [&](const auto &t) { return t.first == p.name; });
+    if (it == totals.end())
+      totals.emplace_back(p.name, p.seconds);
+    else
+      it->second += p.seconds;
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Driver
+//===----------------------------------------------------------------------===//
+
+bool parseUnsigned(const char *s, unsigned &v) {
+  char *end = nullptr;
+  unsigned long n = std::strtoul(s, &end, 10);
+  if (*s == '\0' || *end != '\0')
+    return false;
+  v = static_cast<unsigned>(n);
+  return true;
+}
+
+bool parseOptions(int argc, const char *argv[], Options &opts) {
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+      opts.optLevel = arg[2] - '0';
+    } else if (arg == "--frontend=antlr" || arg == "--frontend=fast") {
+      opts.fastFrontend = arg == "--frontend=fast";
+    } else if (arg == "--run") {
+      opts.run = true;
+    } else if (arg == "--repeat" && hasValue) {
+      if (!parseUnsigned(argv[++i], opts.repeat) || opts.repeat == 0)
+        return false;
+    } else if (arg == "--scale" && hasValue) {
+      opts.scales.clear();
+      std::istringstream ss(argv[++i]);
+      for (std::string item; std::getline(ss, item, ',');) {
+        unsigned scale;
+        if (!parseUnsigned(item.c_str(), scale))
+          return false;
+        if (scale)
+          opts.scales.push_back(scale);
+      }
+    } else if (arg == "--cc" && hasValue) {
+      opts.cc = argv[++i];
+    } else if (arg == "--tests" && hasValue) {
+      opts.testDir = argv[++i];
+    } else if (arg == "--sylib" && hasValue) {
+      opts.sylib = argv[++i];
+    } else if (arg == "--work-dir" && hasValue) {
+      opts.workDir = argv[++i];
+    } else if (arg == "--output" && hasValue) {
+      opts.output = argv[++i];
+    } else if (arg == "--filter" && hasValue) {
+      opts.filter = argv[++i];
+    } else {
+      std::cerr << "error: unknown option " << arg << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<Input> collectInputs(const Options &opts) {
+  std::vector<std::string> names;
+  std::error_code ec;
+  for (auto it = std::filesystem::directory_iterator(opts.testDir, ec);
+       !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+    if (it->path().extension() == ".sy")
+      names.push_back(it->path().stem().string());
+  std::sort(names.begin(), names.end());
+
+  std::vector<Input> inputs;
+  for (const std::string &name : names)
+    inputs.push_back(
+        {name, opts.testDir + "/" + name + ".sy", "functional", 1});
+  for (const char *seed : kStressSeeds) {
+    std::string source;
+    if (!readFile(opts.testDir + "/" + seed + ".sy", source))
+      continue;
+    for (unsigned scale : opts.scales) {
+      std::string name = std::string(seed) + "_x" + std::to_string(scale);
+      std::string path = opts.workDir + "/" + name + ".sy";
+      if (writeFile(path, scaleProgram(source, scale)))
+        inputs.push_back({name, path, "synthetic", scale});
+    }
+  }
+  if (!opts.filter.empty())
+    inputs.erase(std::remove_if(inputs.begin(), inputs.end(),
+                                [&](const Input &in) {
+                                  return in.name.find(opts.filter) ==
+                                         std::string::npos;
+                                }),
+                 inputs.end());
+  return inputs;
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+  Options opts;
+  if (!parseOptions(argc, argv, opts)) {
+    std::cerr
+        << "Usage: ./benchmark [-O0|-O1|-O2] [--frontend=antlr|fast] "
+           "[--repeat <n>]\n"
+           "                   [--scale <n,...>] [--run] [--cc <compiler>] "
+           "[--tests <dir>]\n"
+           "                   [--sylib <sylib.c>] [--work-dir <dir>] "
+           "[--output <file.json>]\n"
+           "                   [--filter <substring>]"
+        << std::endl;
+    return 1;
+  }
+  mkdir(opts.workDir.c_str(), 0755);
+
+  std::string out;
+  JsonWriter json(out);
+  json.beginObject();
+  json.key("config");
+  json.beginObject();
+  json.field("optLevel", static_cast<int64_t>(opts.optLevel));
+  json.field("frontend", opts.fastFrontend ? "fast" : "antlr");
+  json.field("repeat", static_cast<int64_t>(opts.repeat));
+  json.field("run", opts.run);
+  json.endObject();
+
+  std::vector<std::pair<std::string, double>> phaseTotals, passTotals;
+  double compileSeconds = 0, runSeconds = 0;
+  int64_t runMicroseconds = 0;
+  unsigned failed = 0, incorrect = 0;
+  json.key("files");
+  json.beginArray();
+  for (const Input &input : collectInputs(opts)) {
+    std::string ll = opts.workDir + "/" + input.name + ".ll";
+    CompileResult result = compileInChild(opts, input, ll);
+    for (unsigned i = 1; i < opts.repeat && result.ok; ++i)
+      mergeRepeat(result, compileInChild(opts, input, ll));
+    std::cerr << input.name << ": "
+              << (result.ok ? std::to_string(result.seconds * 1000) + " ms"
+                            : "error: " + result.error)
+              << std::endl;
+
+    json.beginObject();
+    json.field("name", input.name);
+    json.field("kind", input.kind);
+    json.field("scale", static_cast<int64_t>(input.scale));
+    json.field("ok", result.ok);
+    if (!result.ok) {
+      ++failed;
+      json.field("error", result.error);
+      json.endObject();
+      continue;
+    }
+    json.field("seconds", result.seconds);
+    json.field("peakRssKB", static_cast<int64_t>(result.peakKB));
+    json.key("phases");
+    json.beginArray();
+    for (const PhaseResult &p : result.phases)
+      writePhase(json, p, false);
+    json.endArray();
+    json.key("passes");
+    json.beginArray();
+    for (const PhaseResult &p : result.passes)
+      writePhase(json, p, true);
+    json.endArray();
+    compileSeconds += result.seconds;
+    addTotals(phaseTotals, result.phases);
+    addTotals(passTotals, result.passes);
+
+    // Synthetic inputs read stdin once per copy and have no expected
+    // output, so only the functional tests are run.
+    if (opts.run && std::strcmp(input.kind, "functional") == 0) {
+      RunResult run = runProgram(opts, input, ll);
+      json.key("runtime");
+      json.beginObject();
+      json.field("built", run.built);
+      json.field("exitCode", static_cast<int64_t>(run.exitCode));
+      json.field("correct", run.correct);
+      json.field("seconds", run.seconds);
+      json.field("totalMicroseconds", run.totalMicroseconds);
+      json.endObject();
+      incorrect += !run.correct;
+      runSeconds += run.seconds;
+      if (run.totalMicroseconds > 0)
+        runMicroseconds += run.totalMicroseconds;
+    }
+    json.endObject();
+  }
+  json.endArray();
+
+  json.key("summary");
+  json.beginObject();
+  json.field("failed", static_cast<int64_t>(failed));
+  json.field("compileSeconds", compileSeconds);
+  for (auto *totals : {&phaseTotals, &passTotals}) {
+    json.key(totals == &phaseTotals ? "phaseSeconds" : "passSeconds");
+    json.beginObject();
+    for (const auto &[name, seconds] : *totals)
+      json.field(name, seconds);
+    json.endObject();
+  }
+  if (opts.run) {
+    json.field("incorrect", static_cast<int64_t>(incorrect));
+    json.field("runSeconds", runSeconds);
+    json.field("totalMicroseconds", runMicroseconds);
+  }
+  json.endObject();
+  json.endObject();
+  out += '\n';
+
+  if (opts.output.empty()) {
+    std::cout << out;
+  } else if (!writeFile(opts.output, out)) {
+    std::cerr << "error: cannot write " << opts.output << std::endl;
+    return 1;
+  }
+  return failed || incorrect ? 1 : 0;
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include "Arena.h"
+#include "Casting.h"
+
+#include <cstdint>
+#include <string_view>
+
+// Abstract syntax tree produced by the front end. Nodes are plain structs
+// allocated in the ASTContext arena; child lists are ArrayRefs into the same
+// arena and identifiers are string_views that stay valid for as long as the
+// ASTContext (and the source buffer it may point into) is alive.
+
+struct Expr {
+  enum class Kind : uint8_t { IntLiteral, LVal, Call, Unary, Binary };
+  Kind kind;
+  uint32_t line;
+
+protected:
+  Expr(Kind k, uint32_t line) : kind(k), line(line) {}
+};
+
+struct IntLiteral : Expr {
+  int32_t value;
+
+  IntLiteral(int32_t v, uint32_t line) : Expr(Kind::IntLiteral, line), value(v) {}
+  static bool classof(const Expr *e) { return e->kind == Kind::IntLiteral; }
+};
+
+// A (possibly indexed) reference to a variable, e.g. `a` or `a[i][j]`.
+struct LValExpr : Expr {
+  std::string_view name;
+  ArrayRef<Expr *> indices;
+
+  LValExpr(std::string_view name, ArrayRef<Expr *> indices, uint32_t line)
+      : Expr(Kind::LVal, line), name(name), indices(indices) {}
+  static bool classof(const Expr *e) { return e->kind == Kind::LVal; }
+};
+
+struct CallExpr : Expr {
+  std::string_view callee;
+  ArrayRef<Expr *> args;
+
+  CallExpr(std::string_view callee, ArrayRef<Expr *> args, uint32_t line)
+      : Expr(Kind::Call, line), callee(callee), args(args) {}
+  static bool classof(const Expr *e) { return e->kind == Kind::Call; }
+};
+
+enum class UnaryOp : uint8_t { Plus, Minus, Not };
+
+struct UnaryExpr : Expr {
+  UnaryOp op;
+  Expr *operand;
+
+  UnaryExpr(UnaryOp op, Expr *operand, uint32_t line)
+      : Expr(Kind::Unary, line), op(op), operand(operand) {}
+  static bool classof(const Expr *e) { return e->kind == Kind::Unary; }
+};
+
+enum class BinaryOp : uint8_t {
+  Add,
+  Sub,
+  Mul,
+  Div,
+  Mod,
+  Lt,
+  Gt,
+  Le,
+  Ge,
+  Eq,
+  Ne,
+  And,
+  Or,
+};
+
+struct BinaryExpr : Expr {
+  BinaryOp op;
+  Expr *lhs;
+  Expr *rhs;
+
+  BinaryExpr(BinaryOp op, Expr *lhs, Expr *rhs, uint32_t line)
+      : Expr(Kind::Binary, line), op(op), lhs(lhs), rhs(rhs) {}
+  static bool classof(const Expr *e) { return e->kind == Kind::Binary; }
+};
+
+// Either a single expression or a brace-enclosed list of initializers.
+struct InitVal {
+  Expr *expr;               // Set for scalar initializers.
+  ArrayRef<InitVal *> list; // Used when expr is null.
+
+  explicit InitVal(Expr *e) : expr(e) {}
+  explicit InitVal(ArrayRef<InitVal *> l) : expr(nullptr), list(l) {}
+  bool isList() const { return expr == nullptr; }
+};
+
+struct VarDef {
+  std::string_view name;
+  ArrayRef<Expr *> dims; // Empty for scalars.
+  InitVal *init;         // Null if there is no initializer.
+  bool isConst;
+  uint32_t line;
+
+  VarDef(std::string_view name, ArrayRef<Expr *> dims, InitVal *init,
+         bool isConst, uint32_t line)
+      : name(name), dims(dims), init(init), isConst(isConst), line(line) {}
+};
+
+struct Stmt {
+  enum class Kind : uint8_t {
+    Decl,
+    Assign,
+    Expr,
+    Block,
+    If,
+    While,
+    Break,
+    Continue,
+    Return,
+  };
+  Kind kind;
+  uint32_t line;
+
+protected:
+  Stmt(Kind k, uint32_t line) : kind(k), line(line) {}
+};
+
+struct DeclStmt : Stmt {
+  ArrayRef<VarDef *> defs;
+
+  DeclStmt(ArrayRef<VarDef *> defs, uint32_t line)
+      : Stmt(Kind::Decl, line), defs(defs) {}
+  static bool classof(const Stmt *s) { return s->kind == Kind::Decl; }
+};
+
+struct AssignStmt : Stmt {
+  LValExpr *lval;
+  Expr *value;
+
+  AssignStmt(LValExpr *lval, Expr *value, uint32_t line)
+      : Stmt(Kind::Assign, line), lval(lval), value(value) {}
+  static bool classof(const Stmt *s) { return s->kind == Kind::Assign; }
+};
+
+struct ExprStmt : Stmt {
+  Expr *expr; // Null for the empty statement `;`.
+
+  ExprStmt(Expr *expr, uint32_t line) : Stmt(Kind::Expr, line), expr(expr) {}
+  static bool classof(const Stmt *s) { return s->kind == Kind::Expr; }
+};
+
+struct BlockStmt : Stmt {
+  ArrayRef<Stmt *> items;
+
+  BlockStmt(ArrayRef<Stmt *> items, uint32_t line)
+      : Stmt(Kind::Block, line), items(items) {}
+  static bool classof(const Stmt *s) { return s->kind == Kind::Block; }
+};
+
+struct IfStmt : Stmt {
+  Expr *cond;
+  Stmt *thenStmt;
+  Stmt *elseStmt; // May be null.
+
+  IfStmt(Expr *cond, Stmt *thenStmt, Stmt *elseStmt, uint32_t line)
+      : Stmt(Kind::If, line), cond(cond), thenStmt(thenStmt),
+        elseStmt(elseStmt) {}
+  static bool classof(const Stmt *s) { return s->kind == Kind::If; }
+};
+
+struct WhileStmt : Stmt {
+  Expr *cond;
+  Stmt *body;
+
+  WhileStmt(Expr *cond, Stmt *body, uint32_t line)
+      : Stmt(Kind::While, line), cond(cond), body(body) {}
+  static bool classof(const Stmt *s) { return s->kind == Kind::While; }
+};
+
+struct BreakStmt : Stmt {
+  explicit BreakStmt(uint32_t line) : Stmt(Kind::Break, line) {}
+  static bool classof(const Stmt *s) { return s->kind == Kind::Break; }
+};
+
+struct ContinueStmt : Stmt {
+  explicit ContinueStmt(uint32_t line) : Stmt(Kind::Continue, line) {}
+  static bool classof(const Stmt *s) { return s->kind == Kind::Continue; }
+};
+
+struct ReturnStmt : Stmt {
+  Expr *value; // Null for `return;`.
+
+  ReturnStmt(Expr *value, uint32_t line)
+      : Stmt(Kind::Return, line), value(value) {}
+  static bool classof(const Stmt *s) { return s->kind == Kind::Return; }
+};
+
+struct FuncParam {
+  std::string_view name;
+  bool isArray;
+  // Sizes of the dimensions after the first, unsized one: `int a[][3]`.
+  ArrayRef<Expr *> dims;
+
+  FuncParam(std::string_view name, bool isArray, ArrayRef<Expr *> dims)
+      : name(name), isArray(isArray), dims(dims) {}
+};
+
+struct FuncDef {
+  bool returnsVoid;
+  std::string_view name;
+  ArrayRef<FuncParam *> params;
+  BlockStmt *body;
+  uint32_t line;
+
+  FuncDef(bool returnsVoid, std::string_view name,
+          ArrayRef<FuncParam *> params, BlockStmt *body, uint32_t line)
+      : returnsVoid(returnsVoid), name(name), params(params), body(body),
+        line(line) {}
+};
+
+// A top-level item: exactly one of the two pointers is set.
+struct TopLevel {
+  FuncDef *func = nullptr;
+  DeclStmt *decl = nullptr;
+};
+
+struct CompUnit {
+  ArrayRef<TopLevel> items;
+
+  explicit CompUnit(ArrayRef<TopLevel> items) : items(items) {}
+};
+
+// Owns the memory of one translation unit's AST.
+class ASTContext {
+public:
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    return arena_.create<T>(std::forward<Args>(args)...);
+  }
+  template <typename T> ArrayRef<T> copyArray(const std::vector<T> &v) {
+    return arena_.copyArray(v);
+  }
+  std::string_view copyString(std::string_view s) {
+    return arena_.copyString(s);
+  }
+
+  Arena &getArena() { return arena_; }
+
+private:
+  Arena arena_;
+};
+
+// Parses the spelling of an INTEGER_CONST token (decimal, octal or hex).
+// Values that do not fit are wrapped to 32 bits, so that `-2147483648`
+// comes out right after negation.
+int32_t parseIntLiteral(std::string_view text);
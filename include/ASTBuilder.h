@@ -0,0 +1,76 @@
+#pragma once
+
+#include "AST.h"
+#include "SysYParserBaseVisitor.h"
+
+// Converts the ANTLR parse tree into the AST. Each visit method returns the
+// node it built wrapped in std::any (as Expr *, Stmt *, InitVal *, ...).
+class ASTBuilder : public SysYParserBaseVisitor {
+public:
+  explicit ASTBuilder(ASTContext &ctx) : ctx_(ctx) {}
+
+  CompUnit *build(SysYParser::ProgramContext *program);
+
+  std::any visitCompUnit(SysYParser::CompUnitContext *ctx) override;
+  std::any visitDecl(SysYParser::DeclContext *ctx) override;
+  std::any visitConstDecl(SysYParser::ConstDeclContext *ctx) override;
+  std::any visitVarDecl(SysYParser::VarDeclContext *ctx) override;
+  std::any visitConstDef(SysYParser::ConstDefContext *ctx) override;
+  std::any visitVarDef(SysYParser::VarDefContext *ctx) override;
+  std::any visitConstInitVal(SysYParser::ConstInitValContext *ctx) override;
+  std::any visitInitVal(SysYParser::InitValContext *ctx) override;
+  std::any visitFuncDef(SysYParser::FuncDefContext *ctx) override;
+  std::any visitFuncFParam(SysYParser::FuncFParamContext *ctx) override;
+  std::any visitBlock(SysYParser::BlockContext *ctx) override;
+
+  std::any visitAssignStmt(SysYParser::AssignStmtContext *ctx) override;
+  std::any visitExpStmt(SysYParser::ExpStmtContext *ctx) override;
+  std::any visitBlockStmt(SysYParser::BlockStmtContext *ctx) override;
+  std::any visitIfStmt(SysYParser::IfStmtContext *ctx) override;
+  std::any visitWhileStmt(SysYParser::WhileStmtContext *ctx) override;
+  std::any visitBreakStmt(SysYParser::BreakStmtContext *ctx) override;
+  std::any visitContinueStmt(SysYParser::ContinueStmtContext *ctx) override;
+  std::any visitReturnStmt(SysYParser::ReturnStmtContext *ctx) override;
+
+  std::any visitParenExp(SysYParser::ParenExpContext *ctx) override;
+  std::any visitLValExp(SysYParser::LValExpContext *ctx) override;
+  std::any visitNumberExp(SysYParser::NumberExpContext *ctx) override;
+  std::any visitCallExp(SysYParser::CallExpContext *ctx) override;
+  std::any visitUnaryExp(SysYParser::UnaryExpContext *ctx) override;
+  std::any visitMulExp(SysYParser::MulExpContext *ctx) override;
+  std::any visitAddExp(SysYParser::AddExpContext *ctx) override;
+
+  std::any visitExpCond(SysYParser::ExpCondContext *ctx) override;
+  std::any visitRelCond(SysYParser::RelCondContext *ctx) override;
+  std::any visitEqCond(SysYParser::EqCondContext *ctx) override;
+  std::any visitAndCond(SysYParser::AndCondContext *ctx) override;
+  std::any visitOrCond(SysYParser::OrCondContext *ctx) override;
+
+  std::any visitLVal(SysYParser::LValContext *ctx) override;
+  std::any visitConstExp(SysYParser::ConstExpContext *ctx) override;
+
+private:
+  Expr *expr(antlr4::tree::ParseTree *t) {
+    return std::any_cast<Expr *>(visit(t));
+  }
+  Stmt *stmt(antlr4::tree::ParseTree *t) {
+    return std::any_cast<Stmt *>(visit(t));
+  }
+  template <typename Ctx> ArrayRef<Expr *> exprList(const std::vector<Ctx *> &v) {
+    std::vector<Expr *> result;
+    result.reserve(v.size());
+    for (Ctx *c : v)
+      result.push_back(expr(c));
+    return ctx_.copyArray(result);
+  }
+  std::string_view text(antlr4::tree::TerminalNode *node) {
+    return ctx_.copyString(node->getText());
+  }
+  static uint32_t lineOf(antlr4::ParserRuleContext *ctx) {
+    return static_cast<uint32_t>(ctx->getStart()->getLine());
+  }
+  Expr *binary(BinaryOp op, antlr4::tree::ParseTree *lhs,
+               antlr4::tree::ParseTree *rhs, antlr4::ParserRuleContext *ctx);
+
+  ASTContext &ctx_;
+};
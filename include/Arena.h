@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A read-only view of a contiguous array, usually one that lives in an Arena.
+template <typename T> class ArrayRef {
+public:
+  ArrayRef() = default;
+  ArrayRef(const T *data, size_t size) : data_(data), size_(size) {}
+  ArrayRef(const std::vector<T> &v) : data_(v.data()), size_(v.size()) {}
+
+  const T *begin() const { return data_; }
+  const T *end() const { return data_ + size_; }
+  const T *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T &operator[](size_t i) const { return data_[i]; }
+  const T &front() const { return data_[0]; }
+  const T &back() const { return data_[size_ - 1]; }
+
+private:
+  const T *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Bump-pointer allocator. Memory is carved out of geometrically growing slabs
+// and released all at once when the arena is destroyed, so allocation is a
+// pointer increment and objects that are used together sit next to each other
+// in memory. Destructors are never run, which is why only trivially
+// destructible types may be created here.
+class Arena {
+public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  ~Arena();
+
+  void *allocate(size_t size, size_t align) {
+    uintptr_t p = (cur_ + align - 1) & ~(uintptr_t)(align - 1);
+    if (p + size > end_ || cur_ == 0)
+      return allocateSlow(size, align);
+    cur_ = p + size;
+    bytesUsed_ += size;
+    return reinterpret_cast<void *>(p);
+  }
+
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "arena objects are never destroyed");
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+
+  // Allocates n value-initialized elements.
+  template <typename T> T *allocArray(size_t n) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "arena objects are never destroyed");
+    if (n == 0)
+      return nullptr;
+    T *p = static_cast<T *>(allocate(sizeof(T) * n, alignof(T)));
+    for (size_t i = 0; i < n; ++i)
+      new (p + i) T();
+    return p;
+  }
+
+  template <typename T> ArrayRef<T> copyArray(const std::vector<T> &v) {
+    if (v.empty())
+      return {};
+    T *p = static_cast<T *>(allocate(sizeof(T) * v.size(), alignof(T)));
+    std::uninitialized_copy(v.begin(), v.end(), p);
+    return {p, v.size()};
+  }
+
+  std::string_view copyString(std::string_view s) {
+    if (s.empty())
+      return {};
+    char *p = static_cast<char *>(allocate(s.size(), 1));
+    std::memcpy(p, s.data(), s.size());
+    return {p, s.size()};
+  }
+
+  // Bytes handed out to callers.
+  size_t bytesUsed() const { return bytesUsed_; }
+  // Bytes reserved from the system, including slack at the end of slabs.
+  size_t bytesReserved() const { return bytesReserved_; }
+
+private:
+  void *allocateSlow(size_t size, size_t align);
+
+  std::vector<char *> slabs_;
+  uintptr_t cur_ = 0;
+  uintptr_t end_ = 0;
+  size_t nextSlabSize_ = 4096;
+  size_t bytesUsed_ = 0;
+  size_t bytesReserved_ = 0;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "IR.h"
+
+#include <unordered_map>
+#include <vector>
+
+// Which defined functions call which. Calls to declarations (the sylib
+// runtime and intrinsics) are call sites of their caller but have no node
+// of their own. Like the other analyses it describes the module as it was
+// when built.
+class CallGraph {
+public:
+  explicit CallGraph(const Module &m);
+
+  // The calls made by `f`, in program order.
+  const std::vector<CallInst *> &getCallSites(const Function *f) const {
+    return callSites_[indexOf(f)];
+  }
+  // Whether `f` may call itself, directly or through other functions.
+  bool isRecursive(const Function *f) const {
+    return recursive_[indexOf(f)];
+  }
+  // The strongly connected components, callees before their callers.
+  const std::vector<std::vector<Function *>> &getSCCsBottomUp() const {
+    return sccs_;
+  }
+
+private:
+  unsigned indexOf(const Function *f) const { return index_.at(f); }
+
+  std::vector<Function *> functions_;
+  std::unordered_map<const Function *, unsigned> index_;
+  std::vector<std::vector<CallInst *>> callSites_;
+  std::vector<bool> recursive_;
+  std::vector<std::vector<Function *>> sccs_;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cassert>
+
+// LLVM-style RTTI. Class hierarchies opt in by providing a static
+// `classof(const Base *)` predicate, which keeps the objects free of vtables.
+
+template <typename To, typename From> inline bool isa(const From *v) {
+  return To::classof(v);
+}
+
+template <typename To, typename From> inline To *cast(From *v) {
+  assert(isa<To>(v) && "cast to incompatible type");
+  return static_cast<To *>(v);
+}
+
+template <typename To, typename From> inline const To *cast(const From *v) {
+  assert(isa<To>(v) && "cast to incompatible type");
+  return static_cast<const To *>(v);
+}
+
+template <typename To, typename From> inline To *dyn_cast(From *v) {
+  return v && To::classof(v) ? static_cast<To *>(v) : nullptr;
+}
+
+template <typename To, typename From>
+inline const To *dyn_cast(const From *v) {
+  return v && To::classof(v) ? static_cast<const To *>(v) : nullptr;
+}
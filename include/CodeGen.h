@@ -0,0 +1,32 @@
+#pragma once
+
+#include "IR.h"
+
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Compiles the module to x86-64 assembly for the GNU assembler (AT&T syntax,
+// System V ABI), to be linked with the sylib runtime. Each function goes
+// through three stages (see MachineIR.h):
+//
+//  1. Instruction selection lowers the IR to machine instructions on virtual
+//     registers. Address arithmetic is folded into addressing modes, compares
+//     into the branches that use them, and phis become copies at the end of
+//     the predecessors, with critical edges split.
+//  2. Register allocation computes liveness, builds live intervals and
+//     assigns registers by linear scan. When registers run out, the interval
+//     with the lowest spill weight (loop-depth-weighted uses per position)
+//     goes to the stack; copy-related intervals are given the same register
+//     where possible so that the copies disappear.
+//  3. The assembly printer lays out the frame and prints the instructions.
+//
+// Given a thread pool, the functions are compiled in parallel.
+void emitAssembly(Module &m, std::string &out, ThreadPool *pool = nullptr);
+// Compiles one function definition.
+void emitFunction(Function &f, std::string &out);
+// Emits the module with the function definitions taken from `bodies`, one
+// per definition in module order, as compiled by emitFunction.
+void emitAssembly(const Module &m, const std::vector<std::string> &bodies,
+                  std::string &out);
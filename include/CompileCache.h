@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// 128-bit non-cryptographic hash, used to name cache entries. Every update
+// is one field: strings are hashed together with their length, so that
+// the field boundaries are part of the hash.
+class Hasher {
+public:
+  void update(std::string_view bytes);
+  void update(uint64_t value);
+  // The hash as 32 hex digits.
+  std::string hex() const;
+
+private:
+  void mix(uint64_t word);
+
+  uint64_t h1_ = 0x9e3779b97f4a7c15;
+  uint64_t h2_ = 0xc2b2ae3d27d4eb4f;
+  uint64_t length_ = 0;
+};
+
+// Identifies the compiler build: the executable's size and modification
+// time, so that a rebuilt compiler never sees the old compiler's entries.
+std::string getCompilerVersion();
+
+// On-disk cache of compiler output. Entries are content-addressed: each is
+// named by the hash of everything its text depends on, so an entry is never
+// stale and is only ever removed to keep the cache within its size limit.
+// Entries are written to a temporary file and renamed into place, so any
+// number of threads and processes may share a cache directory. The total
+// size of the entries is recorded in a file of its own, so that the
+// directory only has to be scanned when the limit is exceeded.
+//
+// Failures to read or write the cache are treated as misses; the cache
+// never makes a compile fail.
+class CompileCache {
+public:
+  // Whole output files, and the text of single functions.
+  enum Kind { File, Function };
+
+  // Uses `dir`, creating it if needed. Returns false if that fails.
+  bool open(const std::string &dir, uint64_t maxSize);
+
+  // Reads the entry `key` into `text` and marks it as recently used.
+  bool lookup(Kind kind, const std::string &key, std::string &text);
+  void store(const std::string &key, std::string_view text);
+  unsigned getNumStored() const { return stored_; }
+
+  // Adds the size of the entries stored by this process to the recorded
+  // size. If that exceeds the limit, scans the cache and removes the least
+  // recently used entries, down to three quarters of the limit so that the
+  // next few compiles do not have to evict again.
+  void evict();
+  // Appends the hits and misses of this process and, after evict(), the
+  // size of the cache.
+  void printStats(std::string &out) const;
+
+private:
+  std::string getPath(const std::string &key) const;
+  // Scans the cache, evicting entries if it is over the limit, and returns
+  // its size.
+  uint64_t scan();
+
+  std::string dir_;
+  uint64_t maxSize_ = 0;
+  std::atomic<unsigned> hits_[2] = {};
+  std::atomic<unsigned> misses_[2] = {};
+  std::atomic<unsigned> stored_{0};
+  std::atomic<uint64_t> storedBytes_{0};
+  // Set by evict().
+  bool sized_ = false;
+  bool scanned_ = false;
+  uint64_t size_ = 0;
+  unsigned evicted_ = 0;
+};
+
+// The default cache directory: $SYSY_CACHE_DIR, else sysy-compiler under
+// $XDG_CACHE_HOME or ~/.cache. Empty if none of these is set.
+std::string getDefaultCacheDir();
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "IR.h"
+
+#include <vector>
+
+// Dominator tree over a function's CFG, built with the Cooper-Harvey-Kennedy
+// iterative algorithm on a reverse post-order. The same code computes
+// post-dominators by walking the CFG backwards from the exit blocks; there
+// the root is a virtual exit node that is represented by null.
+//
+// Blocks are identified by the numbers Function::renumberBlocks() assigns, so
+// the tree goes stale as soon as blocks are added, removed or renumbered.
+class DominatorTreeBase {
+public:
+  // Immediate dominator of `bb`. Null for the root, for blocks directly
+  // under the virtual exit of a post-dominator tree, and for unreachable
+  // blocks.
+  BasicBlock *getIDom(const BasicBlock *bb) const {
+    unsigned n = bb->getNumber(), i = idom_[n];
+    return i == kNone || n == rootNode_ ? nullptr : blocks_[i];
+  }
+  const std::vector<BasicBlock *> &getChildren(const BasicBlock *bb) const {
+    return children_[bb->getNumber()];
+  }
+  // Blocks whose immediate dominator is the (possibly virtual) root.
+  const std::vector<BasicBlock *> &getRootChildren() const {
+    return children_[rootNode_];
+  }
+
+  // Whether `bb` is reachable from the root (for post-dominators: whether an
+  // exit is reachable from `bb`).
+  bool isReachable(const BasicBlock *bb) const {
+    return idom_[bb->getNumber()] != kNone;
+  }
+
+  // Every block dominates itself. Unreachable blocks are dominated by
+  // everything and dominate nothing but themselves.
+  bool dominates(const BasicBlock *a, const BasicBlock *b) const;
+  bool properlyDominates(const BasicBlock *a, const BasicBlock *b) const {
+    return a != b && dominates(a, b);
+  }
+  // Nearest block dominating both `a` and `b`; null if that is the virtual
+  // root. Both blocks must be reachable.
+  BasicBlock *findNearestCommonDominator(BasicBlock *a, BasicBlock *b) const;
+
+  bool isPostDominator() const { return post_; }
+  // Number of blocks the function had when the tree was built.
+  unsigned getNumBlocks() const { return numBlocks_; }
+
+  // Reachable blocks in reverse post-order of the traversal the tree was
+  // built from (the reversed CFG for post-dominators).
+  const std::vector<BasicBlock *> &getReversePostOrder() const { return rpo_; }
+  // Reachable blocks in a pre-order walk of the tree: every block comes after
+  // its dominators.
+  std::vector<BasicBlock *> getPreOrder() const;
+
+protected:
+  DominatorTreeBase() = default;
+  void recalculate(Function &f, bool post);
+
+private:
+  static constexpr unsigned kNone = ~0u;
+
+  // Indexed by block number; index rootNode_ is the root (the entry block,
+  // or the virtual exit whose blocks_ entry is null).
+  std::vector<BasicBlock *> blocks_;
+  std::vector<unsigned> idom_;
+  std::vector<std::vector<BasicBlock *>> children_;
+  // Tree pre-order entry and exit times for O(1) dominance queries.
+  std::vector<unsigned> dfsIn_, dfsOut_;
+  std::vector<BasicBlock *> rpo_;
+  unsigned rootNode_ = 0;
+  unsigned numBlocks_ = 0;
+  bool post_ = false;
+};
+
+class DominatorTree : public DominatorTreeBase {
+public:
+  explicit DominatorTree(Function &f) { recalculate(f, false); }
+
+  using DominatorTreeBase::dominates;
+  // Whether `def` is available at `user`: `def` comes first in the same
+  // block, or its block dominates the user's block.
+  bool dominates(const Instruction *def, const Instruction *user) const;
+
+  BasicBlock *getRoot() const { return getReversePostOrder().front(); }
+};
+
+class PostDominatorTree : public DominatorTreeBase {
+public:
+  explicit PostDominatorTree(Function &f) { recalculate(f, true); }
+};
+
+// Dominance frontiers of the reachable blocks of a dominator tree. Built
+// from a post-dominator tree this gives the reverse dominance frontiers,
+// i.e. the blocks whose branches each block is control dependent on.
+class DominanceFrontier {
+public:
+  explicit DominanceFrontier(const DominatorTreeBase &dt);
+
+  const std::vector<BasicBlock *> &get(const BasicBlock *bb) const {
+    return frontiers_[bb->getNumber()];
+  }
+
+private:
+  std::vector<std::vector<BasicBlock *>> frontiers_;
+};
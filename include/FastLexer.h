@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+enum class TokenKind : uint8_t {
+  Const,
+  Int,
+  Void,
+  If,
+  Else,
+  While,
+  Break,
+  Continue,
+  Return,
+  Plus,
+  Minus,
+  Mul,
+  Div,
+  Mod,
+  Assign,
+  Eq,
+  Neq,
+  Lt,
+  Gt,
+  Le,
+  Ge,
+  Not,
+  And,
+  Or,
+  LParen,
+  RParen,
+  LBrace,
+  RBrace,
+  LBracket,
+  RBracket,
+  Comma,
+  Semicolon,
+  Ident,
+  IntConst,
+  Eof,
+  Error,
+};
+
+// A token is a view into the source buffer; nothing is copied.
+struct Token {
+  TokenKind kind = TokenKind::Eof;
+  uint32_t line = 0;
+  std::string_view text;
+};
+
+// Hand-written lexer for SysYLexer.g4. It scans the source bytes in place and
+// produces tokens on demand, skipping whitespace and comments.
+class FastLexer {
+public:
+  explicit FastLexer(std::string_view source)
+      : p_(source.data()), end_(source.data() + source.size()) {}
+
+  Token next();
+
+  // Spelling used in diagnostics, e.g. "'('" or "identifier".
+  static const char *describe(TokenKind kind);
+
+private:
+  // Skips whitespace and comments. Returns false on an unterminated comment.
+  bool skipTrivia();
+
+  const char *p_;
+  const char *end_;
+  uint32_t line_ = 1;
+};
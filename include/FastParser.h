@@ -0,0 +1,59 @@
+#pragma once
+
+#include "AST.h"
+#include "FastLexer.h"
+
+#include <string>
+#include <vector>
+
+// Recursive-descent parser for SysYParser.g4 that builds the same AST as
+// ASTBuilder does from the ANTLR parse tree, including line numbers.
+// Identifiers in the AST point into the source buffer, which therefore has to
+// outlive the ASTContext's users.
+class FastParser {
+public:
+  FastParser(std::string_view source, ASTContext &ctx);
+
+  // Parses a whole compilation unit. On a syntax error returns null and
+  // leaves a "line N: ..." message in `error`.
+  CompUnit *parse(std::string &error);
+
+private:
+  struct SyntaxError {
+    uint32_t line;
+    std::string msg;
+  };
+
+  const Token &tok() const { return la_[pos_ & 3]; }
+  // Looks `n` (at most 3) tokens past the current one.
+  const Token &peek(unsigned n);
+  Token consume();
+  bool accept(TokenKind kind);
+  Token expect(TokenKind kind);
+  [[noreturn]] void fail(const Token &at, const std::string &msg);
+
+  CompUnit *parseCompUnit();
+  FuncDef *parseFuncDef();
+  FuncParam *parseFuncParam();
+  DeclStmt *parseDecl();
+  VarDef *parseVarDef(bool isConst);
+  InitVal *parseInitVal();
+  BlockStmt *parseBlock();
+  Stmt *parseStmt();
+  Expr *parseExp();
+  Expr *parseMulExp();
+  Expr *parseUnaryExp();
+  Expr *parsePrimaryExp();
+  Expr *parseCond();
+  Expr *parseAndCond();
+  Expr *parseEqCond();
+  Expr *parseRelCond();
+  ArrayRef<Expr *> parseIndices();
+
+  FastLexer lexer_;
+  ASTContext &ctx_;
+  // Ring buffer of the current token and up to three lookahead tokens.
+  Token la_[4];
+  unsigned pos_ = 0;
+  unsigned filled_ = 0;
+};
@@ -0,0 +1,646 @@
+#pragma once
+
+#include "Arena.h"
+#include "Casting.h"
+#include "Type.h"
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// In-memory SSA IR modelled on LLVM's. Everything below the Module level
+// (blocks, instructions, operands, constants) is allocated in the owning
+// Function's arena and threaded together with intrusive lists: instructions
+// form a doubly-linked list inside their block, blocks form one inside their
+// function, and every operand slot is a Use that sits on the used value's
+// use list. Nothing is freed individually; erased objects simply become
+// unreachable until the arena goes away.
+
+class Argument;
+class BasicBlock;
+class ConstantInt;
+class Function;
+class GlobalVariable;
+class Instruction;
+class Module;
+class User;
+class Value;
+
+// One operand slot of a User, doubling as a node of the used value's use list.
+class Use {
+public:
+  Value *get() const { return val_; }
+  User *getUser() const { return user_; }
+  Use *getNext() const { return next_; }
+  void set(Value *v);
+
+  operator Value *() const { return val_; }
+  Value *operator->() const { return val_; }
+
+private:
+  friend class User;
+  friend class Value;
+
+  void relink(Value *v);
+
+  Value *val_ = nullptr;
+  User *user_ = nullptr;
+  Use *next_ = nullptr;
+  Use **prev_ = nullptr;
+};
+
+inline Use *nextUse(Use *u) { return u->getNext(); }
+
+// Iterates an intrusive singly- or doubly-linked list. The successor is read
+// before the current node is handed out, so the current node may be unlinked
+// (or erased) during iteration.
+template <typename T, T *(*Next)(T *)> class EarlyIncIterator {
+public:
+  explicit EarlyIncIterator(T *cur) : cur_(cur), next_(cur ? Next(cur) : nullptr) {}
+  T *operator*() const { return cur_; }
+  EarlyIncIterator &operator++() {
+    cur_ = next_;
+    next_ = cur_ ? Next(cur_) : nullptr;
+    return *this;
+  }
+  bool operator!=(const EarlyIncIterator &o) const { return cur_ != o.cur_; }
+  bool operator==(const EarlyIncIterator &o) const { return cur_ == o.cur_; }
+
+private:
+  T *cur_;
+  T *next_;
+};
+
+template <typename It> struct IteratorRange {
+  It b, e;
+  It begin() const { return b; }
+  It end() const { return e; }
+};
+
+class Value {
+public:
+  enum class Kind : uint8_t {
+    Argument,
+    BasicBlock,
+    Function,
+    GlobalVariable,
+    ConstantInt,
+    Undef,
+    // Instructions; keep Alloca first and Ret last.
+    Alloca,
+    Load,
+    Store,
+    GEP,
+    Binary,
+    ICmp,
+    Cast,
+    Phi,
+    Call,
+    Br,
+    Ret,
+  };
+
+  Value(const Value &) = delete;
+  Value &operator=(const Value &) = delete;
+
+  Kind getKind() const { return kind_; }
+  Type *getType() const { return type_; }
+
+  // Name hint used when printing. The characters are not copied, so they must
+  // outlive the value (string literals or arena-owned strings).
+  std::string_view getName() const { return name_; }
+  void setName(std::string_view name) { name_ = name; }
+
+  Use *getFirstUse() const { return uses_; }
+  bool hasUses() const { return uses_ != nullptr; }
+  bool hasOneUse() const { return uses_ && !uses_->getNext(); }
+  unsigned getNumUses() const;
+  IteratorRange<EarlyIncIterator<Use, &nextUse>> uses() const {
+    return {EarlyIncIterator<Use, &nextUse>(uses_),
+            EarlyIncIterator<Use, &nextUse>(nullptr)};
+  }
+  std::vector<User *> users() const;
+
+  // Points every use of this value at `v` instead.
+  void replaceAllUsesWith(Value *v);
+
+  bool isConstant() const {
+    return kind_ == Kind::ConstantInt || kind_ == Kind::Undef;
+  }
+
+  // Scratch word for whichever analysis or pass currently runs; nothing may
+  // rely on it surviving across passes.
+  uint32_t aux = 0;
+
+protected:
+  Value(Kind k, Type *t) : type_(t), kind_(k) {}
+  ~Value() = default;
+
+  uint8_t subclassData_ = 0;
+
+private:
+  friend class Use;
+
+  Type *type_;
+  Kind kind_;
+  std::string_view name_;
+  Use *uses_ = nullptr;
+};
+
+class User : public Value {
+public:
+  unsigned getNumOperands() const { return numOps_; }
+  Value *getOperand(unsigned i) const { return ops_[i].get(); }
+  void setOperand(unsigned i, Value *v) { ops_[i].set(v); }
+  Use &getOperandUse(unsigned i) { return ops_[i]; }
+  Use *op_begin() const { return ops_; }
+  Use *op_end() const { return ops_ + numOps_; }
+
+  // Unlinks all operands from their use lists.
+  void dropAllReferences();
+
+  static bool classof(const Value *v) { return v->getKind() >= Kind::Alloca; }
+
+protected:
+  User(Kind k, Type *t, Arena &arena, unsigned numOps, unsigned capacity = 0);
+
+  // Appends an operand, growing the operand array inside `arena` if needed.
+  void addOperand(Arena &arena, Value *v);
+  // Removes operand i, shifting the following operands down.
+  void removeOperand(unsigned i);
+
+  Use *ops_ = nullptr;
+  uint32_t numOps_ = 0;
+  uint32_t capOps_ = 0;
+};
+
+class Argument : public Value {
+public:
+  Argument(Type *t, Function *parent, unsigned argNo)
+      : Value(Kind::Argument, t), parent_(parent), argNo_(argNo) {}
+
+  Function *getParent() const { return parent_; }
+  unsigned getArgNo() const { return argNo_; }
+
+  static bool classof(const Value *v) {
+    return v->getKind() == Kind::Argument;
+  }
+
+private:
+  Function *parent_;
+  unsigned argNo_;
+};
+
+class ConstantInt : public Value {
+public:
+  ConstantInt(IntegerType *t, int32_t v) : Value(Kind::ConstantInt, t), v_(v) {}
+
+  int32_t getValue() const { return v_; }
+  bool isZero() const { return v_ == 0; }
+  bool isOne() const { return v_ == 1; }
+
+  static bool classof(const Value *v) {
+    return v->getKind() == Kind::ConstantInt;
+  }
+
+private:
+  int32_t v_;
+};
+
+class UndefValue : public Value {
+public:
+  explicit UndefValue(Type *t) : Value(Kind::Undef, t) {}
+
+  static bool classof(const Value *v) { return v->getKind() == Kind::Undef; }
+};
+
+class GlobalVariable : public Value {
+public:
+  GlobalVariable(Type *valueType, std::string_view name, bool isConstant,
+                 bool isPrivate)
+      : Value(Kind::GlobalVariable, valueType->getPointerTo()),
+        valueType_(valueType), isConstant_(isConstant), isPrivate_(isPrivate) {
+    setName(name);
+  }
+
+  Type *getValueType() const { return valueType_; }
+  bool isConstant() const { return isConstant_; }
+  void setConstant(bool c) { isConstant_ = c; }
+  bool isPrivate() const { return isPrivate_; }
+
+  // Flattened initializer with one entry per i32 element in row-major order.
+  // An empty initializer means the variable is zero-initialized; a shorter
+  // one is implicitly padded with zeroes.
+  ArrayRef<int32_t> getInitializer() const { return init_; }
+  void setInitializer(ArrayRef<int32_t> init) { init_ = init; }
+  // The initial value of the i32 element at flat index `i`.
+  int32_t getInitialElement(size_t i) const {
+    return i < init_.size() ? init_[i] : 0;
+  }
+
+  static bool classof(const Value *v) {
+    return v->getKind() == Kind::GlobalVariable;
+  }
+
+private:
+  Type *valueType_;
+  ArrayRef<int32_t> init_;
+  bool isConstant_;
+  bool isPrivate_;
+};
+
+class Instruction : public User {
+public:
+  BasicBlock *getParent() const { return parent_; }
+  Function *getFunction() const;
+  Instruction *getNextNode() const { return next_; }
+  Instruction *getPrevNode() const { return prev_; }
+
+  bool isTerminator() const {
+    return getKind() == Kind::Br || getKind() == Kind::Ret;
+  }
+  bool mayReadMemory() const;
+  bool mayWriteMemory() const;
+  // True if removing the instruction could change observable behaviour
+  // even when its result is unused.
+  bool mayHaveSideEffects() const;
+
+  // Links the (parentless) instruction into the block of `pos`.
+  void insertBefore(Instruction *pos);
+  void insertAfter(Instruction *pos);
+  void moveBefore(Instruction *pos);
+  // Unlinks the instruction from its block but keeps its operands.
+  void removeFromParent();
+  // Unlinks the instruction and drops its operands. All uses of the result
+  // must be gone already.
+  void eraseFromParent();
+
+  // Creates a copy with the same operands in `arena`; the copy has no parent.
+  Instruction *clone(Arena &arena) const;
+
+  static bool classof(const Value *v) { return v->getKind() >= Kind::Alloca; }
+
+protected:
+  Instruction(Kind k, Type *t, Arena &arena, unsigned numOps,
+              unsigned capacity = 0)
+      : User(k, t, arena, numOps, capacity) {}
+
+private:
+  friend class BasicBlock;
+  static Instruction *next(Instruction *i) { return i->next_; }
+
+  BasicBlock *parent_ = nullptr;
+  Instruction *prev_ = nullptr;
+  Instruction *next_ = nullptr;
+};
+
+class AllocaInst : public Instruction {
+public:
+  AllocaInst(Arena &arena, Type *allocated)
+      : Instruction(Kind::Alloca, allocated->getPointerTo(), arena, 0),
+        allocated_(allocated) {}
+
+  Type *getAllocatedType() const { return allocated_; }
+
+  static bool classof(const Value *v) { return v->getKind() == Kind::Alloca; }
+
+private:
+  Type *allocated_;
+};
+
+class LoadInst : public Instruction {
+public:
+  LoadInst(Arena &arena, Value *ptr);
+
+  Value *getPointerOperand() const { return getOperand(0); }
+
+  static bool classof(const Value *v) { return v->getKind() == Kind::Load; }
+};
+
+class StoreInst : public Instruction {
+public:
+  StoreInst(Arena &arena, Value *val, Value *ptr);
+
+  Value *getValueOperand() const { return getOperand(0); }
+  Value *getPointerOperand() const { return getOperand(1); }
+
+  static bool classof(const Value *v) { return v->getKind() == Kind::Store; }
+};
+
+class GetElementPtrInst : public Instruction {
+public:
+  GetElementPtrInst(Arena &arena, Value *ptr, ArrayRef<Value *> indices);
+
+  Value *getPointerOperand() const { return getOperand(0); }
+  Type *getSourceElementType() const {
+    return cast<PointerType>(getPointerOperand()->getType())->getElementType();
+  }
+  Type *getResultElementType() const {
+    return cast<PointerType>(getType())->getElementType();
+  }
+  unsigned getNumIndices() const { return getNumOperands() - 1; }
+  Value *getIndex(unsigned i) const { return getOperand(i + 1); }
+
+  // Type reached by applying the indices (after the first) to `source`.
+  static Type *getIndexedType(Type *source, unsigned numIndices);
+
+  static bool classof(const Value *v) { return v->getKind() == Kind::GEP; }
+};
+
+class BinaryInst : public Instruction {
+public:
+  enum Opcode : uint8_t { Add, Sub, Mul, SDiv, SRem, Shl, AShr, LShr, And, Or, Xor };
+
+  BinaryInst(Arena &arena, Opcode op, Value *lhs, Value *rhs);
+
+  Opcode getOpcode() const { return static_cast<Opcode>(subclassData_); }
+  Value *getLHS() const { return getOperand(0); }
+  Value *getRHS() const { return getOperand(1); }
+  bool isCommutative() const { return isCommutative(getOpcode()); }
+
+  static bool isCommutative(Opcode op) {
+    return op == Add || op == Mul || op == And || op == Or || op == Xor;
+  }
+  static const char *getOpcodeName(Opcode op);
+  // Evaluates `lhs op rhs` with LLVM's i32 semantics. Returns false when the
+  // result is undefined (division by zero, overflowing division, or an
+  // out-of-range shift amount).
+  static bool fold(Opcode op, int32_t lhs, int32_t rhs, int32_t &result);
+
+  static bool classof(const Value *v) { return v->getKind() == Kind::Binary; }
+};
+
+class ICmpInst : public Instruction {
+public:
+  enum Predicate : uint8_t { EQ, NE, SLT, SGT, SLE, SGE };
+
+  ICmpInst(Arena &arena, Predicate pred, Value *lhs, Value *rhs);
+
+  Predicate getPredicate() const { return static_cast<Predicate>(subclassData_); }
+  void setPredicate(Predicate p) { subclassData_ = p; }
+  Value *getLHS() const { return getOperand(0); }
+  Value *getRHS() const { return getOperand(1); }
+
+  static const char *getPredicateName(Predicate p);
+  // Predicate that gives the same result with the operands swapped.
+  static Predicate getSwappedPredicate(Predicate p);
+  // Predicate that gives the opposite result.
+  static Predicate getInversePredicate(Predicate p);
+  static bool fold(Predicate p, int32_t lhs, int32_t rhs);
+
+  static bool classof(const Value *v) { return v->getKind() == Kind::ICmp; }
+};
+
+class CastInst : public Instruction {
+public:
+  enum Opcode : uint8_t { ZExt, BitCast };
+
+  CastInst(Arena &arena, Opcode op, Value *v, Type *dest);
+
+  Opcode getOpcode() const { return static_cast<Opcode>(subclassData_); }
+
+  static bool classof(const Value *v) { return v->getKind() == Kind::Cast; }
+};
+
+class PhiInst : public Instruction {
+public:
+  PhiInst(Arena &arena, Type *t, unsigned reserved = 2);
+
+  unsigned getNumIncoming() const { return getNumOperands(); }
+  Value *getIncomingValue(unsigned i) const { return getOperand(i); }
+  void setIncomingValue(unsigned i, Value *v) { setOperand(i, v); }
+  BasicBlock *getIncomingBlock(unsigned i) const { return blocks_[i]; }
+  void setIncomingBlock(unsigned i, BasicBlock *bb) { blocks_[i] = bb; }
+
+  void addIncoming(Arena &arena, Value *v, BasicBlock *bb);
+  void removeIncoming(unsigned i);
+  // Index of the entry for `bb`, or -1.
+  int getBasicBlockIndex(const BasicBlock *bb) const;
+  Value *getIncomingValueForBlock(const BasicBlock *bb) const;
+  // The value every incoming edge agrees on (ignoring self-references), or
+  // null if they differ.
+  Value *hasConstantValue() const;
+
+  static bool classof(const Value *v) { return v->getKind() == Kind::Phi; }
+
+private:
+  BasicBlock **blocks_;
+};
+
+class CallInst : public Instruction {
+public:
+  CallInst(Arena &arena, Function *callee, ArrayRef<Value *> args);
+
+  Function *getCallee() const;
+  unsigned getNumArgs() const { return getNumOperands() - 1; }
+  Value *getArg(unsigned i) const { return getOperand(i + 1); }
+  void setArg(unsigned i, Value *v) { setOperand(i + 1, v); }
+
+  static bool classof(const Value *v) { return v->getKind() == Kind::Call; }
+};
+
+class BranchInst : public Instruction {
+public:
+  BranchInst(Arena &arena, BasicBlock *dest);
+  BranchInst(Arena &arena, Value *cond, BasicBlock *ifTrue,
+             BasicBlock *ifFalse);
+
+  bool isConditional() const { return getNumOperands() == 3; }
+  Value *getCondition() const { return getOperand(0); }
+  unsigned getNumSuccessors() const { return isConditional() ? 2 : 1; }
+  BasicBlock *getSuccessor(unsigned i) const;
+  void setSuccessor(unsigned i, BasicBlock *bb);
+
+  static bool classof(const Value *v) { return v->getKind() == Kind::Br; }
+};
+
+class RetInst : public Instruction {
+public:
+  RetInst(Arena &arena, Value *v);
+
+  Value *getReturnValue() const {
+    return getNumOperands() ? getOperand(0) : nullptr;
+  }
+
+  static bool classof(const Value *v) { return v->getKind() == Kind::Ret; }
+};
+
+class BasicBlock : public Value {
+public:
+  explicit BasicBlock(std::string_view name)
+      : Value(Kind::BasicBlock, Type::getLabelTy()) {
+    setName(name);
+  }
+
+  Function *getParent() const { return parent_; }
+  BasicBlock *getNextNode() const { return next_; }
+  BasicBlock *getPrevNode() const { return prev_; }
+
+  bool empty() const { return first_ == nullptr; }
+  Instruction *front() const { return first_; }
+  Instruction *back() const { return last_; }
+  using iterator = EarlyIncIterator<Instruction, &Instruction::next>;
+  iterator begin() const { return iterator(first_); }
+  iterator end() const { return iterator(nullptr); }
+  unsigned size() const;
+
+  // The block's terminator, or null while the block is under construction.
+  Instruction *getTerminator() const {
+    return last_ && last_->isTerminator() ? last_ : nullptr;
+  }
+  Instruction *getFirstNonPhi() const;
+
+  void push_back(Instruction *inst) { link(inst, nullptr, this); }
+  void push_front(Instruction *inst) { link(inst, first_, this); }
+
+  unsigned getNumSuccessors() const;
+  BasicBlock *getSuccessor(unsigned i) const;
+  std::vector<BasicBlock *> successors() const;
+  // Predecessors are the parents of the branches that use this block, listed
+  // once per incoming edge.
+  std::vector<BasicBlock *> predecessors() const;
+  BasicBlock *getSinglePredecessor() const;
+  // The single successor of an unconditional branch, or null.
+  BasicBlock *getSingleSuccessor() const;
+
+  // Removes the phi entries that flow in from `pred`.
+  void removePredecessor(BasicBlock *pred);
+  // Rewrites phi entries that name `from` so that they name `to`.
+  void replacePhiUsesWith(BasicBlock *from, BasicBlock *to);
+
+  // Moves all instructions from `pos` (inclusive) to the end into a new block
+  // inserted after this one, and returns the new block. No branch is added.
+  BasicBlock *splitAt(Instruction *pos, std::string_view name);
+
+  // Unlinks the block from its function and drops all operands of its
+  // instructions. The block must have no remaining predecessors.
+  void eraseFromParent();
+  void moveAfter(BasicBlock *pos);
+
+  // Index assigned by Function::renumberBlocks().
+  unsigned getNumber() const { return number_; }
+
+  static bool classof(const Value *v) {
+    return v->getKind() == Kind::BasicBlock;
+  }
+
+private:
+  friend class Function;
+  friend class Instruction;
+  static BasicBlock *next(BasicBlock *b) { return b->next_; }
+
+  Function *parent_ = nullptr;
+  BasicBlock *prev_ = nullptr;
+  BasicBlock *next_ = nullptr;
+  Instruction *first_ = nullptr;
+  Instruction *last_ = nullptr;
+  unsigned number_ = 0;
+
+  // Links `inst` into `bb` before `pos`, or at the end if `pos` is null.
+  static void link(Instruction *inst, Instruction *pos, BasicBlock *bb);
+};
+
+class Function : public Value {
+public:
+  Function(Module *parent, FunctionType *type, std::string_view name);
+  ~Function();
+
+  Module *getParent() const { return parent_; }
+  FunctionType *getFunctionType() const {
+    return cast<FunctionType>(getType());
+  }
+  Type *getReturnType() const { return getFunctionType()->getReturnType(); }
+  unsigned getNumArgs() const { return numArgs_; }
+  Argument *getArg(unsigned i) const { return args_[i]; }
+
+  // Functions without a body are external declarations.
+  bool isDeclaration() const { return first_ == nullptr; }
+
+  BasicBlock *getEntryBlock() const { return first_; }
+  BasicBlock *front() const { return first_; }
+  BasicBlock *back() const { return last_; }
+  using iterator = EarlyIncIterator<BasicBlock, &BasicBlock::next>;
+  iterator begin() const { return iterator(first_); }
+  iterator end() const { return iterator(nullptr); }
+
+  // Creates an empty block and inserts it before `before` (or at the end).
+  BasicBlock *createBlock(std::string_view name, BasicBlock *before = nullptr);
+  void insertBlock(BasicBlock *bb, BasicBlock *before = nullptr);
+  void removeBlock(BasicBlock *bb);
+
+  // Numbers the blocks 0..n-1 in layout order and returns n.
+  unsigned renumberBlocks();
+  unsigned getNumBlocks() const;
+  unsigned getInstructionCount() const;
+
+  Arena &getArena() { return arena_; }
+
+  // Constants are uniqued per function, so a constant is only ever used by
+  // the instructions of one function.
+  ConstantInt *getConstantInt(IntegerType *t, int32_t v);
+  ConstantInt *getInt32(int32_t v) { return getConstantInt(Type::getInt32Ty(), v); }
+  ConstantInt *getInt1(bool v) { return getConstantInt(Type::getInt1Ty(), v); }
+  UndefValue *getUndef(Type *t);
+
+  // Drops every operand of every instruction, breaking all references from
+  // this function's body to other values.
+  void dropAllReferences();
+
+  static bool classof(const Value *v) {
+    return v->getKind() == Kind::Function;
+  }
+
+private:
+  Module *parent_;
+  Arena arena_;
+  Argument **args_ = nullptr;
+  unsigned numArgs_ = 0;
+  BasicBlock *first_ = nullptr;
+  BasicBlock *last_ = nullptr;
+  std::unordered_map<uint64_t, ConstantInt *> constants_;
+  std::unordered_map<Type *, UndefValue *> undefs_;
+};
+
+class Module {
+public:
+  Module() = default;
+  Module(const Module &) = delete;
+  Module &operator=(const Module &) = delete;
+  ~Module();
+
+  // Creates a function with no body; give it blocks to make it a definition.
+  Function *createFunction(FunctionType *type, std::string_view name);
+  GlobalVariable *createGlobal(Type *valueType, std::string_view name,
+                               bool isConstant = false, bool isPrivate = false);
+  // Removes a function that is no longer referenced from anywhere.
+  void eraseFunction(Function *f);
+
+  Function *getFunction(std::string_view name) const;
+  GlobalVariable *getGlobal(std::string_view name) const;
+
+  const std::vector<std::unique_ptr<Function>> &functions() const {
+    return functions_;
+  }
+  const std::vector<GlobalVariable *> &globals() const { return globals_; }
+
+  Arena &getArena() { return arena_; }
+  std::string_view internString(std::string_view s) {
+    return arena_.copyString(s);
+  }
+
+private:
+  Arena arena_;
+  std::vector<GlobalVariable *> globals_;
+  std::vector<std::unique_ptr<Function>> functions_;
+  std::unordered_map<std::string_view, Value *> symbols_;
+};
+
+inline Function *Instruction::getFunction() const {
+  return parent_ ? parent_->getParent() : nullptr;
+}
+
+inline Function *CallInst::getCallee() const {
+  return cast<Function>(getOperand(0));
+}
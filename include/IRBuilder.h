@@ -0,0 +1,137 @@
+#pragma once
+
+#include "IR.h"
+
+#include <initializer_list>
+
+// Creates instructions at an insertion point inside one function. Binary
+// operations and comparisons whose operands are all constants are folded
+// instead of being emitted.
+class IRBuilder {
+public:
+  explicit IRBuilder(Function *f = nullptr) : f_(f) {}
+
+  Function *getFunction() const { return f_; }
+  BasicBlock *getInsertBlock() const { return bb_; }
+
+  // Appends new instructions to the end of `bb`.
+  void setInsertPoint(BasicBlock *bb) {
+    f_ = bb->getParent();
+    bb_ = bb;
+    pos_ = nullptr;
+  }
+  // Inserts new instructions right before `pos`.
+  void setInsertPoint(Instruction *pos) {
+    bb_ = pos->getParent();
+    f_ = bb_->getParent();
+    pos_ = pos;
+  }
+
+  ConstantInt *getInt32(int32_t v) { return f_->getInt32(v); }
+  ConstantInt *getInt1(bool v) { return f_->getInt1(v); }
+
+  AllocaInst *createAlloca(Type *t, std::string_view name = {}) {
+    return insert(arena().create<AllocaInst>(arena(), t), name);
+  }
+
+  LoadInst *createLoad(Value *ptr, std::string_view name = {}) {
+    return insert(arena().create<LoadInst>(arena(), ptr), name);
+  }
+
+  StoreInst *createStore(Value *val, Value *ptr) {
+    return insert(arena().create<StoreInst>(arena(), val, ptr), {});
+  }
+
+  GetElementPtrInst *createGEP(Value *ptr, ArrayRef<Value *> indices,
+                               std::string_view name = {}) {
+    return insert(arena().create<GetElementPtrInst>(arena(), ptr, indices),
+                  name);
+  }
+  GetElementPtrInst *createGEP(Value *ptr, std::initializer_list<Value *> idx,
+                               std::string_view name = {}) {
+    return createGEP(ptr, ArrayRef<Value *>(idx.begin(), idx.size()), name);
+  }
+
+  Value *createBinary(BinaryInst::Opcode op, Value *lhs, Value *rhs,
+                      std::string_view name = {}) {
+    auto *l = dyn_cast<ConstantInt>(lhs);
+    auto *r = dyn_cast<ConstantInt>(rhs);
+    int32_t folded;
+    if (l && r && BinaryInst::fold(op, l->getValue(), r->getValue(), folded))
+      return f_->getConstantInt(cast<IntegerType>(lhs->getType()), folded);
+    return insert(arena().create<BinaryInst>(arena(), op, lhs, rhs), name);
+  }
+  Value *createAdd(Value *l, Value *r, std::string_view name = {}) {
+    return createBinary(BinaryInst::Add, l, r, name);
+  }
+  Value *createSub(Value *l, Value *r, std::string_view name = {}) {
+    return createBinary(BinaryInst::Sub, l, r, name);
+  }
+  Value *createMul(Value *l, Value *r, std::string_view name = {}) {
+    return createBinary(BinaryInst::Mul, l, r, name);
+  }
+
+  Value *createICmp(ICmpInst::Predicate pred, Value *lhs, Value *rhs,
+                    std::string_view name = {}) {
+    auto *l = dyn_cast<ConstantInt>(lhs);
+    auto *r = dyn_cast<ConstantInt>(rhs);
+    if (l && r)
+      return getInt1(ICmpInst::fold(pred, l->getValue(), r->getValue()));
+    return insert(arena().create<ICmpInst>(arena(), pred, lhs, rhs), name);
+  }
+
+  Value *createZExt(Value *v, Type *dest, std::string_view name = {}) {
+    if (auto *c = dyn_cast<ConstantInt>(v))
+      return f_->getConstantInt(cast<IntegerType>(dest), c->getValue());
+    return insert(arena().create<CastInst>(arena(), CastInst::ZExt, v, dest),
+                  name);
+  }
+
+  Value *createBitCast(Value *v, Type *dest, std::string_view name = {}) {
+    if (v->getType() == dest)
+      return v;
+    return insert(
+        arena().create<CastInst>(arena(), CastInst::BitCast, v, dest), name);
+  }
+
+  PhiInst *createPhi(Type *t, unsigned reserved = 2,
+                     std::string_view name = {}) {
+    return insert(arena().create<PhiInst>(arena(), t, reserved), name);
+  }
+
+  CallInst *createCall(Function *callee, ArrayRef<Value *> args,
+                       std::string_view name = {}) {
+    return insert(arena().create<CallInst>(arena(), callee, args), name);
+  }
+
+  BranchInst *createBr(BasicBlock *dest) {
+    return insert(arena().create<BranchInst>(arena(), dest), {});
+  }
+
+  BranchInst *createCondBr(Value *cond, BasicBlock *ifTrue,
+                           BasicBlock *ifFalse) {
+    return insert(arena().create<BranchInst>(arena(), cond, ifTrue, ifFalse),
+                  {});
+  }
+
+  RetInst *createRet(Value *v) {
+    return insert(arena().create<RetInst>(arena(), v), {});
+  }
+
+private:
+  Arena &arena() { return f_->getArena(); }
+
+  template <typename T> T *insert(T *inst, std::string_view name) {
+    if (!name.empty())
+      inst->setName(name);
+    if (pos_)
+      inst->insertBefore(pos_);
+    else
+      bb_->push_back(inst);
+    return inst;
+  }
+
+  Function *f_ = nullptr;
+  BasicBlock *bb_ = nullptr;
+  Instruction *pos_ = nullptr;
+};
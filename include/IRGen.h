@@ -0,0 +1,113 @@
+#pragma once
+
+#include "AST.h"
+#include "IR.h"
+#include "IRBuilder.h"
+
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Raised for semantic errors in the input program.
+class CompileError : public std::runtime_error {
+public:
+  CompileError(uint32_t line, const std::string &msg)
+      : std::runtime_error("line " + std::to_string(line) + ": " + msg) {}
+};
+
+// Lowers a CompUnit into a Module. Local scalars become allocas in the entry
+// block that are read and written with loads and stores; promoting them to SSA
+// values is left to mem2reg. `const` scalars are folded away entirely and
+// `const` arrays become private constant globals.
+class IRGen {
+public:
+  explicit IRGen(Module &m) : m_(m) {}
+
+  void run(const CompUnit *cu);
+
+private:
+  struct Symbol {
+    std::string_view name;
+    // Storage: an alloca or global holding the variable, or, for array
+    // parameters, an alloca holding the pointer. Null for const scalars.
+    Value *addr = nullptr;
+    // Declared type: i32, an array type, or the pointer type of an array
+    // parameter.
+    Type *type = nullptr;
+    bool isConst = false;
+    bool isArrayParam = false;
+    // Flattened values of a const variable.
+    ArrayRef<int32_t> constVals;
+    // Innermost enclosing declaration of the same name.
+    Symbol *shadowed = nullptr;
+    // Nesting depth of the declaring scope.
+    unsigned depth = 0;
+  };
+
+  struct LoopTargets {
+    BasicBlock *continueTarget;
+    BasicBlock *breakTarget;
+  };
+
+  // Symbol table.
+  void pushScope();
+  void popScope();
+  Symbol *declare(std::string_view name, uint32_t line);
+  Symbol *lookup(std::string_view name, uint32_t line) const;
+  Function *lookupFunction(std::string_view name, uint32_t line);
+
+  // Declarations.
+  void genGlobalDecl(const DeclStmt *decl);
+  void genLocalDecl(const DeclStmt *decl);
+  void genFunction(const FuncDef *def);
+  std::vector<uint32_t> evalDims(ArrayRef<Expr *> dims);
+  static Type *arrayTypeOf(const std::vector<uint32_t> &dims);
+  // Lays out a (possibly nested) initializer over the flattened array
+  // described by `dims`; slots without an initializer are left null.
+  void flattenInit(const InitVal *init, const std::vector<uint32_t> &dims,
+                   std::vector<const Expr *> &out);
+  void flattenList(const InitVal *list, const std::vector<size_t> &strides,
+                   size_t level, size_t begin, std::vector<const Expr *> &out);
+  ArrayRef<int32_t> evalInit(const std::vector<const Expr *> &flat);
+  void storeLocalArrayInit(Value *addr, Type *type,
+                           const std::vector<const Expr *> &flat);
+
+  // Statements.
+  void genStmt(const Stmt *s);
+  void genBlock(const BlockStmt *b);
+  void genIf(const IfStmt *s);
+  void genWhile(const WhileStmt *s);
+  void genReturn(const ReturnStmt *s);
+  void emitDefaultReturn();
+  // Makes sure there is an open block to emit into; code after a
+  // terminator goes into a fresh block that nothing branches to.
+  void ensureInsertBlock();
+
+  // Expressions.
+  Value *genExpr(const Expr *e);
+  Value *genLVal(const LValExpr *e);
+  Value *genCall(const CallExpr *e);
+  Value *genBinary(const BinaryExpr *e);
+  Value *genCmp(const BinaryExpr *e);
+  void genCond(const Expr *e, BasicBlock *ifTrue, BasicBlock *ifFalse);
+  // Address of the element or sub-array an lvalue designates. Arrays decay
+  // to a pointer to their first element when `decay` is set.
+  Value *genAddress(const LValExpr *e, const Symbol *sym, bool decay);
+  bool evalConst(const Expr *e, int32_t &result) const;
+  int32_t evalConstOrFail(const Expr *e) const;
+
+  AllocaInst *createEntryAlloca(Type *t, std::string_view name);
+  Function *getMemset();
+
+  Module &m_;
+  IRBuilder builder_;
+  Function *curFunc_ = nullptr;
+  AllocaInst *lastAlloca_ = nullptr;
+  std::vector<LoopTargets> loops_;
+
+  Arena symbolArena_;
+  std::unordered_map<std::string_view, Symbol *> symbols_;
+  std::vector<std::vector<Symbol *>> scopes_;
+  std::unordered_map<std::string_view, Function *> functions_;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "IR.h"
+
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Renders the IR as textual LLVM IR. Output is appended to a string so that
+// the whole module can be written to disk in one go.
+//
+// Local names are derived from the name hints: the first value with a given
+// hint gets the bare hint, later ones get "hint.N", and values without a hint
+// are printed as "t.N", where N is the value's position in the function.
+//
+// Given a thread pool, printModule prints the function definitions into
+// buffers of their own in parallel and appends them in module order, so the
+// text is the same as printed serially.
+void printModule(const Module &m, std::string &out,
+                 ThreadPool *pool = nullptr);
+// Prints the module with the function definitions taken from `bodies`, one
+// per definition in module order, as printed by printFunction.
+void printModule(const Module &m, const std::vector<std::string> &bodies,
+                 std::string &out);
+void printFunction(const Function &f, std::string &out);
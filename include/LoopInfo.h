@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Dominators.h"
+
+#include <memory>
+#include <vector>
+
+class LoopInfo;
+
+// A natural loop: a header that dominates a set of blocks with at least one
+// back edge from inside the set to the header. Loops nest; a block belongs
+// to the innermost loop containing it and, through it, to all enclosing
+// loops.
+class Loop {
+public:
+  BasicBlock *getHeader() const { return header_; }
+  Loop *getParentLoop() const { return parent_; }
+  const std::vector<Loop *> &getSubLoops() const { return subLoops_; }
+  bool isInnermost() const { return subLoops_.empty(); }
+  // 1 for outermost loops.
+  unsigned getLoopDepth() const { return depth_; }
+  // All blocks of the loop including those of subloops, in reverse
+  // post-order; the header comes first.
+  const std::vector<BasicBlock *> &getBlocks() const { return blocks_; }
+
+  bool contains(const Loop *l) const;
+  bool contains(const BasicBlock *bb) const;
+  bool contains(const Instruction *inst) const {
+    return contains(inst->getParent());
+  }
+  // Whether `v` is computed outside the loop (or is not an instruction).
+  bool isLoopInvariant(const Value *v) const;
+
+  // The single block outside the loop that branches to the header, if it
+  // branches nowhere else.
+  BasicBlock *getLoopPreheader() const;
+  // The single block inside the loop that branches back to the header.
+  BasicBlock *getLoopLatch() const;
+  // Blocks inside the loop with a successor outside of it.
+  std::vector<BasicBlock *> getExitingBlocks() const;
+  // Blocks outside the loop with a predecessor inside it, once each.
+  std::vector<BasicBlock *> getExitBlocks() const;
+  // Number of instructions in the loop's blocks.
+  unsigned getSize() const;
+
+private:
+  friend class LoopInfo;
+
+  Loop(const LoopInfo &li, BasicBlock *header) : li_(li), header_(header) {}
+
+  const LoopInfo &li_;
+  BasicBlock *header_;
+  Loop *parent_ = nullptr;
+  std::vector<Loop *> subLoops_;
+  std::vector<BasicBlock *> blocks_;
+  unsigned depth_ = 1;
+};
+
+// The loop forest of a function, found from the back edges of its dominator
+// tree. Like the tree it is built from, it identifies blocks by number and
+// goes stale once the CFG changes.
+class LoopInfo {
+public:
+  explicit LoopInfo(const DominatorTree &dt);
+
+  // Innermost loop containing `bb`, or null.
+  Loop *getLoopFor(const BasicBlock *bb) const {
+    return bb->getNumber() < loopFor_.size() ? loopFor_[bb->getNumber()]
+                                             : nullptr;
+  }
+  unsigned getLoopDepth(const BasicBlock *bb) const {
+    Loop *l = getLoopFor(bb);
+    return l ? l->getLoopDepth() : 0;
+  }
+  bool isLoopHeader(const BasicBlock *bb) const {
+    Loop *l = getLoopFor(bb);
+    return l && l->getHeader() == bb;
+  }
+
+  const std::vector<Loop *> &getTopLevelLoops() const { return topLevel_; }
+  bool empty() const { return loops_.empty(); }
+  // Every loop, each one after all of its subloops.
+  std::vector<Loop *> getLoopsInPostOrder() const;
+
+private:
+  std::vector<std::unique_ptr<Loop>> loops_;
+  std::vector<Loop *> loopFor_;
+  std::vector<Loop *> topLevel_;
+};
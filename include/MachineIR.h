@@ -0,0 +1,335 @@
+#pragma once
+
+#include "IR.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Machine IR of the x86-64 backend. Instructions are x86 instructions in
+// two-address form (the last operand is the destination, as in AT&T syntax)
+// whose register operands are virtual until register allocation replaces
+// them with physical ones. Physical registers may appear from the start
+// wherever the calling convention or an instruction demands one.
+
+using Reg = uint32_t;
+
+enum PhysReg : Reg {
+  RAX,
+  RCX,
+  RDX,
+  RBX,
+  RSP,
+  RBP,
+  RSI,
+  RDI,
+  R8,
+  R9,
+  R10,
+  R11,
+  R12,
+  R13,
+  R14,
+  R15,
+  kNumPhysRegs,
+};
+
+constexpr Reg kNoReg = ~0u;
+constexpr Reg kFirstVirtReg = kNumPhysRegs;
+
+inline bool isVirtReg(Reg r) { return r >= kFirstVirtReg && r != kNoReg; }
+inline bool isPhysReg(Reg r) { return r < kNumPhysRegs; }
+
+// The System V argument registers, in order.
+extern const Reg kArgRegs[6];
+// Registers a call may overwrite.
+extern const Reg kCallerSavedRegs[9];
+bool isCalleeSaved(Reg r);
+
+// Name of a physical register accessed with `size` bytes, e.g. "eax".
+const char *getRegName(Reg r, unsigned size);
+
+class MBlock;
+
+struct MOperand {
+  enum Kind : uint8_t { None, Register, Imm, Mem, Block };
+
+  Kind kind = None;
+  // Register: the register. Mem: the base register, or kNoReg when the base
+  // is a frame object or a global.
+  Reg reg = kNoReg;
+  // Mem: index register scaled by `scale`, or kNoReg.
+  Reg index = kNoReg;
+  uint8_t scale = 1;
+  // Mem: a frame object of the function, addressed relative to %rbp.
+  int frameIndex = -1;
+  // Mem: a global, addressed relative to %rip; it cannot have an index.
+  std::string_view symbol;
+  // Imm: the value. Mem: the displacement.
+  int64_t imm = 0;
+  MBlock *block = nullptr;
+
+  static MOperand makeReg(Reg r) {
+    MOperand op;
+    op.kind = Register;
+    op.reg = r;
+    return op;
+  }
+  static MOperand makeImm(int64_t v) {
+    MOperand op;
+    op.kind = Imm;
+    op.imm = v;
+    return op;
+  }
+  static MOperand makeMem(Reg base, int64_t disp = 0) {
+    MOperand op;
+    op.kind = Mem;
+    op.reg = base;
+    op.imm = disp;
+    return op;
+  }
+  static MOperand makeFrame(int index) {
+    MOperand op;
+    op.kind = Mem;
+    op.frameIndex = index;
+    return op;
+  }
+  static MOperand makeGlobal(std::string_view symbol) {
+    MOperand op;
+    op.kind = Mem;
+    op.symbol = symbol;
+    return op;
+  }
+  static MOperand makeLabel(MBlock *bb) {
+    MOperand op;
+    op.kind = Block;
+    op.block = bb;
+    return op;
+  }
+
+  bool isReg() const { return kind == Register; }
+  bool isImm() const { return kind == Imm; }
+  bool isMem() const { return kind == Mem; }
+};
+
+enum class MOpcode : uint8_t {
+  // dst = src.
+  Mov,
+  // dst64 = sign-extended src32.
+  Movsx,
+  // dst32 = zero-extended low byte of src.
+  Movzx8,
+  // dst64 = address of the memory operand src.
+  Lea,
+  // dst = dst op src.
+  Add,
+  Sub,
+  Imul,
+  And,
+  Or,
+  Xor,
+  // dst = dst shifted by src, an immediate or %rcx.
+  Shl,
+  Sar,
+  Shr,
+  // dst = -dst.
+  Neg,
+  // dst = src * ops[2] (an immediate).
+  Imul3,
+  // Sets flags from dst - src / dst & src.
+  Cmp,
+  Test,
+  // Low byte of dst = condition.
+  Setcc,
+  // %edx = sign of %eax.
+  Cdq,
+  // %eax, %edx = quotient and remainder of %edx:%eax / src.
+  Idiv,
+  // Calls ops[0] (a global), through the PLT if ops[1] is a nonzero
+  // immediate; uses the first `numArgRegs` argument registers and clobbers
+  // the caller-saved ones.
+  Call,
+  Jmp,
+  Jcc,
+  // Returns; uses %rax if the function returns a value.
+  Ret,
+};
+
+enum class CondCode : uint8_t { E, NE, L, G, LE, GE };
+
+CondCode getInverseCond(CondCode cc);
+const char *getCondSuffix(CondCode cc);
+
+struct MInst {
+  MOpcode opcode;
+  // Operand size in bytes: 4 or 8.
+  uint8_t size = 4;
+  CondCode cond = CondCode::E;
+  uint8_t numArgRegs = 0;
+  MOperand ops[3];
+
+  MInst(MOpcode op, unsigned size, MOperand src = {}, MOperand dst = {})
+      : opcode(op), size(size) {
+    ops[0] = src;
+    ops[1] = dst;
+  }
+
+  bool isCopy() const {
+    return opcode == MOpcode::Mov && ops[0].isReg() && ops[1].isReg();
+  }
+};
+
+// Calls fn(reg, isUse, isDef) for every register the instruction reads or
+// writes, implicit ones included. `reg` may be assigned to rewrite it.
+template <typename Fn> void forEachReg(MInst &inst, Fn fn);
+
+class MBlock {
+public:
+  explicit MBlock(unsigned number) : number_(number) {}
+
+  unsigned getNumber() const { return number_; }
+  std::vector<MInst> &insts() { return insts_; }
+  const std::vector<MInst> &insts() const { return insts_; }
+  void push_back(const MInst &inst) { insts_.push_back(inst); }
+
+  std::vector<MBlock *> &successors() { return succs_; }
+  const std::vector<MBlock *> &successors() const { return succs_; }
+  void addSuccessor(MBlock *bb);
+
+  // Loop nesting depth of the IR block the block was selected from.
+  unsigned loopDepth = 0;
+
+private:
+  unsigned number_;
+  std::vector<MInst> insts_;
+  std::vector<MBlock *> succs_;
+};
+
+struct FrameObject {
+  uint32_t size;
+  uint32_t align;
+  // Offset from %rbp, assigned by the register allocator.
+  int64_t offset = 0;
+};
+
+class MFunction {
+public:
+  explicit MFunction(std::string_view name) : name_(name) {}
+
+  std::string_view getName() const { return name_; }
+
+  // Blocks in layout order; the first one is the entry.
+  const std::vector<std::unique_ptr<MBlock>> &blocks() const {
+    return blocks_;
+  }
+  MBlock *createBlock();
+  // Lays the blocks out in the order given, which must contain every block.
+  void setLayout(const std::vector<MBlock *> &order);
+
+  Reg createVReg() { return numVRegs_++ + kFirstVirtReg; }
+  unsigned getNumVRegs() const { return numVRegs_; }
+
+  int createFrameObject(uint32_t size, uint32_t align);
+  std::vector<FrameObject> &frameObjects() { return frame_; }
+  const std::vector<FrameObject> &frameObjects() const { return frame_; }
+
+  // Bytes of stack arguments of the largest call.
+  uint32_t outgoingArgSize = 0;
+  // Set by the register allocator.
+  std::vector<Reg> calleeSavedRegs;
+  uint32_t frameSize = 0;
+
+private:
+  std::string_view name_;
+  std::vector<std::unique_ptr<MBlock>> blocks_;
+  std::vector<FrameObject> frame_;
+  unsigned numVRegs_ = 0;
+};
+
+// The stages of the backend; see CodeGen.h.
+void selectInstructions(Function &f, MFunction &mf);
+void allocateRegisters(MFunction &mf);
+void printMFunction(const MFunction &mf, std::string &out);
+
+template <typename Fn> void forEachReg(MInst &inst, Fn fn) {
+  auto memRegs = [&](MOperand &op) {
+    if (!op.isMem())
+      return;
+    if (op.reg != kNoReg)
+      fn(op.reg, true, false);
+    if (op.index != kNoReg)
+      fn(op.index, true, false);
+  };
+  MOperand &src = inst.ops[0], &dst = inst.ops[1];
+  memRegs(src);
+  memRegs(dst);
+  switch (inst.opcode) {
+  case MOpcode::Mov:
+  case MOpcode::Movsx:
+  case MOpcode::Movzx8:
+  case MOpcode::Lea:
+  case MOpcode::Imul3:
+    if (src.isReg())
+      fn(src.reg, true, false);
+    if (dst.isReg())
+      fn(dst.reg, false, true);
+    break;
+  case MOpcode::Add:
+  case MOpcode::Sub:
+  case MOpcode::Imul:
+  case MOpcode::And:
+  case MOpcode::Or:
+  case MOpcode::Xor:
+  case MOpcode::Shl:
+  case MOpcode::Sar:
+  case MOpcode::Shr:
+    if (src.isReg())
+      fn(src.reg, true, false);
+    fn(dst.reg, true, true);
+    break;
+  case MOpcode::Neg:
+    fn(dst.reg, true, true);
+    break;
+  case MOpcode::Cmp:
+  case MOpcode::Test:
+    if (src.isReg())
+      fn(src.reg, true, false);
+    if (dst.isReg())
+      fn(dst.reg, true, false);
+    break;
+  case MOpcode::Setcc:
+    fn(dst.reg, false, true);
+    break;
+  case MOpcode::Cdq: {
+    Reg rax = RAX, rdx = RDX;
+    fn(rax, true, false);
+    fn(rdx, false, true);
+    break;
+  }
+  case MOpcode::Idiv: {
+    Reg rax = RAX, rdx = RDX;
+    if (src.isReg())
+      fn(src.reg, true, false);
+    fn(rax, true, true);
+    fn(rdx, true, true);
+    break;
+  }
+  case MOpcode::Call:
+    for (unsigned i = 0; i < inst.numArgRegs; ++i) {
+      Reg r = kArgRegs[i];
+      fn(r, true, false);
+    }
+    for (Reg r : kCallerSavedRegs)
+      fn(r, false, true);
+    break;
+  case MOpcode::Ret:
+    if (src.isReg())
+      fn(src.reg, true, false);
+    break;
+  case MOpcode::Jmp:
+  case MOpcode::Jcc:
+    break;
+  }
+}
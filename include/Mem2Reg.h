@@ -0,0 +1,10 @@
+#pragma once
+
+#include "IR.h"
+
+// Promotes the scalar allocas of `f` that are only ever loaded from and
+// stored to into SSA values. Phis are placed at the iterated dominance
+// frontier of the stores, pruned to the blocks where the variable is live,
+// and loads are then renamed to the reaching definition. Reads of a variable
+// before any store see zero. Returns true if anything changed.
+bool promoteMemoryToRegister(Function &f);
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "IR.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Runs an ordered list of passes over a module. Consecutive function passes
+// form a group that is applied to one function at a time, so each function
+// goes through the whole group while its IR is still hot in the cache;
+// module passes run on their own between the groups.
+//
+// Given a thread pool, the functions of a group are processed in parallel.
+// Function passes only touch the function they run on, so the result is the
+// same as a serial run.
+//
+// With timing enabled, every pipeline entry records its time, how often it
+// ran and changed something, and the instruction count before and after.
+// The time of a function pass is summed over the functions, whichever
+// thread they ran on.
+class PassManager {
+public:
+  using FunctionPass = bool (*)(Function &);
+  using ModulePass = bool (*)(Module &);
+  // Called with the index of the pipeline entry after every run of it (once
+  // per function for function passes), on the thread that ran it.
+  using AfterPassCallback = std::function<void(size_t entry)>;
+
+  // Statistics of a pipeline entry, only collected when timing is enabled.
+  struct Stats {
+    double seconds = 0;
+    unsigned runs = 0;
+    unsigned changed = 0;
+    uint64_t instsBefore = 0;
+    uint64_t instsAfter = 0;
+
+    void add(const Stats &o);
+  };
+
+  void addPass(const char *name, FunctionPass pass);
+  void addModulePass(const char *name, ModulePass pass);
+  bool empty() const { return passes_.empty(); }
+
+  void setTimePasses(bool on) { timePasses_ = on; }
+  void setThreadPool(ThreadPool *pool) { pool_ = pool; }
+  void setAfterPassCallback(AfterPassCallback cb) {
+    afterPass_ = std::move(cb);
+  }
+  void run(Module &m) { run(m, 0, passes_.size()); }
+  // Runs the pipeline entries [first, last).
+  void run(Module &m, size_t first, size_t last);
+  // Runs the entries [first, last), which must all be function passes, on
+  // `functions` only.
+  void runOnFunctions(const std::vector<Function *> &functions, size_t first,
+                      size_t last);
+  // Appends the timing report as a table, one row per pipeline entry.
+  void printTimeReport(std::string &out) const;
+
+  size_t getNumEntries() const { return passes_.size(); }
+  const char *getEntryName(size_t i) const { return passes_[i].name; }
+  bool isModulePass(size_t i) const { return passes_[i].modulePass != nullptr; }
+  const Stats &getEntryStats(size_t i) const { return passes_[i].stats; }
+
+private:
+  struct Entry {
+    const char *name;
+    FunctionPass functionPass;
+    ModulePass modulePass;
+    Stats stats;
+  };
+
+  // Runs entries [first, last) on `f`, recording statistics in `stats`,
+  // one per entry.
+  void runFunctionPasses(size_t first, size_t last, Function &f,
+                         Stats *stats);
+
+  std::vector<Entry> passes_;
+  bool timePasses_ = false;
+  ThreadPool *pool_ = nullptr;
+  AfterPassCallback afterPass_;
+};
+
+// Fills `pm` with the standard pipeline: nothing at -O0, the scalar cleanup
+// passes at -O1, and redundancy elimination on top of them at -O2.
+void buildPipeline(PassManager &pm, unsigned optLevel);
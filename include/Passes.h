@@ -0,0 +1,57 @@
+#pragma once
+
+#include "IR.h"
+
+// The optimization passes. Each returns true if it changed the IR. Function
+// passes assume `promoteMemoryToRegister` (Mem2Reg.h) has already run.
+
+// Peephole simplification: constant folding, algebraic identities,
+// canonicalization (constants on the right, sub of a constant as add) and
+// strength reduction of multiplication, division and remainder by powers of
+// two.
+bool runInstCombine(Function &f);
+
+// Sparse conditional constant propagation. Also folds loads from constant
+// globals at constant indices and removes the blocks it proves unreachable.
+bool runSCCP(Function &f);
+
+// Dominator-scoped value numbering: replaces arithmetic, comparisons, casts,
+// address computations and loads that repeat a dominating one, and forwards
+// stored values to later loads of the same address.
+bool runGVN(Function &f);
+
+// Aggressive dead code elimination: everything is dead unless it is needed
+// by a side effect, a return, or a branch that one of those depends on.
+bool runADCE(Function &f);
+
+// CFG cleanup: folds constant and redundant branches, merges blocks into
+// their single predecessor, skips empty forwarding blocks and removes
+// unreachable code.
+bool runSimplifyCFG(Function &f);
+
+// Loop-invariant code motion into the loop preheaders, including loads of
+// memory the loop does not write and the invariant leading part of array
+// address computations.
+bool runLICM(Function &f);
+
+// Fully unrolls small loops with a constant trip count and partially
+// unrolls larger ones by a factor that divides the trip count.
+bool runLoopUnroll(Function &f);
+
+// Replaces array addresses indexed by an induction variable with pointers
+// that are advanced once per iteration.
+bool runLoopStrengthReduce(Function &f);
+
+// Turns self calls in tail position into a branch back to the top of the
+// function, so that tail recursion runs as a loop.
+bool runTailRecursionElimination(Function &f);
+
+// Inlines small functions, and functions with a single call site, into
+// their callers, bottom-up over the call graph (CallGraph.h). Recursive
+// functions and the sylib runtime are never inlined. Functions left without
+// callers are removed.
+bool runInliner(Module &m);
+
+// Marks globals that are never written as constant so that loads from them
+// can be folded.
+bool runGlobalOpt(Module &m);
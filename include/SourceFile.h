@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// A source file mapped read-only into memory. The contents stay valid, and
+// string_views into them stay valid, for the lifetime of the object.
+class SourceFile {
+public:
+  SourceFile() = default;
+  SourceFile(const SourceFile &) = delete;
+  SourceFile &operator=(const SourceFile &) = delete;
+  ~SourceFile();
+
+  // Maps `path`. On failure returns false and leaves a message in `error`.
+  bool open(const char *path, std::string &error);
+
+  std::string_view contents() const { return {data_, size_}; }
+
+private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  bool mapped_ = false;
+};
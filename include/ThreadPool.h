@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a deque of tasks: it pushes
+// and pops its own work at the back and, once that runs dry, steals from the
+// front of the others. A thread that waits for its tasks keeps running
+// tasks in the meantime, so parallel loops may nest (files of a batch, and
+// functions within each file) without tying up threads.
+class ThreadPool {
+public:
+  // A pool that runs work on `threads` threads in total, counting the thread
+  // that waits for it; 0 means one per hardware thread.
+  explicit ThreadPool(unsigned threads = 0);
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ~ThreadPool();
+
+  unsigned getThreadCount() const { return workers_.size() + 1; }
+
+  // Calls fn(i) for every i in [0, n) and returns once all calls are done.
+  // The calls may run in any order and on any thread, including this one.
+  void parallelFor(size_t n, const std::function<void(size_t)> &fn);
+
+private:
+  struct Task {
+    const std::function<void(size_t)> *fn;
+    size_t index;
+    std::atomic<size_t> *pending;
+  };
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void workerLoop(unsigned self);
+  // Runs one task, preferring `self`'s own deque (if the thread is a
+  // worker). Returns false if there was nothing to run.
+  bool runOne(int self);
+  bool steal(unsigned victim, Task &task);
+
+  std::vector<std::unique_ptr<Worker>> queues_;
+  std::vector<std::thread> workers_;
+  // Threads outside the pool hand their tasks to the workers round-robin.
+  std::atomic<unsigned> nextQueue_{0};
+  std::atomic<size_t> queued_{0};
+  std::mutex sleepMutex_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+};
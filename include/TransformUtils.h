@@ -0,0 +1,35 @@
+#pragma once
+
+#include "IR.h"
+
+// Helpers shared by the transformation passes.
+
+// Whether `inst` may be deleted once its result is unused.
+bool isInstructionTriviallyDead(const Instruction *inst);
+
+// Erases `inst` if it is trivially dead, then whichever of its operands
+// become trivially dead in turn. Returns true if `inst` was erased.
+bool recursivelyDeleteTriviallyDeadInstructions(Instruction *inst);
+
+// Deletes the blocks that cannot be reached from the entry block, removing
+// their entries from the phis of the blocks that remain.
+bool removeUnreachableBlocks(Function &f);
+
+// Replaces the terminator of `bb` by an unconditional branch to `dest`,
+// removing the phi entries of the successors that are no longer reached
+// through this edge. `dest` must already be a successor of `bb`.
+void foldBranchTo(BasicBlock *bb, BasicBlock *dest);
+
+// Gives every loop a preheader, a block outside the loop whose only
+// successor is the header, so that code can be hoisted out of the loop.
+// Returns true if any block was inserted.
+bool formPreheaders(Function &f);
+
+// The allocation a pointer is derived from (through GEPs and bitcasts): an
+// alloca, a global, or an argument of pointer type.
+Value *getUnderlyingObject(Value *ptr);
+
+// Whether memory reached from the underlying objects `a` and `b` may
+// overlap. Distinct allocas and globals never overlap, and an argument
+// cannot point into an alloca of its own function.
+bool mayAlias(Value *a, Value *b);
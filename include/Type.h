@@ -1,3 +1,124 @@
 #pragma once
 
-// TODO: In the course project, you need to properly organize the files.
\ No newline at end of file
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class IntegerType;
+class PointerType;
+class TypeContext;
+
+// IR types. Every distinct type is created once and lives for the rest of the
+// process, so types are compared by pointer and never freed. The factories
+// are thread-safe.
+class Type {
+public:
+  enum TypeID : uint8_t {
+    VoidTyID,
+    LabelTyID,
+    IntegerTyID,
+    PointerTyID,
+    ArrayTyID,
+    FunctionTyID,
+  };
+
+  Type(const Type &) = delete;
+  Type &operator=(const Type &) = delete;
+
+  TypeID getTypeID() const { return id_; }
+  bool isVoidTy() const { return id_ == VoidTyID; }
+  bool isLabelTy() const { return id_ == LabelTyID; }
+  bool isIntegerTy() const { return id_ == IntegerTyID; }
+  bool isIntegerTy(unsigned bits) const;
+  bool isPointerTy() const { return id_ == PointerTyID; }
+  bool isArrayTy() const { return id_ == ArrayTyID; }
+  bool isFunctionTy() const { return id_ == FunctionTyID; }
+
+  static Type *getVoidTy();
+  static Type *getLabelTy();
+  static IntegerType *getInt1Ty();
+  static IntegerType *getInt8Ty();
+  static IntegerType *getInt32Ty();
+  static IntegerType *getInt64Ty();
+
+  PointerType *getPointerTo();
+
+  // Allocation size in bytes. Only meaningful for first-class types.
+  uint64_t getSizeInBytes() const;
+
+  // Appends the LLVM spelling of the type, e.g. "[4 x i32]*".
+  void print(std::string &out) const;
+  std::string toString() const;
+
+protected:
+  friend class TypeContext;
+  explicit Type(TypeID id) : id_(id) {}
+  ~Type() = default;
+
+private:
+  TypeID id_;
+  std::atomic<PointerType *> pointerTo_{nullptr};
+};
+
+class IntegerType : public Type {
+public:
+  static IntegerType *get(unsigned bits);
+  unsigned getBitWidth() const { return bits_; }
+
+  static bool classof(const Type *t) { return t->getTypeID() == IntegerTyID; }
+
+private:
+  friend class TypeContext;
+  explicit IntegerType(unsigned bits) : Type(IntegerTyID), bits_(bits) {}
+  unsigned bits_;
+};
+
+class PointerType : public Type {
+public:
+  static PointerType *get(Type *elem) { return elem->getPointerTo(); }
+  Type *getElementType() const { return elem_; }
+
+  static bool classof(const Type *t) { return t->getTypeID() == PointerTyID; }
+
+private:
+  friend class TypeContext;
+  explicit PointerType(Type *elem) : Type(PointerTyID), elem_(elem) {}
+  Type *elem_;
+};
+
+class ArrayType : public Type {
+public:
+  static ArrayType *get(Type *elem, uint32_t numElements);
+  Type *getElementType() const { return elem_; }
+  uint32_t getNumElements() const { return numElements_; }
+
+  static bool classof(const Type *t) { return t->getTypeID() == ArrayTyID; }
+
+private:
+  friend class TypeContext;
+  ArrayType(Type *elem, uint32_t n)
+      : Type(ArrayTyID), elem_(elem), numElements_(n) {}
+  Type *elem_;
+  uint32_t numElements_;
+};
+
+class FunctionType : public Type {
+public:
+  static FunctionType *get(Type *ret, const std::vector<Type *> &params);
+  Type *getReturnType() const { return ret_; }
+  const std::vector<Type *> &getParamTypes() const { return params_; }
+  Type *getParamType(unsigned i) const { return params_[i]; }
+  unsigned getNumParams() const { return params_.size(); }
+
+  static bool classof(const Type *t) {
+    return t->getTypeID() == FunctionTyID;
+  }
+
+private:
+  friend class TypeContext;
+  FunctionType(Type *ret, std::vector<Type *> params)
+      : Type(FunctionTyID), ret_(ret), params_(std::move(params)) {}
+  Type *ret_;
+  std::vector<Type *> params_;
+};
@@ -0,0 +1,140 @@
+import re
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+# Test of the compilation cache: for every functional test, a second compile
+# must be a cache hit, and after a call to putint is added to one function,
+# the output built from the cached functions must be identical to a compile
+# without the cache, and the other functions must still be cache hits.
+
+OPTIONS = [["-O0"], ["-O2"], ["-O2", "-S"]]
+# Sources compiled one after the other into a fresh cache, each of which
+# must give the same result as a compile without the cache.
+SEQUENCES = {
+    # f is the same in both, but calls the library getint in the first and a
+    # definition that changes g in the second, so the cached f, with the load
+    # of g hoisted out of its loop, must not be reused.
+    "getint declared, then defined": [
+        "int g; int f(int n){int i=0; while(i<n-g){getint(); i=i+1;} "
+        "return i;} int main(){g=0; putint(f(3)); return 0;}",
+        "int g; int getint(){g=g+1; return 0;} int f(int n){int i=0; "
+        "while(i<n-g){getint(); i=i+1;} return i;} "
+        "int main(){g=0; putint(f(3)); return 0;}",
+    ],
+}
+FUNCTION_HEAD = re.compile(r"^(?:int|void)\s+\w+\s*\([^)]*\)\s*\{", re.M)
+
+
+def compile_file(compiler, cache_dir, options, sysy_file, out_file):
+    cache = ["--no-cache"] if cache_dir is None else ["--cache-dir", cache_dir]
+    result = subprocess.run(
+        ["timeout", "10s", compiler, *cache, "--cache-stats", *options,
+         sysy_file, out_file],
+        stderr=subprocess.PIPE,
+        text=True,
+    )
+    if result.returncode != 0:
+        return None, result.stderr.strip()
+    return Path(out_file).read_bytes(), result.stderr
+
+
+def cache_stats(stats, kind):
+    match = re.search(rf"^{kind}\s+(\d+) hits\s+(\d+) misses", stats, re.M)
+    return (int(match.group(1)), int(match.group(2))) if match else (0, 0)
+
+
+def check(compiler, cache_dir, options, sysy_file, tmp):
+    cached_out = str(Path(tmp) / "cached.out")
+    plain_out = str(Path(tmp) / "plain.out")
+    first, stats = compile_file(compiler, cache_dir, options, sysy_file,
+                                cached_out)
+    if first is None:
+        return f"compile error: {stats}"
+    # The number of functions left after the module passes. With more than
+    # one, an edit to one of them must leave some of the others cached.
+    functions = sum(cache_stats(stats, "Functions"))
+    second, stats = compile_file(compiler, cache_dir, options, sysy_file,
+                                 cached_out)
+    if second != first or cache_stats(stats, "Files")[0] != 1:
+        return "unchanged file is not a cache hit"
+
+    source = Path(sysy_file).read_text()
+    edited = Path(tmp) / "edited.sy"
+    for head in FUNCTION_HEAD.finditer(source):
+        name = re.match(r"\w+\s+(\w+)", head.group(0)).group(1)
+        edited.write_text(source[:head.end()] + "\n  putint(7);\n" +
+                          source[head.end():])
+        cached, stats = compile_file(compiler, cache_dir, options, edited,
+                                     cached_out)
+        plain, _ = compile_file(compiler, None, options, edited, plain_out)
+        if cached != plain:
+            return f"output differs after editing {name}"
+        if functions > 1 and cache_stats(stats, "Functions")[0] == 0:
+            return f"no function is cached after editing {name}"
+    return None
+
+
+def check_sequence(compiler, sources, options, tmp):
+    cache_dir = tempfile.mkdtemp(dir=tmp)
+    cached_out = str(Path(tmp) / "cached.out")
+    plain_out = str(Path(tmp) / "plain.out")
+    sysy_file = Path(tmp) / "sequence.sy"
+    for i, source in enumerate(sources):
+        sysy_file.write_text(source)
+        cached, _ = compile_file(compiler, cache_dir, options, sysy_file,
+                                 cached_out)
+        plain, _ = compile_file(compiler, None, options, sysy_file, plain_out)
+        if cached != plain:
+            return f"output of source {i + 1} differs"
+    return None
+
+
+def main():
+    compiler = sys.argv[1] if len(sys.argv) > 1 else "./build/compiler"
+    if not Path(compiler).exists():
+        print("compiler not found. Please build the project first.")
+        return 1
+    test_dir = Path("./test/resources/functional")
+    if not test_dir.exists():
+        print("Functional test directory not found.")
+        return 1
+
+    total_tests = 0
+    passed_tests = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        cache_dir = str(Path(tmp) / "cache")
+        for sysy_file in sorted(test_dir.glob("*.sy")):
+            for options in OPTIONS:
+                total_tests += 1
+                name = f"{sysy_file.stem} {' '.join(options)}".ljust(24)
+                error = check(compiler, cache_dir, options, sysy_file, tmp)
+                if error:
+                    print(f"[ERROR] {name}: \033[31m✗ Failed\033[0m")
+                    print(f"   {error}")
+                else:
+                    passed_tests += 1
+                    print(f"[INFO] {name}: \033[32m✓ Passed\033[0m")
+
+        for name, sources in SEQUENCES.items():
+            for options in [["-O1"], ["-O1", "-S"]]:
+                total_tests += 1
+                label = f"{name} {' '.join(options)}"
+                error = check_sequence(compiler, sources, options, tmp)
+                if error:
+                    print(f"[ERROR] {label}: \033[31m✗ Failed\033[0m")
+                    print(f"   {error}")
+                else:
+                    passed_tests += 1
+                    print(f"[INFO] {label}: \033[32m✓ Passed\033[0m")
+
+    print("\n📊 Compilation Cache Test Summary:")
+    print(f"   Total tests:  {total_tests}")
+    print(f"   Passed tests: \033[32m{passed_tests}\033[0m")
+    print(f"   Failed tests: \033[31m{total_tests - passed_tests}\033[0m")
+    return 0 if passed_tests == total_tests else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,76 @@
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+# Differential test of the two front ends: for every functional test, the
+# ANTLR front end and the fast front end must produce identical IR.
+
+OPT_LEVELS = ["-O0", "-O2"]
+
+
+def compile_ir(compiler, frontend, opt_level, sysy_file, out_file):
+    result = subprocess.run(
+        ["timeout", "10s", compiler, "--no-cache", opt_level,
+         f"--frontend={frontend}", sysy_file, out_file],
+        stderr=subprocess.PIPE,
+        text=True,
+    )
+    if result.returncode != 0:
+        return None, result.stderr.strip()
+    return Path(out_file).read_bytes(), ""
+
+
+def first_difference(a, b):
+    a_lines = a.decode(errors="replace").splitlines()
+    b_lines = b.decode(errors="replace").splitlines()
+    for i, (x, y) in enumerate(zip(a_lines, b_lines)):
+        if x != y:
+            return f"line {i + 1}:\n     antlr: {x}\n     fast:  {y}"
+    return f"length differs ({len(a_lines)} vs {len(b_lines)} lines)"
+
+
+def main():
+    compiler = sys.argv[1] if len(sys.argv) > 1 else "./build/compiler"
+    if not Path(compiler).exists():
+        print("compiler not found. Please build the project first.")
+        return 1
+    test_dir = Path("./test/resources/functional")
+    if not test_dir.exists():
+        print("Functional test directory not found.")
+        return 1
+
+    total_tests = 0
+    passed_tests = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        antlr_ll = str(Path(tmp) / "antlr.ll")
+        fast_ll = str(Path(tmp) / "fast.ll")
+        for sysy_file in sorted(test_dir.glob("*.sy")):
+            for opt_level in OPT_LEVELS:
+                total_tests += 1
+                name = f"{sysy_file.stem} {opt_level}".ljust(18)
+                antlr_ir, antlr_err = compile_ir(compiler, "antlr", opt_level,
+                                                 sysy_file, antlr_ll)
+                fast_ir, fast_err = compile_ir(compiler, "fast", opt_level,
+                                               sysy_file, fast_ll)
+                if antlr_ir is None or fast_ir is None:
+                    print(f"[ERROR] {name}: \033[31m✗ Compile Error\033[0m")
+                    for err in (antlr_err, fast_err):
+                        if err:
+                            print(f"   {err}")
+                elif antlr_ir != fast_ir:
+                    print(f"[ERROR] {name}: \033[31m✗ IR Mismatch\033[0m")
+                    print(f"   {first_difference(antlr_ir, fast_ir)}")
+                else:
+                    passed_tests += 1
+                    print(f"[INFO] {name}: \033[32m✓ Passed\033[0m")
+
+    print("\n📊 Front End Differential Test Summary:")
+    print(f"   Total tests:  {total_tests}")
+    print(f"   Passed tests: \033[32m{passed_tests}\033[0m")
+    print(f"   Failed tests: \033[31m{total_tests - passed_tests}\033[0m")
+    return 0 if passed_tests == total_tests else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,7 +1,18 @@
 import os
 import subprocess
+import sys
+import tempfile
 from pathlib import Path
 
+# With -S the tests are compiled to x86-64 assembly instead of LLVM IR.
+EMIT_ASM = "-S" in sys.argv[1:]
+SUFFIX = ".s" if EMIT_ASM else ".ll"
+# The tests always compile from scratch; the cache has run-cache-test.py.
+COMPILER_FLAGS = ["--no-cache"] + (["-S"] if EMIT_ASM else [])
+# With --batch the whole suite is compiled by one compiler process first;
+# files it leaves without output are compiled again one by one.
+BATCH = "--batch" in sys.argv[1:]
+
 def normalize_lines(content):
     lines = [line.rstrip() for line in content.splitlines()]
     while lines and not lines[-1]:
@@ -22,20 +33,33 @@ def generate_llvmir(sysy_file):
     test_dir = Path("./test/resources/functional")
     if not test_dir.exists():
         return False, "Functional test directory not found."
-    
+
     compiler = Path("./build/compiler")
     if not compiler.exists():
         return False, "compiler not found. Please build the project first."
-    
-    try:
-        base_name = sysy_file.stem
-        llvmir_file = test_dir / f"{base_name}.ll"
 
-        subprocess.run(["timeout", "10s", "./build/compiler", sysy_file, llvmir_file])
+    try:
+        llvmir_file = test_dir / f"{sysy_file.stem}{SUFFIX}"
+        subprocess.run(["timeout", "10s", "./build/compiler", *COMPILER_FLAGS,
+                        sysy_file, llvmir_file])
         return True, "Output generated successfully."
     except Exception as e:
         return False, str(e)
-    
+
+
+def generate_llvmir_batch(sysy_files):
+    """Compiles all files with one compiler process (see --batch)."""
+    if not Path("./build/compiler").exists():
+        return
+    test_dir = Path("./test/resources/functional")
+    with tempfile.NamedTemporaryFile("w", suffix=".txt") as list_file:
+        for sysy_file in sysy_files:
+            list_file.write(
+                f"{sysy_file} {test_dir / (sysy_file.stem + SUFFIX)}\n")
+        list_file.flush()
+        subprocess.run(["timeout", "120s", "./build/compiler",
+                        *COMPILER_FLAGS, "--batch", list_file.name])
+
 
 def execute_llvmir(llvmir_file):
     test_dir = Path("./test/resources/functional")
@@ -72,6 +96,7 @@ def execute_llvmir(llvmir_file):
 
 def main():    
     subprocess.run("rm -f ./test/resources/functional/*.ll", shell=True)
+    subprocess.run("rm -f ./test/resources/functional/*.s", shell=True)
     subprocess.run("rm -f ./test/resources/functional/*.output", shell=True)
     
     total_tests = 0
@@ -79,16 +104,22 @@ def main():
     results = {}
     
     test_dir = Path("./test/resources/functional")
-    
-    for sysy_file in sorted(test_dir.glob("*.sy"), key=lambda x: x.name[:2]):
+    sysy_files = sorted(test_dir.glob("*.sy"), key=lambda x: x.name[:2])
+    if BATCH:
+        generate_llvmir_batch(sysy_files)
+
+    for sysy_file in sysy_files:
 
         total_tests += 1
         base_name = sysy_file.stem
-        llvmir_file = test_dir / f"{base_name}.ll"
+        llvmir_file = test_dir / f"{base_name}{SUFFIX}"
         output_file = test_dir / f"{base_name}.output"
         ans_file = test_dir / f"{base_name}.out"
 
-        success, message = generate_llvmir(sysy_file)
+        if BATCH and llvmir_file.exists():
+            success, message = True, "Output generated by the batch compile."
+        else:
+            success, message = generate_llvmir(sysy_file)
         if not success:
             print(f"[ERROR] {base_name.ljust(14)}: \033[31m✗ LLVMIR Generation Failed\033[0m")  # 红色
             print(f"   {message}")
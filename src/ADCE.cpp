@@ -0,0 +1,180 @@
+#include "Dominators.h"
+#include "Passes.h"
+#include "TransformUtils.h"
+
+#include <vector>
+
+namespace {
+
+bool isMemset(const CallInst *call) {
+  return call->getCallee()->getName().substr(0, 11) == "llvm.memset";
+}
+
+// Collects the stores and memsets that write through `ptr` (or addresses
+// derived from it). Returns false if the memory is read or escapes.
+bool collectWrites(Value *ptr, std::vector<Instruction *> &writes) {
+  for (Use *u = ptr->getFirstUse(); u; u = u->getNext()) {
+    auto *user = cast<Instruction>(u->getUser());
+    if (isa<GetElementPtrInst>(user) || isa<CastInst>(user)) {
+      if (!collectWrites(user, writes))
+        return false;
+    } else if (auto *si = dyn_cast<StoreInst>(user)) {
+      if (si->getValueOperand() == ptr)
+        return false;
+      writes.push_back(si);
+    } else if (auto *call = dyn_cast<CallInst>(user)) {
+      if (!isMemset(call) || call->getArg(0) != ptr)
+        return false;
+      writes.push_back(call);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Aggressive dead code elimination. Instructions are assumed dead until
+// something with a side effect needs them; a block is needed once it
+// contains a live instruction, which in turn makes the branches it is
+// control dependent on (its reverse dominance frontier) live. Dead
+// conditional branches are replaced by a jump to the block's immediate
+// post-dominator, which cuts off the now unreachable dead region.
+class ADCE {
+public:
+  explicit ADCE(Function &f) : f_(f), pdt_(f), rdf_(pdt_) {}
+
+  bool run();
+
+private:
+  void markLive(Instruction *inst) {
+    if (inst->aux)
+      return;
+    inst->aux = 1;
+    work_.push_back(inst);
+    BasicBlock *bb = inst->getParent();
+    if (liveBlocks_[bb->getNumber()])
+      return;
+    liveBlocks_[bb->getNumber()] = true;
+    for (BasicBlock *cd : rdf_.get(bb))
+      markLive(cd->getTerminator());
+  }
+  bool isLive(const Instruction *inst) const { return inst->aux; }
+
+  void markRoots();
+  void propagate();
+  // Where a dead conditional branch in `bb` can jump instead, or null.
+  BasicBlock *getBranchTarget(BasicBlock *bb) const {
+    BasicBlock *ipdom = pdt_.getIDom(bb);
+    return ipdom && !isa<PhiInst>(ipdom->front()) ? ipdom : nullptr;
+  }
+
+  Function &f_;
+  PostDominatorTree pdt_;
+  DominanceFrontier rdf_;
+  std::vector<bool> liveBlocks_;
+  std::vector<Instruction *> work_;
+};
+
+void ADCE::markRoots() {
+  // Writes into local arrays that are never read are not roots.
+  for (Instruction *inst : *f_.getEntryBlock()) {
+    std::vector<Instruction *> w;
+    if (isa<AllocaInst>(inst) && collectWrites(inst, w))
+      for (Instruction *i : w)
+        i->aux = 2;
+  }
+
+  for (BasicBlock *bb : f_) {
+    auto *br = dyn_cast<BranchInst>(bb->getTerminator());
+    // Blocks that never reach an exit are infinite loops; keep them, and
+    // the branches into them, intact.
+    bool keepBranch = !pdt_.isReachable(bb);
+    if (br)
+      for (unsigned i = 0; i < br->getNumSuccessors(); ++i)
+        keepBranch |= !pdt_.isReachable(br->getSuccessor(i));
+    for (Instruction *inst : *bb) {
+      if (inst->aux == 2) {
+        inst->aux = 0;
+        continue;
+      }
+      if (isa<RetInst>(inst) || (inst->mayHaveSideEffects() &&
+                                 !inst->isTerminator()))
+        markLive(inst);
+    }
+    if (keepBranch)
+      markLive(bb->getTerminator());
+  }
+}
+
+void ADCE::propagate() {
+  while (!work_.empty()) {
+    Instruction *inst = work_.back();
+    work_.pop_back();
+    for (Use *u = inst->op_begin(); u != inst->op_end(); ++u)
+      if (auto *op = dyn_cast<Instruction>(u->get()))
+        markLive(op);
+    // A live phi needs the edges its values flow in on.
+    if (auto *phi = dyn_cast<PhiInst>(inst))
+      for (unsigned i = 0; i < phi->getNumIncoming(); ++i)
+        markLive(phi->getIncomingBlock(i)->getTerminator());
+  }
+}
+
+bool ADCE::run() {
+  for (BasicBlock *bb : f_)
+    for (Instruction *inst : *bb)
+      inst->aux = 0;
+  liveBlocks_.assign(pdt_.getNumBlocks(), false);
+  markRoots();
+  propagate();
+  // Branches that cannot be redirected have to stay, along with whatever
+  // they depend on.
+  for (bool again = true; again;) {
+    again = false;
+    for (BasicBlock *bb : f_) {
+      auto *br = dyn_cast<BranchInst>(bb->getTerminator());
+      if (br && br->isConditional() && !isLive(br) && !getBranchTarget(bb)) {
+        markLive(br);
+        again = true;
+      }
+    }
+    propagate();
+  }
+
+  bool changed = false;
+  std::vector<Instruction *> dead;
+  for (BasicBlock *bb : f_) {
+    for (Instruction *inst : *bb) {
+      if (isLive(inst))
+        continue;
+      auto *br = dyn_cast<BranchInst>(inst);
+      if (!br) {
+        dead.push_back(inst);
+        continue;
+      }
+      if (!br->isConditional())
+        continue;
+      // No live code depends on which way this branch goes, so go straight
+      // to the point where both sides meet again.
+      BasicBlock *ipdom = getBranchTarget(bb);
+      for (unsigned i = 0; i < br->getNumSuccessors(); ++i)
+        br->getSuccessor(i)->removePredecessor(bb);
+      Arena &arena = f_.getArena();
+      arena.create<BranchInst>(arena, ipdom)->insertBefore(br);
+      br->dropAllReferences();
+      dead.push_back(br);
+    }
+  }
+  // Dead instructions are only used by other dead ones.
+  for (Instruction *inst : dead)
+    inst->dropAllReferences();
+  for (Instruction *inst : dead)
+    inst->eraseFromParent();
+  changed |= !dead.empty();
+  changed |= removeUnreachableBlocks(f_);
+  return changed;
+}
+
+} // namespace
+
+bool runADCE(Function &f) { return ADCE(f).run(); }
@@ -0,0 +1,28 @@
+#include "AST.h"
+
+int32_t parseIntLiteral(std::string_view text) {
+  uint32_t value = 0;
+  size_t i = 0;
+  unsigned base = 10;
+  if (text.size() > 1 && text[0] == '0') {
+    if (text[1] == 'x' || text[1] == 'X') {
+      base = 16;
+      i = 2;
+    } else {
+      base = 8;
+      i = 1;
+    }
+  }
+  for (; i < text.size(); ++i) {
+    char c = text[i];
+    unsigned digit;
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      digit = c - 'a' + 10;
+    else
+      digit = c - 'A' + 10;
+    value = value * base + digit;
+  }
+  return static_cast<int32_t>(value);
+}
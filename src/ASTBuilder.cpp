@@ -0,0 +1,233 @@
+#include "ASTBuilder.h"
+
+CompUnit *ASTBuilder::build(SysYParser::ProgramContext *program) {
+  return std::any_cast<CompUnit *>(visit(program->compUnit()));
+}
+
+std::any ASTBuilder::visitCompUnit(SysYParser::CompUnitContext *ctx) {
+  std::vector<TopLevel> items;
+  for (antlr4::tree::ParseTree *child : ctx->children) {
+    TopLevel item;
+    if (auto *f = dynamic_cast<SysYParser::FuncDefContext *>(child))
+      item.func = std::any_cast<FuncDef *>(visit(f));
+    else if (auto *d = dynamic_cast<SysYParser::DeclContext *>(child))
+      item.decl = std::any_cast<DeclStmt *>(visit(d));
+    else
+      continue;
+    items.push_back(item);
+  }
+  return ctx_.create<CompUnit>(ctx_.copyArray(items));
+}
+
+std::any ASTBuilder::visitDecl(SysYParser::DeclContext *ctx) {
+  if (ctx->constDecl())
+    return visit(ctx->constDecl());
+  return visit(ctx->varDecl());
+}
+
+std::any ASTBuilder::visitConstDecl(SysYParser::ConstDeclContext *ctx) {
+  std::vector<VarDef *> defs;
+  for (auto *def : ctx->constDef())
+    defs.push_back(std::any_cast<VarDef *>(visit(def)));
+  return ctx_.create<DeclStmt>(ctx_.copyArray(defs), lineOf(ctx));
+}
+
+std::any ASTBuilder::visitVarDecl(SysYParser::VarDeclContext *ctx) {
+  std::vector<VarDef *> defs;
+  for (auto *def : ctx->varDef())
+    defs.push_back(std::any_cast<VarDef *>(visit(def)));
+  return ctx_.create<DeclStmt>(ctx_.copyArray(defs), lineOf(ctx));
+}
+
+std::any ASTBuilder::visitConstDef(SysYParser::ConstDefContext *ctx) {
+  auto *init = std::any_cast<InitVal *>(visit(ctx->constInitVal()));
+  return ctx_.create<VarDef>(text(ctx->IDENT()), exprList(ctx->constExp()),
+                             init, true, lineOf(ctx));
+}
+
+std::any ASTBuilder::visitVarDef(SysYParser::VarDefContext *ctx) {
+  InitVal *init = nullptr;
+  if (ctx->initVal())
+    init = std::any_cast<InitVal *>(visit(ctx->initVal()));
+  return ctx_.create<VarDef>(text(ctx->IDENT()), exprList(ctx->constExp()),
+                             init, false, lineOf(ctx));
+}
+
+std::any ASTBuilder::visitConstInitVal(SysYParser::ConstInitValContext *ctx) {
+  if (ctx->constExp())
+    return ctx_.create<InitVal>(expr(ctx->constExp()));
+  std::vector<InitVal *> list;
+  for (auto *item : ctx->constInitVal())
+    list.push_back(std::any_cast<InitVal *>(visit(item)));
+  return ctx_.create<InitVal>(ctx_.copyArray(list));
+}
+
+std::any ASTBuilder::visitInitVal(SysYParser::InitValContext *ctx) {
+  if (ctx->exp())
+    return ctx_.create<InitVal>(expr(ctx->exp()));
+  std::vector<InitVal *> list;
+  for (auto *item : ctx->initVal())
+    list.push_back(std::any_cast<InitVal *>(visit(item)));
+  return ctx_.create<InitVal>(ctx_.copyArray(list));
+}
+
+std::any ASTBuilder::visitFuncDef(SysYParser::FuncDefContext *ctx) {
+  std::vector<FuncParam *> params;
+  if (ctx->funcFParams())
+    for (auto *p : ctx->funcFParams()->funcFParam())
+      params.push_back(std::any_cast<FuncParam *>(visit(p)));
+  auto *body = std::any_cast<BlockStmt *>(visit(ctx->block()));
+  return ctx_.create<FuncDef>(ctx->funcType()->VOID() != nullptr,
+                              text(ctx->IDENT()), ctx_.copyArray(params), body,
+                              lineOf(ctx));
+}
+
+std::any ASTBuilder::visitFuncFParam(SysYParser::FuncFParamContext *ctx) {
+  return ctx_.create<FuncParam>(text(ctx->IDENT()), !ctx->L_BRACKT().empty(),
+                                exprList(ctx->exp()));
+}
+
+std::any ASTBuilder::visitBlock(SysYParser::BlockContext *ctx) {
+  std::vector<Stmt *> items;
+  for (auto *item : ctx->blockItem()) {
+    if (item->decl())
+      items.push_back(std::any_cast<DeclStmt *>(visit(item->decl())));
+    else
+      items.push_back(stmt(item->stmt()));
+  }
+  return ctx_.create<BlockStmt>(ctx_.copyArray(items), lineOf(ctx));
+}
+
+//===----------------------------------------------------------------------===//
+// Statements
+//===----------------------------------------------------------------------===//
+
+std::any ASTBuilder::visitAssignStmt(SysYParser::AssignStmtContext *ctx) {
+  auto *lval = cast<LValExpr>(std::any_cast<Expr *>(visit(ctx->lVal())));
+  return static_cast<Stmt *>(
+      ctx_.create<AssignStmt>(lval, expr(ctx->exp()), lineOf(ctx)));
+}
+
+std::any ASTBuilder::visitExpStmt(SysYParser::ExpStmtContext *ctx) {
+  Expr *e = ctx->exp() ? expr(ctx->exp()) : nullptr;
+  return static_cast<Stmt *>(ctx_.create<ExprStmt>(e, lineOf(ctx)));
+}
+
+std::any ASTBuilder::visitBlockStmt(SysYParser::BlockStmtContext *ctx) {
+  return static_cast<Stmt *>(std::any_cast<BlockStmt *>(visit(ctx->block())));
+}
+
+std::any ASTBuilder::visitIfStmt(SysYParser::IfStmtContext *ctx) {
+  Expr *cond = expr(ctx->cond());
+  Stmt *thenStmt = stmt(ctx->stmt(0));
+  Stmt *elseStmt = ctx->ELSE() ? stmt(ctx->stmt(1)) : nullptr;
+  return static_cast<Stmt *>(
+      ctx_.create<IfStmt>(cond, thenStmt, elseStmt, lineOf(ctx)));
+}
+
+std::any ASTBuilder::visitWhileStmt(SysYParser::WhileStmtContext *ctx) {
+  Expr *cond = expr(ctx->cond());
+  return static_cast<Stmt *>(
+      ctx_.create<WhileStmt>(cond, stmt(ctx->stmt()), lineOf(ctx)));
+}
+
+std::any ASTBuilder::visitBreakStmt(SysYParser::BreakStmtContext *ctx) {
+  return static_cast<Stmt *>(ctx_.create<BreakStmt>(lineOf(ctx)));
+}
+
+std::any ASTBuilder::visitContinueStmt(SysYParser::ContinueStmtContext *ctx) {
+  return static_cast<Stmt *>(ctx_.create<ContinueStmt>(lineOf(ctx)));
+}
+
+std::any ASTBuilder::visitReturnStmt(SysYParser::ReturnStmtContext *ctx) {
+  Expr *value = ctx->exp() ? expr(ctx->exp()) : nullptr;
+  return static_cast<Stmt *>(ctx_.create<ReturnStmt>(value, lineOf(ctx)));
+}
+
+//===----------------------------------------------------------------------===//
+// Expressions
+//===----------------------------------------------------------------------===//
+
+Expr *ASTBuilder::binary(BinaryOp op, antlr4::tree::ParseTree *lhs,
+                         antlr4::tree::ParseTree *rhs,
+                         antlr4::ParserRuleContext *ctx) {
+  Expr *l = expr(lhs);
+  Expr *r = expr(rhs);
+  return ctx_.create<BinaryExpr>(op, l, r, lineOf(ctx));
+}
+
+std::any ASTBuilder::visitParenExp(SysYParser::ParenExpContext *ctx) {
+  return visit(ctx->exp());
+}
+
+std::any ASTBuilder::visitLValExp(SysYParser::LValExpContext *ctx) {
+  return visit(ctx->lVal());
+}
+
+std::any ASTBuilder::visitNumberExp(SysYParser::NumberExpContext *ctx) {
+  int32_t v = parseIntLiteral(ctx->number()->INTEGER_CONST()->getText());
+  return static_cast<Expr *>(ctx_.create<IntLiteral>(v, lineOf(ctx)));
+}
+
+std::any ASTBuilder::visitCallExp(SysYParser::CallExpContext *ctx) {
+  std::vector<Expr *> args;
+  if (ctx->funcRParams())
+    for (auto *p : ctx->funcRParams()->param())
+      args.push_back(expr(p->exp()));
+  return static_cast<Expr *>(ctx_.create<CallExpr>(
+      text(ctx->IDENT()), ctx_.copyArray(args), lineOf(ctx)));
+}
+
+std::any ASTBuilder::visitUnaryExp(SysYParser::UnaryExpContext *ctx) {
+  UnaryOp op = ctx->unaryOp()->PLUS()    ? UnaryOp::Plus
+               : ctx->unaryOp()->MINUS() ? UnaryOp::Minus
+                                         : UnaryOp::Not;
+  return static_cast<Expr *>(
+      ctx_.create<UnaryExpr>(op, expr(ctx->exp()), lineOf(ctx)));
+}
+
+std::any ASTBuilder::visitMulExp(SysYParser::MulExpContext *ctx) {
+  BinaryOp op = ctx->MUL()   ? BinaryOp::Mul
+                : ctx->DIV() ? BinaryOp::Div
+                             : BinaryOp::Mod;
+  return binary(op, ctx->exp(0), ctx->exp(1), ctx);
+}
+
+std::any ASTBuilder::visitAddExp(SysYParser::AddExpContext *ctx) {
+  BinaryOp op = ctx->PLUS() ? BinaryOp::Add : BinaryOp::Sub;
+  return binary(op, ctx->exp(0), ctx->exp(1), ctx);
+}
+
+std::any ASTBuilder::visitExpCond(SysYParser::ExpCondContext *ctx) {
+  return visit(ctx->exp());
+}
+
+std::any ASTBuilder::visitRelCond(SysYParser::RelCondContext *ctx) {
+  BinaryOp op = ctx->LT()   ? BinaryOp::Lt
+                : ctx->GT() ? BinaryOp::Gt
+                : ctx->LE() ? BinaryOp::Le
+                            : BinaryOp::Ge;
+  return binary(op, ctx->cond(0), ctx->cond(1), ctx);
+}
+
+std::any ASTBuilder::visitEqCond(SysYParser::EqCondContext *ctx) {
+  BinaryOp op = ctx->EQ() ? BinaryOp::Eq : BinaryOp::Ne;
+  return binary(op, ctx->cond(0), ctx->cond(1), ctx);
+}
+
+std::any ASTBuilder::visitAndCond(SysYParser::AndCondContext *ctx) {
+  return binary(BinaryOp::And, ctx->cond(0), ctx->cond(1), ctx);
+}
+
+std::any ASTBuilder::visitOrCond(SysYParser::OrCondContext *ctx) {
+  return binary(BinaryOp::Or, ctx->cond(0), ctx->cond(1), ctx);
+}
+
+std::any ASTBuilder::visitLVal(SysYParser::LValContext *ctx) {
+  return static_cast<Expr *>(ctx_.create<LValExpr>(
+      text(ctx->IDENT()), exprList(ctx->exp()), lineOf(ctx)));
+}
+
+std::any ASTBuilder::visitConstExp(SysYParser::ConstExpContext *ctx) {
+  return visit(ctx->exp());
+}
@@ -0,0 +1,44 @@
+#include "Arena.h"
+
+#include <cstdlib>
+
+static constexpr size_t kMaxSlabSize = 1 << 20;
+
+Arena::~Arena() {
+  for (char *slab : slabs_)
+    std::free(slab);
+}
+
+void *Arena::allocateSlow(size_t size, size_t align) {
+  size_t need = size + align - 1;
+  // Oversized requests get a dedicated slab so that the current one, which
+  // probably still has room, keeps being used for small objects.
+  if (need > nextSlabSize_ / 2 && cur_ != 0) {
+    char *slab = static_cast<char *>(std::malloc(need));
+    if (!slab)
+      throw std::bad_alloc();
+    slabs_.push_back(slab);
+    bytesReserved_ += need;
+    bytesUsed_ += size;
+    uintptr_t p = reinterpret_cast<uintptr_t>(slab);
+    return reinterpret_cast<void *>((p + align - 1) & ~(uintptr_t)(align - 1));
+  }
+
+  size_t slabSize = nextSlabSize_;
+  while (slabSize < need)
+    slabSize *= 2;
+  if (nextSlabSize_ < kMaxSlabSize)
+    nextSlabSize_ *= 2;
+
+  char *slab = static_cast<char *>(std::malloc(slabSize));
+  if (!slab)
+    throw std::bad_alloc();
+  slabs_.push_back(slab);
+  bytesReserved_ += slabSize;
+  cur_ = reinterpret_cast<uintptr_t>(slab);
+  end_ = cur_ + slabSize;
+  uintptr_t p = (cur_ + align - 1) & ~(uintptr_t)(align - 1);
+  cur_ = p + size;
+  bytesUsed_ += size;
+  return reinterpret_cast<void *>(p);
+}
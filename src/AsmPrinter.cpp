@@ -0,0 +1,280 @@
+#include "MachineIR.h"
+
+#include <charconv>
+
+namespace {
+
+void appendInt(std::string &out, int64_t v) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), v);
+  out.append(buf, res.ptr);
+}
+
+class AsmPrinter {
+public:
+  AsmPrinter(const MFunction &mf, std::string &out) : mf_(mf), out_(out) {}
+
+  void print();
+
+private:
+  void printLabel(const MBlock *bb);
+  void printReg(Reg r, unsigned size);
+  void printOperand(const MOperand &op, unsigned size);
+  void printInst(const MInst &inst, const MBlock *next);
+  // Prints a jump to `target`, conditional unless `cc` is null.
+  void printJump(const CondCode *cc, const MBlock *target);
+  void printEpilogue();
+  // Appends "\t<mnemonic><suffix>\t".
+  void mnemonic(const char *name, unsigned size);
+
+  const MFunction &mf_;
+  std::string &out_;
+};
+
+void AsmPrinter::printLabel(const MBlock *bb) {
+  out_ += ".LBB_";
+  out_ += mf_.getName();
+  out_ += '_';
+  appendInt(out_, bb->getNumber());
+}
+
+void AsmPrinter::printReg(Reg r, unsigned size) {
+  out_ += '%';
+  out_ += getRegName(r, size);
+}
+
+void AsmPrinter::printOperand(const MOperand &op, unsigned size) {
+  switch (op.kind) {
+  case MOperand::Register:
+    printReg(op.reg, size);
+    return;
+  case MOperand::Imm:
+    out_ += '$';
+    appendInt(out_, op.imm);
+    return;
+  case MOperand::Block:
+    printLabel(op.block);
+    return;
+  case MOperand::Mem:
+    break;
+  default:
+    return;
+  }
+  if (!op.symbol.empty()) {
+    out_ += op.symbol;
+    if (op.imm > 0)
+      out_ += '+';
+    if (op.imm)
+      appendInt(out_, op.imm);
+    out_ += "(%rip)";
+    return;
+  }
+  int64_t disp = op.imm;
+  Reg base = op.reg;
+  if (op.frameIndex >= 0) {
+    disp += mf_.frameObjects()[op.frameIndex].offset;
+    base = RBP;
+  }
+  if (disp)
+    appendInt(out_, disp);
+  out_ += '(';
+  printReg(base, 8);
+  if (op.index != kNoReg) {
+    out_ += ',';
+    printReg(op.index, 8);
+    out_ += ',';
+    appendInt(out_, op.scale);
+  }
+  out_ += ')';
+}
+
+void AsmPrinter::mnemonic(const char *name, unsigned size) {
+  out_ += '\t';
+  out_ += name;
+  if (size)
+    out_ += size == 8 ? 'q' : 'l';
+  out_ += '\t';
+}
+
+void AsmPrinter::printEpilogue() {
+  size_t saved = mf_.calleeSavedRegs.size();
+  if (saved) {
+    out_ += "\tleaq\t-";
+    appendInt(out_, 8 * saved);
+    out_ += "(%rbp), %rsp\n";
+    for (size_t i = saved; i-- > 0;) {
+      out_ += "\tpopq\t";
+      printReg(mf_.calleeSavedRegs[i], 8);
+      out_ += '\n';
+    }
+    out_ += "\tpopq\t%rbp\n";
+  } else if (mf_.frameSize) {
+    out_ += "\tleave\n";
+  } else {
+    out_ += "\tpopq\t%rbp\n";
+  }
+  out_ += "\tret\n";
+}
+
+void AsmPrinter::printJump(const CondCode *cc, const MBlock *target) {
+  out_ += "\tj";
+  out_ += cc ? getCondSuffix(*cc) : "mp";
+  out_ += '\t';
+  printLabel(target);
+  out_ += '\n';
+}
+
+void AsmPrinter::printInst(const MInst &inst, const MBlock *next) {
+  static const char *const kALU[] = {"add", "sub", "imul", "and", "or",
+                                     "xor", "shl", "sar",  "shr"};
+  const MOperand &src = inst.ops[0], &dst = inst.ops[1];
+  unsigned size = inst.size;
+  switch (inst.opcode) {
+  case MOpcode::Mov:
+    mnemonic("mov", size);
+    break;
+  case MOpcode::Movsx:
+    out_ += "\tmovslq\t";
+    printOperand(src, 4);
+    out_ += ", ";
+    printOperand(dst, 8);
+    out_ += '\n';
+    return;
+  case MOpcode::Movzx8:
+    out_ += "\tmovzbl\t";
+    printOperand(src, 1);
+    out_ += ", ";
+    printOperand(dst, 4);
+    out_ += '\n';
+    return;
+  case MOpcode::Lea:
+    mnemonic("lea", 8);
+    break;
+  case MOpcode::Add:
+  case MOpcode::Sub:
+  case MOpcode::Imul:
+  case MOpcode::And:
+  case MOpcode::Or:
+  case MOpcode::Xor:
+  case MOpcode::Shl:
+  case MOpcode::Sar:
+  case MOpcode::Shr: {
+    unsigned i = unsigned(inst.opcode) - unsigned(MOpcode::Add);
+    mnemonic(kALU[i], size);
+    // Variable shift counts are in %cl.
+    bool isShift = inst.opcode >= MOpcode::Shl;
+    printOperand(src, isShift && src.isReg() ? 1 : size);
+    out_ += ", ";
+    printOperand(dst, size);
+    out_ += '\n';
+    return;
+  }
+  case MOpcode::Neg:
+    mnemonic("neg", size);
+    printOperand(dst, size);
+    out_ += '\n';
+    return;
+  case MOpcode::Imul3:
+    mnemonic("imul", size);
+    printOperand(inst.ops[2], size);
+    out_ += ", ";
+    break;
+  case MOpcode::Cmp:
+    mnemonic("cmp", size);
+    break;
+  case MOpcode::Test:
+    mnemonic("test", size);
+    break;
+  case MOpcode::Setcc:
+    out_ += "\tset";
+    out_ += getCondSuffix(inst.cond);
+    out_ += '\t';
+    printOperand(dst, 1);
+    out_ += '\n';
+    return;
+  case MOpcode::Cdq:
+    out_ += "\tcltd\n";
+    return;
+  case MOpcode::Idiv:
+    mnemonic("idiv", size);
+    printOperand(src, size);
+    out_ += '\n';
+    return;
+  case MOpcode::Call:
+    out_ += "\tcall\t";
+    out_ += src.symbol;
+    if (dst.isImm() && dst.imm)
+      out_ += "@PLT";
+    out_ += '\n';
+    return;
+  case MOpcode::Jmp:
+    if (src.block != next)
+      printJump(nullptr, src.block);
+    return;
+  case MOpcode::Jcc:
+    printJump(&inst.cond, src.block);
+    return;
+  case MOpcode::Ret:
+    printEpilogue();
+    return;
+  }
+  printOperand(src, size);
+  out_ += ", ";
+  printOperand(dst, size);
+  out_ += '\n';
+}
+
+void AsmPrinter::print() {
+  std::string_view name = mf_.getName();
+  out_ += "\t.globl\t";
+  out_ += name;
+  out_ += "\n\t.p2align\t4, 0x90\n\t.type\t";
+  out_ += name;
+  out_ += ",@function\n";
+  out_ += name;
+  out_ += ":\n\tpushq\t%rbp\n\tmovq\t%rsp, %rbp\n";
+  for (Reg r : mf_.calleeSavedRegs) {
+    out_ += "\tpushq\t";
+    printReg(r, 8);
+    out_ += '\n';
+  }
+  if (mf_.frameSize) {
+    out_ += "\tsubq\t$";
+    appendInt(out_, mf_.frameSize);
+    out_ += ", %rsp\n";
+  }
+
+  const auto &blocks = mf_.blocks();
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    const MBlock *bb = blocks[b].get();
+    const MBlock *next = b + 1 < blocks.size() ? blocks[b + 1].get() : nullptr;
+    if (b) {
+      printLabel(bb);
+      out_ += ":\n";
+    }
+    const std::vector<MInst> &insts = bb->insts();
+    for (size_t i = 0; i < insts.size(); ++i) {
+      // A conditional jump to the next block followed by a jump elsewhere
+      // becomes the inverse conditional jump to the other target.
+      if (insts[i].opcode == MOpcode::Jcc && insts[i].ops[0].block == next &&
+          i + 1 < insts.size() && insts[i + 1].opcode == MOpcode::Jmp) {
+        CondCode cc = getInverseCond(insts[i].cond);
+        printJump(&cc, insts[i + 1].ops[0].block);
+        ++i;
+        continue;
+      }
+      printInst(insts[i], next);
+    }
+  }
+  out_ += "\t.size\t";
+  out_ += name;
+  out_ += ", .-";
+  out_ += name;
+  out_ += '\n';
+}
+
+} // namespace
+
+void printMFunction(const MFunction &mf, std::string &out) {
+  AsmPrinter(mf, out).print();
+}
@@ -0,0 +1,83 @@
+#include "CallGraph.h"
+
+#include <algorithm>
+#include <utility>
+
+CallGraph::CallGraph(const Module &m) {
+  for (const auto &f : m.functions()) {
+    if (f->isDeclaration())
+      continue;
+    index_[f.get()] = functions_.size();
+    functions_.push_back(f.get());
+  }
+  unsigned n = functions_.size();
+  callSites_.resize(n);
+  recursive_.assign(n, false);
+  std::vector<std::vector<unsigned>> callees(n);
+  for (unsigned i = 0; i < n; ++i) {
+    for (BasicBlock *bb : *functions_[i]) {
+      for (Instruction *inst : *bb) {
+        auto *call = dyn_cast<CallInst>(inst);
+        if (!call)
+          continue;
+        callSites_[i].push_back(call);
+        Function *callee = call->getCallee();
+        if (callee->isDeclaration())
+          continue;
+        unsigned j = indexOf(callee);
+        if (j == i)
+          recursive_[i] = true;
+        callees[i].push_back(j);
+      }
+    }
+  }
+
+  // Tarjan's algorithm, iteratively. Components are completed callees
+  // first, which is the bottom-up order.
+  constexpr unsigned kUnvisited = ~0u;
+  std::vector<unsigned> order(n, kUnvisited), low(n, 0);
+  std::vector<bool> onStack(n, false);
+  std::vector<unsigned> stack;
+  std::vector<std::pair<unsigned, size_t>> walk;
+  unsigned clock = 0;
+  for (unsigned root = 0; root < n; ++root) {
+    if (order[root] != kUnvisited)
+      continue;
+    walk.emplace_back(root, 0);
+    while (!walk.empty()) {
+      auto &[v, next] = walk.back();
+      if (next == 0 && order[v] == kUnvisited) {
+        order[v] = low[v] = clock++;
+        stack.push_back(v);
+        onStack[v] = true;
+      }
+      if (next < callees[v].size()) {
+        unsigned w = callees[v][next++];
+        if (order[w] == kUnvisited)
+          walk.emplace_back(w, 0);
+        else if (onStack[w])
+          low[v] = std::min(low[v], order[w]);
+        continue;
+      }
+      unsigned done = v;
+      walk.pop_back();
+      if (!walk.empty())
+        low[walk.back().first] = std::min(low[walk.back().first], low[done]);
+      if (low[done] != order[done])
+        continue;
+      std::vector<Function *> scc;
+      unsigned w;
+      do {
+        w = stack.back();
+        stack.pop_back();
+        onStack[w] = false;
+        scc.push_back(functions_[w]);
+      } while (w != done);
+      if (scc.size() > 1)
+        for (Function *f : scc)
+          recursive_[indexOf(f)] = true;
+      std::reverse(scc.begin(), scc.end());
+      sccs_.push_back(std::move(scc));
+    }
+  }
+}
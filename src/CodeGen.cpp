@@ -0,0 +1,103 @@
+#include "CodeGen.h"
+#include "MachineIR.h"
+#include "ThreadPool.h"
+
+#include <charconv>
+
+namespace {
+
+void appendInt(std::string &out, int64_t v) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), v);
+  out.append(buf, res.ptr);
+}
+
+// Globals hold i32 scalars and arrays. Runs of zeroes in the initializer
+// are emitted with .zero, and zero-initialized variables go to .bss.
+void printGlobal(const GlobalVariable *g, std::string &out) {
+  uint64_t size = g->getValueType()->getSizeInBytes();
+  ArrayRef<int32_t> init = g->getInitializer();
+  bool isZero = true;
+  for (int32_t v : init)
+    isZero &= v == 0;
+  if (g->isConstant())
+    out += "\t.section\t.rodata\n";
+  else
+    out += isZero ? "\t.bss\n" : "\t.data\n";
+  if (!g->isPrivate()) {
+    out += "\t.globl\t";
+    out += g->getName();
+    out += '\n';
+  }
+  out += size >= 16 ? "\t.p2align\t4\n" : "\t.p2align\t2\n";
+  out += "\t.type\t";
+  out += g->getName();
+  out += ",@object\n\t.size\t";
+  out += g->getName();
+  out += ", ";
+  appendInt(out, size);
+  out += '\n';
+  out += g->getName();
+  out += ":\n";
+
+  uint64_t count = size / 4;
+  for (uint64_t i = 0; i < count;) {
+    uint64_t zeroes = 0;
+    while (i + zeroes < count && g->getInitialElement(i + zeroes) == 0)
+      ++zeroes;
+    if (zeroes) {
+      out += "\t.zero\t";
+      appendInt(out, 4 * zeroes);
+      out += '\n';
+      i += zeroes;
+      continue;
+    }
+    out += "\t.long\t";
+    appendInt(out, g->getInitialElement(i++));
+    out += '\n';
+  }
+}
+
+void printGlobals(const Module &m, std::string &out) {
+  for (const GlobalVariable *g : m.globals())
+    printGlobal(g, out);
+  out += "\t.section\t.note.GNU-stack,\"\",@progbits\n";
+}
+
+} // namespace
+
+void emitFunction(Function &f, std::string &out) {
+  MFunction mf(f.getName());
+  selectInstructions(f, mf);
+  allocateRegisters(mf);
+  printMFunction(mf, out);
+}
+
+void emitAssembly(Module &m, std::string &out, ThreadPool *pool) {
+  std::vector<Function *> definitions;
+  for (const auto &f : m.functions())
+    if (!f->isDeclaration())
+      definitions.push_back(f.get());
+
+  out += "\t.text\n";
+  if (!pool) {
+    for (Function *f : definitions)
+      emitFunction(*f, out);
+  } else {
+    std::vector<std::string> bodies(definitions.size());
+    pool->parallelFor(definitions.size(), [&](size_t i) {
+      emitFunction(*definitions[i], bodies[i]);
+    });
+    for (const std::string &body : bodies)
+      out += body;
+  }
+  printGlobals(m, out);
+}
+
+void emitAssembly(const Module &m, const std::vector<std::string> &bodies,
+                  std::string &out) {
+  out += "\t.text\n";
+  for (const std::string &body : bodies)
+    out += body;
+  printGlobals(m, out);
+}
@@ -0,0 +1,257 @@
+#include "CompileCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sys/file.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+uint64_t rotl(uint64_t x, unsigned r) { return x << r | x >> (64 - r); }
+
+// The finalizer of MurmurHash3.
+uint64_t fmix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccd;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53;
+  h ^= h >> 33;
+  return h;
+}
+
+// Bumped whenever the format of the entries or the keys changes.
+constexpr const char *kCacheFormat = "sysy-cache-1";
+
+// The file holding the total size of the entries, next to the
+// subdirectories of the entries. An entry stored by two racing processes
+// is counted twice until the next scan corrects the record.
+constexpr const char *kSizeRecord = "size";
+
+} // namespace
+
+void Hasher::mix(uint64_t word) {
+  h1_ = rotl((h1_ ^ word) * 0x87c37b91114253d5, 31);
+  h2_ = rotl((h2_ ^ word) * 0x4cf5ad432745937f, 33) + h1_;
+}
+
+void Hasher::update(std::string_view bytes) {
+  update(static_cast<uint64_t>(bytes.size()));
+  const char *p = bytes.data();
+  size_t n = bytes.size();
+  for (; n >= 8; p += 8, n -= 8) {
+    uint64_t word;
+    std::memcpy(&word, p, 8);
+    mix(word);
+  }
+  if (n) {
+    uint64_t word = 0;
+    std::memcpy(&word, p, n);
+    mix(word);
+  }
+  length_ += bytes.size();
+}
+
+void Hasher::update(uint64_t value) {
+  mix(value);
+  length_ += 8;
+}
+
+std::string Hasher::hex() const {
+  uint64_t h1 = h1_ ^ length_, h2 = h2_ ^ length_;
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix(h1);
+  h2 = fmix(h2);
+  h1 += h2;
+  h2 += h1;
+  char buf[33];
+  std::snprintf(buf, sizeof(buf), "%016llx%016llx",
+                static_cast<unsigned long long>(h1),
+                static_cast<unsigned long long>(h2));
+  return buf;
+}
+
+std::string getCompilerVersion() {
+  static const std::string version = [] {
+    std::string v = kCacheFormat;
+    std::error_code ec;
+    fs::path exe = fs::read_symlink("/proc/self/exe", ec);
+    if (ec)
+      return v;
+    uintmax_t size = fs::file_size(exe, ec);
+    if (ec)
+      return v;
+    auto mtime = fs::last_write_time(exe, ec);
+    if (ec)
+      return v;
+    v += ' ' + std::to_string(size) + ' ' +
+         std::to_string(mtime.time_since_epoch().count());
+    return v;
+  }();
+  return version;
+}
+
+std::string getDefaultCacheDir() {
+  if (const char *dir = std::getenv("SYSY_CACHE_DIR"))
+    return dir;
+  if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+    return std::string(xdg) + "/sysy-compiler";
+  if (const char *home = std::getenv("HOME"); home && *home)
+    return std::string(home) + "/.cache/sysy-compiler";
+  return "";
+}
+
+bool CompileCache::open(const std::string &dir, uint64_t maxSize) {
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  if (ec || !fs::is_directory(dir, ec))
+    return false;
+  dir_ = dir;
+  maxSize_ = maxSize;
+  return true;
+}
+
+// Entries are spread over 256 subdirectories by their first two digits.
+std::string CompileCache::getPath(const std::string &key) const {
+  return dir_ + '/' + key.substr(0, 2) + '/' + key.substr(2);
+}
+
+bool CompileCache::lookup(Kind kind, const std::string &key,
+                          std::string &text) {
+  std::string path = getPath(key);
+  std::ifstream in(path, std::ios::binary);
+  if (in) {
+    std::string data((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    if (!in.bad()) {
+      text = std::move(data);
+      // The modification time doubles as the time of last use.
+      std::error_code ec;
+      fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+      ++hits_[kind];
+      return true;
+    }
+  }
+  ++misses_[kind];
+  return false;
+}
+
+void CompileCache::store(const std::string &key, std::string_view text) {
+  std::string path = getPath(key);
+  std::string temp = path + ".tmp" + std::to_string(getpid()) + '.' +
+                     std::to_string(stored_++);
+  std::error_code ec;
+  fs::create_directories(fs::path(path).parent_path(), ec);
+  std::ofstream out(temp, std::ios::binary);
+  out.write(text.data(), text.size());
+  out.close();
+  if (out)
+    fs::rename(temp, path, ec);
+  if (!out || ec)
+    fs::remove(temp, ec);
+  else
+    storedBytes_ += text.size();
+}
+
+uint64_t CompileCache::scan() {
+  struct Entry {
+    fs::file_time_type lastUse;
+    uint64_t size;
+    fs::path path;
+  };
+  std::vector<Entry> entries;
+  std::error_code ec;
+  uint64_t size = 0;
+  for (auto it = fs::recursive_directory_iterator(dir_, ec);
+       !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    // Entries live in the subdirectories only.
+    if (it.depth() == 0 || !it->is_regular_file(ec) ||
+        it->path().filename().string().find(".tmp") != std::string::npos)
+      continue;
+    uint64_t entrySize = it->file_size(ec);
+    auto lastUse = it->last_write_time(ec);
+    if (ec)
+      continue;
+    entries.push_back({lastUse, entrySize, it->path()});
+    size += entrySize;
+  }
+  scanned_ = true;
+  if (size <= maxSize_)
+    return size;
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) {
+              return a.lastUse < b.lastUse;
+            });
+  uint64_t target = maxSize_ / 4 * 3;
+  for (const Entry &e : entries) {
+    if (size <= target)
+      break;
+    if (fs::remove(e.path, ec)) {
+      size -= e.size;
+      ++evicted_;
+    }
+  }
+  return size;
+}
+
+void CompileCache::evict() {
+  // The record is updated under an exclusive lock, so processes that share
+  // the cache add their sizes one after the other.
+  std::string record = dir_ + '/' + kSizeRecord;
+  int fd = ::open(record.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+    return;
+  flock(fd, LOCK_EX);
+  char buf[32];
+  ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+  // Without a valid record the size is unknown, and only a scan tells.
+  bool known = n > 0;
+  uint64_t size = 0;
+  if (known) {
+    buf[n] = '\0';
+    char *end = nullptr;
+    size = std::strtoull(buf, &end, 10);
+    known = *end == '\n';
+  }
+  size += storedBytes_.exchange(0);
+  if (!known || size > maxSize_)
+    size = scan();
+  std::string text = std::to_string(size) + '\n';
+  if (ftruncate(fd, 0) != 0 ||
+      pwrite(fd, text.data(), text.size(), 0) != ssize_t(text.size()))
+    ::unlink(record.c_str());
+  flock(fd, LOCK_UN);
+  ::close(fd);
+  size_ = size;
+  sized_ = true;
+}
+
+void CompileCache::printStats(std::string &out) const {
+  char line[128];
+  out += "===--- Compilation cache report ---===\n";
+  static const char *const kNames[] = {"Files", "Functions"};
+  for (unsigned kind : {File, Function}) {
+    std::snprintf(line, sizeof(line), "%-10s %8u hits %8u misses\n",
+                  kNames[kind], hits_[kind].load(), misses_[kind].load());
+    out += line;
+  }
+  if (!sized_)
+    return;
+  std::snprintf(line, sizeof(line),
+                "%-10s %8.1f MiB (limit %.1f MiB)%s, %u evicted\n", "Size",
+                size_ / 1048576.0, maxSize_ / 1048576.0,
+                scanned_ ? ", scanned" : "", evicted_);
+  out += line;
+  out += "Directory  ";
+  out += dir_;
+  out += '\n';
+}
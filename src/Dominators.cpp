@@ -0,0 +1,191 @@
+#include "Dominators.h"
+
+#include <utility>
+
+void DominatorTreeBase::recalculate(Function &f, bool post) {
+  unsigned n = f.renumberBlocks();
+  unsigned numNodes = post ? n + 1 : n;
+  numBlocks_ = n;
+  post_ = post;
+  rootNode_ = post ? n : 0;
+  blocks_.assign(numNodes, nullptr);
+  for (BasicBlock *bb : f)
+    blocks_[bb->getNumber()] = bb;
+
+  // The graph being walked: the CFG, or for post-dominators the reversed CFG
+  // with the virtual exit in front of every block that leaves the function.
+  std::vector<std::vector<unsigned>> succs(numNodes), preds(numNodes);
+  for (BasicBlock *bb : f) {
+    unsigned b = bb->getNumber();
+    unsigned numSuccs = bb->getNumSuccessors();
+    for (unsigned i = 0; i < numSuccs; ++i) {
+      unsigned s = bb->getSuccessor(i)->getNumber();
+      if (post) {
+        succs[s].push_back(b);
+        preds[b].push_back(s);
+      } else {
+        succs[b].push_back(s);
+        preds[s].push_back(b);
+      }
+    }
+    if (post && numSuccs == 0) {
+      succs[rootNode_].push_back(b);
+      preds[b].push_back(rootNode_);
+    }
+  }
+
+  // Iterative DFS for the post-order.
+  std::vector<unsigned> postNum(numNodes, kNone);
+  std::vector<unsigned> postOrder;
+  postOrder.reserve(numNodes);
+  std::vector<bool> visited(numNodes, false);
+  std::vector<std::pair<unsigned, unsigned>> stack;
+  stack.emplace_back(rootNode_, 0);
+  visited[rootNode_] = true;
+  while (!stack.empty()) {
+    unsigned v = stack.back().first;
+    unsigned i = stack.back().second;
+    if (i < succs[v].size()) {
+      stack.back().second = i + 1;
+      unsigned s = succs[v][i];
+      if (!visited[s]) {
+        visited[s] = true;
+        stack.emplace_back(s, 0);
+      }
+      continue;
+    }
+    postNum[v] = postOrder.size();
+    postOrder.push_back(v);
+    stack.pop_back();
+  }
+
+  auto intersect = [&](unsigned a, unsigned b) {
+    while (a != b) {
+      while (postNum[a] < postNum[b])
+        a = idom_[a];
+      while (postNum[b] < postNum[a])
+        b = idom_[b];
+    }
+    return a;
+  };
+
+  idom_.assign(numNodes, kNone);
+  idom_[rootNode_] = rootNode_;
+  for (bool changed = true; changed;) {
+    changed = false;
+    // Reverse post-order, skipping the root, which comes last in post-order.
+    for (size_t k = postOrder.size() - 1; k-- > 0;) {
+      unsigned b = postOrder[k];
+      unsigned newIdom = kNone;
+      for (unsigned p : preds[b]) {
+        if (idom_[p] == kNone)
+          continue;
+        newIdom = newIdom == kNone ? p : intersect(p, newIdom);
+      }
+      if (idom_[b] != newIdom) {
+        idom_[b] = newIdom;
+        changed = true;
+      }
+    }
+  }
+
+  rpo_.clear();
+  children_.assign(numNodes, {});
+  for (size_t k = postOrder.size(); k-- > 0;) {
+    unsigned v = postOrder[k];
+    if (v == rootNode_ && post)
+      continue;
+    rpo_.push_back(blocks_[v]);
+    if (v != rootNode_)
+      children_[idom_[v]].push_back(blocks_[v]);
+  }
+
+  dfsIn_.assign(numNodes, 0);
+  dfsOut_.assign(numNodes, 0);
+  unsigned clock = 0;
+  std::vector<std::pair<unsigned, size_t>> walk;
+  walk.emplace_back(rootNode_, 0);
+  dfsIn_[rootNode_] = clock++;
+  while (!walk.empty()) {
+    unsigned v = walk.back().first;
+    size_t i = walk.back().second;
+    if (i < children_[v].size()) {
+      walk.back().second = i + 1;
+      unsigned c = children_[v][i]->getNumber();
+      dfsIn_[c] = clock++;
+      walk.emplace_back(c, 0);
+      continue;
+    }
+    dfsOut_[v] = clock++;
+    walk.pop_back();
+  }
+}
+
+bool DominatorTreeBase::dominates(const BasicBlock *a,
+                                  const BasicBlock *b) const {
+  unsigned x = a->getNumber(), y = b->getNumber();
+  if (x == y || idom_[y] == kNone)
+    return true;
+  if (idom_[x] == kNone)
+    return false;
+  return dfsIn_[x] <= dfsIn_[y] && dfsOut_[y] <= dfsOut_[x];
+}
+
+BasicBlock *DominatorTreeBase::findNearestCommonDominator(BasicBlock *a,
+                                                          BasicBlock *b) const {
+  unsigned x = a->getNumber(), y = b->getNumber();
+  while (!(dfsIn_[x] <= dfsIn_[y] && dfsOut_[y] <= dfsOut_[x]))
+    x = idom_[x];
+  return blocks_[x];
+}
+
+std::vector<BasicBlock *> DominatorTreeBase::getPreOrder() const {
+  std::vector<BasicBlock *> order;
+  order.reserve(rpo_.size());
+  std::vector<BasicBlock *> stack;
+  if (blocks_[rootNode_])
+    stack.push_back(blocks_[rootNode_]);
+  else
+    stack.assign(children_[rootNode_].rbegin(), children_[rootNode_].rend());
+  while (!stack.empty()) {
+    BasicBlock *bb = stack.back();
+    stack.pop_back();
+    order.push_back(bb);
+    const auto &kids = children_[bb->getNumber()];
+    stack.insert(stack.end(), kids.rbegin(), kids.rend());
+  }
+  return order;
+}
+
+bool DominatorTree::dominates(const Instruction *def,
+                              const Instruction *user) const {
+  const BasicBlock *defBB = def->getParent();
+  const BasicBlock *userBB = user->getParent();
+  if (defBB != userBB)
+    return dominates(defBB, userBB);
+  for (const Instruction *i = def->getNextNode(); i; i = i->getNextNode())
+    if (i == user)
+      return true;
+  return false;
+}
+
+DominanceFrontier::DominanceFrontier(const DominatorTreeBase &dt)
+    : frontiers_(dt.getNumBlocks()) {
+  // Cooper-Harvey-Kennedy: walk up from each predecessor of a join point
+  // until reaching the join point's immediate dominator. Predecessors in the
+  // reversed CFG are the successors.
+  for (BasicBlock *bb : dt.getReversePostOrder()) {
+    BasicBlock *idom = dt.getIDom(bb);
+    auto preds =
+        dt.isPostDominator() ? bb->successors() : bb->predecessors();
+    for (BasicBlock *pred : preds) {
+      if (!dt.isReachable(pred))
+        continue;
+      for (BasicBlock *r = pred; r != idom; r = dt.getIDom(r)) {
+        auto &df = frontiers_[r->getNumber()];
+        if (df.empty() || df.back() != bb)
+          df.push_back(bb);
+      }
+    }
+  }
+}
@@ -0,0 +1,279 @@
+#include "FastLexer.h"
+
+#include <cstring>
+
+namespace {
+
+inline bool isIdentStart(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+inline bool isIdentChar(char c) { return isIdentStart(c) || isDigit(c); }
+
+inline bool isHexDigit(char c) {
+  return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+TokenKind keywordOrIdent(std::string_view s) {
+  switch (s.size()) {
+  case 2:
+    if (s == "if")
+      return TokenKind::If;
+    break;
+  case 3:
+    if (s == "int")
+      return TokenKind::Int;
+    break;
+  case 4:
+    if (s == "void")
+      return TokenKind::Void;
+    if (s == "else")
+      return TokenKind::Else;
+    break;
+  case 5:
+    if (s == "const")
+      return TokenKind::Const;
+    if (s == "while")
+      return TokenKind::While;
+    if (s == "break")
+      return TokenKind::Break;
+    break;
+  case 6:
+    if (s == "return")
+      return TokenKind::Return;
+    break;
+  case 8:
+    if (s == "continue")
+      return TokenKind::Continue;
+    break;
+  }
+  return TokenKind::Ident;
+}
+
+} // namespace
+
+bool FastLexer::skipTrivia() {
+  while (p_ < end_) {
+    char c = *p_;
+    if (c == '\n') {
+      ++line_;
+      ++p_;
+    } else if (c == ' ' || c == '\t' || c == '\r') {
+      ++p_;
+    } else if (c == '/' && p_ + 1 < end_ && p_[1] == '/') {
+      p_ += 2;
+      while (p_ < end_ && *p_ != '\n' && *p_ != '\r')
+        ++p_;
+    } else if (c == '/' && p_ + 1 < end_ && p_[1] == '*') {
+      const char *q = p_ + 2;
+      uint32_t lines = 0;
+      while (q + 1 < end_ && !(q[0] == '*' && q[1] == '/')) {
+        lines += *q == '\n';
+        ++q;
+      }
+      if (q + 1 >= end_)
+        return false;
+      line_ += lines;
+      p_ = q + 2;
+    } else {
+      break;
+    }
+  }
+  return true;
+}
+
+Token FastLexer::next() {
+  Token tok;
+  if (!skipTrivia()) {
+    tok.kind = TokenKind::Error;
+    tok.line = line_;
+    tok.text = std::string_view(p_, end_ - p_);
+    p_ = end_;
+    return tok;
+  }
+  tok.line = line_;
+  if (p_ == end_) {
+    tok.kind = TokenKind::Eof;
+    return tok;
+  }
+
+  const char *start = p_;
+  char c = *p_++;
+  auto two = [&](char second, TokenKind pair, TokenKind single) {
+    if (p_ < end_ && *p_ == second) {
+      ++p_;
+      return pair;
+    }
+    return single;
+  };
+
+  switch (c) {
+  case '+':
+    tok.kind = TokenKind::Plus;
+    break;
+  case '-':
+    tok.kind = TokenKind::Minus;
+    break;
+  case '*':
+    tok.kind = TokenKind::Mul;
+    break;
+  case '/':
+    tok.kind = TokenKind::Div;
+    break;
+  case '%':
+    tok.kind = TokenKind::Mod;
+    break;
+  case '=':
+    tok.kind = two('=', TokenKind::Eq, TokenKind::Assign);
+    break;
+  case '!':
+    tok.kind = two('=', TokenKind::Neq, TokenKind::Not);
+    break;
+  case '<':
+    tok.kind = two('=', TokenKind::Le, TokenKind::Lt);
+    break;
+  case '>':
+    tok.kind = two('=', TokenKind::Ge, TokenKind::Gt);
+    break;
+  case '&':
+    tok.kind = two('&', TokenKind::And, TokenKind::Error);
+    break;
+  case '|':
+    tok.kind = two('|', TokenKind::Or, TokenKind::Error);
+    break;
+  case '(':
+    tok.kind = TokenKind::LParen;
+    break;
+  case ')':
+    tok.kind = TokenKind::RParen;
+    break;
+  case '{':
+    tok.kind = TokenKind::LBrace;
+    break;
+  case '}':
+    tok.kind = TokenKind::RBrace;
+    break;
+  case '[':
+    tok.kind = TokenKind::LBracket;
+    break;
+  case ']':
+    tok.kind = TokenKind::RBracket;
+    break;
+  case ',':
+    tok.kind = TokenKind::Comma;
+    break;
+  case ';':
+    tok.kind = TokenKind::Semicolon;
+    break;
+  default:
+    if (isIdentStart(c)) {
+      while (p_ < end_ && isIdentChar(*p_))
+        ++p_;
+      tok.text = std::string_view(start, p_ - start);
+      tok.kind = keywordOrIdent(tok.text);
+      return tok;
+    }
+    if (isDigit(c)) {
+      // Same alternatives as INTEGER_CONST: hex, octal (including a lone
+      // "0") and decimal, each taking the longest run of its digits.
+      if (c == '0' && p_ + 1 < end_ && (*p_ == 'x' || *p_ == 'X') &&
+          isHexDigit(p_[1])) {
+        p_ += 2;
+        while (p_ < end_ && isHexDigit(*p_))
+          ++p_;
+      } else if (c == '0') {
+        while (p_ < end_ && *p_ >= '0' && *p_ <= '7')
+          ++p_;
+      } else {
+        while (p_ < end_ && isDigit(*p_))
+          ++p_;
+      }
+      tok.kind = TokenKind::IntConst;
+      break;
+    }
+    tok.kind = TokenKind::Error;
+    break;
+  }
+  tok.text = std::string_view(start, p_ - start);
+  return tok;
+}
+
+const char *FastLexer::describe(TokenKind kind) {
+  switch (kind) {
+  case TokenKind::Const:
+    return "'const'";
+  case TokenKind::Int:
+    return "'int'";
+  case TokenKind::Void:
+    return "'void'";
+  case TokenKind::If:
+    return "'if'";
+  case TokenKind::Else:
+    return "'else'";
+  case TokenKind::While:
+    return "'while'";
+  case TokenKind::Break:
+    return "'break'";
+  case TokenKind::Continue:
+    return "'continue'";
+  case TokenKind::Return:
+    return "'return'";
+  case TokenKind::Plus:
+    return "'+'";
+  case TokenKind::Minus:
+    return "'-'";
+  case TokenKind::Mul:
+    return "'*'";
+  case TokenKind::Div:
+    return "'/'";
+  case TokenKind::Mod:
+    return "'%'";
+  case TokenKind::Assign:
+    return "'='";
+  case TokenKind::Eq:
+    return "'=='";
+  case TokenKind::Neq:
+    return "'!='";
+  case TokenKind::Lt:
+    return "'<'";
+  case TokenKind::Gt:
+    return "'>'";
+  case TokenKind::Le:
+    return "'<='";
+  case TokenKind::Ge:
+    return "'>='";
+  case TokenKind::Not:
+    return "'!'";
+  case TokenKind::And:
+    return "'&&'";
+  case TokenKind::Or:
+    return "'||'";
+  case TokenKind::LParen:
+    return "'('";
+  case TokenKind::RParen:
+    return "')'";
+  case TokenKind::LBrace:
+    return "'{'";
+  case TokenKind::RBrace:
+    return "'}'";
+  case TokenKind::LBracket:
+    return "'['";
+  case TokenKind::RBracket:
+    return "']'";
+  case TokenKind::Comma:
+    return "','";
+  case TokenKind::Semicolon:
+    return "';'";
+  case TokenKind::Ident:
+    return "identifier";
+  case TokenKind::IntConst:
+    return "integer constant";
+  case TokenKind::Eof:
+    return "end of file";
+  case TokenKind::Error:
+    return "invalid token";
+  }
+  return "";
+}
@@ -0,0 +1,382 @@
+#include "FastParser.h"
+
+FastParser::FastParser(std::string_view source, ASTContext &ctx)
+    : lexer_(source), ctx_(ctx) {
+  la_[0] = lexer_.next();
+  filled_ = 1;
+}
+
+const Token &FastParser::peek(unsigned n) {
+  while (filled_ <= pos_ + n) {
+    la_[filled_ & 3] = lexer_.next();
+    ++filled_;
+  }
+  return la_[(pos_ + n) & 3];
+}
+
+Token FastParser::consume() {
+  Token t = tok();
+  ++pos_;
+  if (filled_ == pos_) {
+    la_[filled_ & 3] = lexer_.next();
+    ++filled_;
+  }
+  return t;
+}
+
+bool FastParser::accept(TokenKind kind) {
+  if (tok().kind != kind)
+    return false;
+  consume();
+  return true;
+}
+
+Token FastParser::expect(TokenKind kind) {
+  if (tok().kind != kind)
+    fail(tok(), std::string("expected ") + FastLexer::describe(kind));
+  return consume();
+}
+
+void FastParser::fail(const Token &at, const std::string &msg) {
+  std::string full = msg;
+  if (at.kind == TokenKind::Error)
+    full += ", found unrecognized input '" +
+            std::string(at.text.substr(0, 16)) + "'";
+  else if (at.kind == TokenKind::Eof)
+    full += ", found end of file";
+  else if (!at.text.empty())
+    full += ", found '" + std::string(at.text) + "'";
+  else
+    full += std::string(", found ") + FastLexer::describe(at.kind);
+  throw SyntaxError{at.line, full};
+}
+
+CompUnit *FastParser::parse(std::string &error) {
+  try {
+    return parseCompUnit();
+  } catch (const SyntaxError &e) {
+    error = "line " + std::to_string(e.line) + ": " + e.msg;
+    return nullptr;
+  }
+}
+
+CompUnit *FastParser::parseCompUnit() {
+  std::vector<TopLevel> items;
+  do {
+    TopLevel item;
+    TokenKind k = tok().kind;
+    if (k == TokenKind::Void ||
+        (k == TokenKind::Int && peek(1).kind == TokenKind::Ident &&
+         peek(2).kind == TokenKind::LParen))
+      item.func = parseFuncDef();
+    else if (k == TokenKind::Int || k == TokenKind::Const)
+      item.decl = parseDecl();
+    else
+      fail(tok(), "expected a declaration or function definition");
+    items.push_back(item);
+  } while (tok().kind != TokenKind::Eof);
+  return ctx_.create<CompUnit>(ctx_.copyArray(items));
+}
+
+FuncDef *FastParser::parseFuncDef() {
+  Token type = consume();
+  std::string_view name = expect(TokenKind::Ident).text;
+  expect(TokenKind::LParen);
+  std::vector<FuncParam *> params;
+  if (tok().kind != TokenKind::RParen) {
+    params.push_back(parseFuncParam());
+    while (accept(TokenKind::Comma))
+      params.push_back(parseFuncParam());
+  }
+  expect(TokenKind::RParen);
+  BlockStmt *body = parseBlock();
+  return ctx_.create<FuncDef>(type.kind == TokenKind::Void, name,
+                              ctx_.copyArray(params), body, type.line);
+}
+
+FuncParam *FastParser::parseFuncParam() {
+  expect(TokenKind::Int);
+  std::string_view name = expect(TokenKind::Ident).text;
+  bool isArray = false;
+  ArrayRef<Expr *> dims;
+  if (accept(TokenKind::LBracket)) {
+    expect(TokenKind::RBracket);
+    isArray = true;
+    dims = parseIndices();
+  }
+  return ctx_.create<FuncParam>(name, isArray, dims);
+}
+
+DeclStmt *FastParser::parseDecl() {
+  uint32_t line = tok().line;
+  bool isConst = accept(TokenKind::Const);
+  expect(TokenKind::Int);
+  std::vector<VarDef *> defs;
+  defs.push_back(parseVarDef(isConst));
+  while (accept(TokenKind::Comma))
+    defs.push_back(parseVarDef(isConst));
+  expect(TokenKind::Semicolon);
+  return ctx_.create<DeclStmt>(ctx_.copyArray(defs), line);
+}
+
+VarDef *FastParser::parseVarDef(bool isConst) {
+  Token ident = expect(TokenKind::Ident);
+  ArrayRef<Expr *> dims = parseIndices();
+  InitVal *init = nullptr;
+  if (isConst) {
+    expect(TokenKind::Assign);
+    init = parseInitVal();
+  } else if (accept(TokenKind::Assign)) {
+    init = parseInitVal();
+  }
+  return ctx_.create<VarDef>(ident.text, dims, init, isConst, ident.line);
+}
+
+InitVal *FastParser::parseInitVal() {
+  if (!accept(TokenKind::LBrace))
+    return ctx_.create<InitVal>(parseExp());
+  std::vector<InitVal *> list;
+  if (tok().kind != TokenKind::RBrace) {
+    list.push_back(parseInitVal());
+    while (accept(TokenKind::Comma))
+      list.push_back(parseInitVal());
+  }
+  expect(TokenKind::RBrace);
+  return ctx_.create<InitVal>(ctx_.copyArray(list));
+}
+
+BlockStmt *FastParser::parseBlock() {
+  uint32_t line = expect(TokenKind::LBrace).line;
+  std::vector<Stmt *> items;
+  while (tok().kind != TokenKind::RBrace) {
+    if (tok().kind == TokenKind::Const || tok().kind == TokenKind::Int)
+      items.push_back(parseDecl());
+    else
+      items.push_back(parseStmt());
+  }
+  consume();
+  return ctx_.create<BlockStmt>(ctx_.copyArray(items), line);
+}
+
+Stmt *FastParser::parseStmt() {
+  uint32_t line = tok().line;
+  switch (tok().kind) {
+  case TokenKind::LBrace:
+    return parseBlock();
+  case TokenKind::If: {
+    consume();
+    expect(TokenKind::LParen);
+    Expr *cond = parseCond();
+    expect(TokenKind::RParen);
+    Stmt *thenStmt = parseStmt();
+    Stmt *elseStmt = accept(TokenKind::Else) ? parseStmt() : nullptr;
+    return ctx_.create<IfStmt>(cond, thenStmt, elseStmt, line);
+  }
+  case TokenKind::While: {
+    consume();
+    expect(TokenKind::LParen);
+    Expr *cond = parseCond();
+    expect(TokenKind::RParen);
+    return ctx_.create<WhileStmt>(cond, parseStmt(), line);
+  }
+  case TokenKind::Break:
+    consume();
+    expect(TokenKind::Semicolon);
+    return ctx_.create<BreakStmt>(line);
+  case TokenKind::Continue:
+    consume();
+    expect(TokenKind::Semicolon);
+    return ctx_.create<ContinueStmt>(line);
+  case TokenKind::Return: {
+    consume();
+    Expr *value = nullptr;
+    if (tok().kind != TokenKind::Semicolon)
+      value = parseExp();
+    expect(TokenKind::Semicolon);
+    return ctx_.create<ReturnStmt>(value, line);
+  }
+  case TokenKind::Semicolon:
+    consume();
+    return ctx_.create<ExprStmt>(nullptr, line);
+  default:
+    break;
+  }
+
+  // An assignment starts with an lvalue, which is also a valid expression;
+  // parse the expression and decide once we see what follows it.
+  bool startsWithIdent = tok().kind == TokenKind::Ident;
+  Expr *e = parseExp();
+  if (tok().kind == TokenKind::Assign) {
+    auto *lval = dyn_cast<LValExpr>(e);
+    // `(a) = 1` is not an assignment in the grammar.
+    if (!lval || !startsWithIdent)
+      fail(tok(), "expected ';'");
+    consume();
+    Expr *value = parseExp();
+    expect(TokenKind::Semicolon);
+    return ctx_.create<AssignStmt>(lval, value, line);
+  }
+  expect(TokenKind::Semicolon);
+  return ctx_.create<ExprStmt>(e, line);
+}
+
+ArrayRef<Expr *> FastParser::parseIndices() {
+  if (tok().kind != TokenKind::LBracket)
+    return {};
+  std::vector<Expr *> indices;
+  while (accept(TokenKind::LBracket)) {
+    indices.push_back(parseExp());
+    expect(TokenKind::RBracket);
+  }
+  return ctx_.copyArray(indices);
+}
+
+// Binary expressions take the line of their first token, which is where the
+// ANTLR context of the (left-recursive) alternative starts.
+
+Expr *FastParser::parseExp() {
+  uint32_t line = tok().line;
+  Expr *lhs = parseMulExp();
+  for (;;) {
+    BinaryOp op;
+    if (tok().kind == TokenKind::Plus)
+      op = BinaryOp::Add;
+    else if (tok().kind == TokenKind::Minus)
+      op = BinaryOp::Sub;
+    else
+      return lhs;
+    consume();
+    Expr *rhs = parseMulExp();
+    lhs = ctx_.create<BinaryExpr>(op, lhs, rhs, line);
+  }
+}
+
+Expr *FastParser::parseMulExp() {
+  uint32_t line = tok().line;
+  Expr *lhs = parseUnaryExp();
+  for (;;) {
+    BinaryOp op;
+    if (tok().kind == TokenKind::Mul)
+      op = BinaryOp::Mul;
+    else if (tok().kind == TokenKind::Div)
+      op = BinaryOp::Div;
+    else if (tok().kind == TokenKind::Mod)
+      op = BinaryOp::Mod;
+    else
+      return lhs;
+    consume();
+    Expr *rhs = parseUnaryExp();
+    lhs = ctx_.create<BinaryExpr>(op, lhs, rhs, line);
+  }
+}
+
+Expr *FastParser::parseUnaryExp() {
+  UnaryOp op;
+  switch (tok().kind) {
+  case TokenKind::Plus:
+    op = UnaryOp::Plus;
+    break;
+  case TokenKind::Minus:
+    op = UnaryOp::Minus;
+    break;
+  case TokenKind::Not:
+    op = UnaryOp::Not;
+    break;
+  default:
+    return parsePrimaryExp();
+  }
+  uint32_t line = consume().line;
+  return ctx_.create<UnaryExpr>(op, parseUnaryExp(), line);
+}
+
+Expr *FastParser::parsePrimaryExp() {
+  switch (tok().kind) {
+  case TokenKind::LParen: {
+    consume();
+    Expr *e = parseExp();
+    expect(TokenKind::RParen);
+    return e;
+  }
+  case TokenKind::IntConst: {
+    Token t = consume();
+    return ctx_.create<IntLiteral>(parseIntLiteral(t.text), t.line);
+  }
+  case TokenKind::Ident: {
+    Token ident = consume();
+    if (accept(TokenKind::LParen)) {
+      std::vector<Expr *> args;
+      if (tok().kind != TokenKind::RParen) {
+        args.push_back(parseExp());
+        while (accept(TokenKind::Comma))
+          args.push_back(parseExp());
+      }
+      expect(TokenKind::RParen);
+      return ctx_.create<CallExpr>(ident.text, ctx_.copyArray(args),
+                                   ident.line);
+    }
+    return ctx_.create<LValExpr>(ident.text, parseIndices(), ident.line);
+  }
+  default:
+    fail(tok(), "expected an expression");
+  }
+}
+
+Expr *FastParser::parseCond() {
+  uint32_t line = tok().line;
+  Expr *lhs = parseAndCond();
+  while (accept(TokenKind::Or))
+    lhs = ctx_.create<BinaryExpr>(BinaryOp::Or, lhs, parseAndCond(), line);
+  return lhs;
+}
+
+Expr *FastParser::parseAndCond() {
+  uint32_t line = tok().line;
+  Expr *lhs = parseEqCond();
+  while (accept(TokenKind::And))
+    lhs = ctx_.create<BinaryExpr>(BinaryOp::And, lhs, parseEqCond(), line);
+  return lhs;
+}
+
+Expr *FastParser::parseEqCond() {
+  uint32_t line = tok().line;
+  Expr *lhs = parseRelCond();
+  for (;;) {
+    BinaryOp op;
+    if (tok().kind == TokenKind::Eq)
+      op = BinaryOp::Eq;
+    else if (tok().kind == TokenKind::Neq)
+      op = BinaryOp::Ne;
+    else
+      return lhs;
+    consume();
+    Expr *rhs = parseRelCond();
+    lhs = ctx_.create<BinaryExpr>(op, lhs, rhs, line);
+  }
+}
+
+Expr *FastParser::parseRelCond() {
+  uint32_t line = tok().line;
+  Expr *lhs = parseExp();
+  for (;;) {
+    BinaryOp op;
+    switch (tok().kind) {
+    case TokenKind::Lt:
+      op = BinaryOp::Lt;
+      break;
+    case TokenKind::Gt:
+      op = BinaryOp::Gt;
+      break;
+    case TokenKind::Le:
+      op = BinaryOp::Le;
+      break;
+    case TokenKind::Ge:
+      op = BinaryOp::Ge;
+      break;
+    default:
+      return lhs;
+    }
+    consume();
+    Expr *rhs = parseExp();
+    lhs = ctx_.create<BinaryExpr>(op, lhs, rhs, line);
+  }
+}
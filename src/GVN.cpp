@@ -0,0 +1,214 @@
+#include "Dominators.h"
+#include "Passes.h"
+
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+bool isValueNumbered(const Instruction *inst) {
+  switch (inst->getKind()) {
+  case Value::Kind::Binary:
+  case Value::Kind::ICmp:
+  case Value::Kind::Cast:
+  case Value::Kind::GEP:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// The operands of `inst` in the order used for hashing and comparison:
+// commutative operands and compared values sorted by address, with the
+// predicate swapped along with them.
+struct Expression {
+  explicit Expression(const Instruction *inst) : inst(inst) {
+    lhs = inst->getNumOperands() > 0 ? inst->getOperand(0) : nullptr;
+    rhs = inst->getNumOperands() > 1 ? inst->getOperand(1) : nullptr;
+    op = 0;
+    if (auto *bi = dyn_cast<BinaryInst>(inst)) {
+      op = bi->getOpcode();
+      if (bi->isCommutative() && std::less<Value *>()(rhs, lhs))
+        std::swap(lhs, rhs);
+    } else if (auto *ci = dyn_cast<ICmpInst>(inst)) {
+      ICmpInst::Predicate p = ci->getPredicate();
+      if (std::less<Value *>()(rhs, lhs)) {
+        std::swap(lhs, rhs);
+        p = ICmpInst::getSwappedPredicate(p);
+      }
+      op = p;
+    } else if (auto *ci = dyn_cast<CastInst>(inst)) {
+      op = ci->getOpcode();
+    }
+  }
+
+  Value *getOperand(unsigned i) const {
+    return i == 0 ? lhs : i == 1 ? rhs : inst->getOperand(i);
+  }
+
+  const Instruction *inst;
+  Value *lhs, *rhs;
+  unsigned op;
+};
+
+struct ExpressionHash {
+  size_t operator()(const Instruction *inst) const {
+    Expression e(inst);
+    size_t h = static_cast<size_t>(inst->getKind()) * 31 + e.op;
+    h = h * 31 + std::hash<const void *>()(inst->getType());
+    for (unsigned i = 0; i < inst->getNumOperands(); ++i)
+      h = h * 31 + std::hash<const void *>()(e.getOperand(i));
+    return h;
+  }
+};
+
+struct ExpressionEqual {
+  bool operator()(const Instruction *a, const Instruction *b) const {
+    if (a->getKind() != b->getKind() || a->getType() != b->getType() ||
+        a->getNumOperands() != b->getNumOperands())
+      return false;
+    Expression x(a), y(b);
+    if (x.op != y.op)
+      return false;
+    for (unsigned i = 0; i < a->getNumOperands(); ++i)
+      if (x.getOperand(i) != y.getOperand(i))
+        return false;
+    return true;
+  }
+};
+
+// Whether loads through `ptr` always see the same value: the address lies in
+// a global that is never written.
+bool pointsToConstant(Value *ptr) {
+  while (auto *gep = dyn_cast<GetElementPtrInst>(ptr))
+    ptr = gep->getPointerOperand();
+  auto *gv = dyn_cast<GlobalVariable>(ptr);
+  return gv && gv->isConstant();
+}
+
+// Walks the dominator tree in pre-order keeping scoped tables of the
+// expressions and loads available at the current point, in the style of
+// LLVM's EarlyCSE. Memory is versioned with a generation number that every
+// store or call bumps; a remembered load is only reused within the same
+// generation. A block starts a fresh generation unless its only predecessor
+// is its dominator-tree parent, whose final state then carries over.
+class GVN {
+public:
+  explicit GVN(Function &f) : f_(f), dt_(f) {}
+
+  bool run();
+
+private:
+  struct AvailableLoad {
+    Value *value;
+    unsigned generation;
+  };
+  struct LoadUndo {
+    Value *ptr;
+    bool existed;
+    AvailableLoad previous;
+  };
+  struct Frame {
+    BasicBlock *bb;
+    size_t nextChild;
+    size_t exprMark, loadMark;
+    unsigned generation;
+  };
+
+  void processBlock(BasicBlock *bb);
+  void setAvailableLoad(Value *ptr, Value *v);
+  void replace(Instruction *inst, Value *v) {
+    inst->replaceAllUsesWith(v);
+    inst->eraseFromParent();
+    changed_ = true;
+  }
+
+  Function &f_;
+  DominatorTree dt_;
+  std::unordered_map<Instruction *, Instruction *, ExpressionHash,
+                     ExpressionEqual>
+      exprs_;
+  std::vector<Instruction *> exprUndo_;
+  std::unordered_map<Value *, AvailableLoad> loads_;
+  std::vector<LoadUndo> loadUndo_;
+  unsigned generation_ = 0;
+  unsigned lastGeneration_ = 0;
+  bool changed_ = false;
+};
+
+void GVN::setAvailableLoad(Value *ptr, Value *v) {
+  auto [it, inserted] = loads_.try_emplace(ptr, AvailableLoad{v, generation_});
+  loadUndo_.push_back({ptr, !inserted, it->second});
+  it->second = {v, generation_};
+}
+
+void GVN::processBlock(BasicBlock *bb) {
+  for (Instruction *inst : *bb) {
+    if (isValueNumbered(inst)) {
+      auto [it, inserted] = exprs_.try_emplace(inst, inst);
+      if (inserted)
+        exprUndo_.push_back(inst);
+      else
+        replace(inst, it->second);
+      continue;
+    }
+    if (auto *li = dyn_cast<LoadInst>(inst)) {
+      Value *ptr = li->getPointerOperand();
+      auto it = loads_.find(ptr);
+      if (it != loads_.end() && (it->second.generation == generation_ ||
+                                 pointsToConstant(ptr))) {
+        replace(li, it->second.value);
+        continue;
+      }
+      setAvailableLoad(ptr, li);
+      continue;
+    }
+    if (inst->mayWriteMemory())
+      generation_ = ++lastGeneration_;
+    // The stored value is what the next load of the same address reads.
+    if (auto *si = dyn_cast<StoreInst>(inst))
+      setAvailableLoad(si->getPointerOperand(), si->getValueOperand());
+  }
+}
+
+bool GVN::run() {
+  std::vector<Frame> stack;
+  BasicBlock *entry = f_.getEntryBlock();
+  processBlock(entry);
+  stack.push_back({entry, 0, 0, 0, generation_});
+  while (!stack.empty()) {
+    Frame &top = stack.back();
+    const auto &children = dt_.getChildren(top.bb);
+    if (top.nextChild == children.size()) {
+      // Leave the scope: forget what this block made available.
+      while (exprUndo_.size() > top.exprMark) {
+        exprs_.erase(exprUndo_.back());
+        exprUndo_.pop_back();
+      }
+      while (loadUndo_.size() > top.loadMark) {
+        LoadUndo &u = loadUndo_.back();
+        if (u.existed)
+          loads_[u.ptr] = u.previous;
+        else
+          loads_.erase(u.ptr);
+        loadUndo_.pop_back();
+      }
+      stack.pop_back();
+      continue;
+    }
+    BasicBlock *child = children[top.nextChild++];
+    generation_ = child->getSinglePredecessor() == top.bb
+                      ? top.generation
+                      : ++lastGeneration_;
+    size_t exprMark = exprUndo_.size(), loadMark = loadUndo_.size();
+    processBlock(child);
+    stack.push_back({child, 0, exprMark, loadMark, generation_});
+  }
+  return changed_;
+}
+
+} // namespace
+
+bool runGVN(Function &f) { return GVN(f).run(); }
@@ -0,0 +1,33 @@
+#include "Passes.h"
+
+namespace {
+
+// Whether the memory behind `ptr` may be written through any of its uses.
+// Pointers passed to calls count as written.
+bool mayBeWritten(Value *ptr) {
+  for (Use *u = ptr->getFirstUse(); u; u = u->getNext()) {
+    User *user = u->getUser();
+    if (isa<LoadInst>(user))
+      continue;
+    if (isa<GetElementPtrInst>(user) || isa<CastInst>(user)) {
+      if (mayBeWritten(user))
+        return true;
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+} // namespace
+
+bool runGlobalOpt(Module &m) {
+  bool changed = false;
+  for (GlobalVariable *gv : m.globals()) {
+    if (gv->isConstant() || mayBeWritten(gv))
+      continue;
+    gv->setConstant(true);
+    changed = true;
+  }
+  return changed;
+}
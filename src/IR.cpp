@@ -0,0 +1,765 @@
+#include "IR.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <mutex>
+
+namespace {
+
+// Functions and globals are used from every function of the module, and
+// function passes may run on several functions at once, so their use lists
+// are only changed under this lock. Every other value belongs to a single
+// function.
+std::mutex sharedUsesMutex;
+
+bool isShared(const Value *v) {
+  return v && (v->getKind() == Value::Kind::Function ||
+               v->getKind() == Value::Kind::GlobalVariable);
+}
+
+} // namespace
+
+void Use::set(Value *v) {
+  if (isShared(val_) || isShared(v)) {
+    std::lock_guard<std::mutex> lock(sharedUsesMutex);
+    relink(v);
+  } else {
+    relink(v);
+  }
+}
+
+void Use::relink(Value *v) {
+  if (val_) {
+    *prev_ = next_;
+    if (next_)
+      next_->prev_ = prev_;
+  }
+  val_ = v;
+  if (v) {
+    next_ = v->uses_;
+    if (next_)
+      next_->prev_ = &next_;
+    prev_ = &v->uses_;
+    v->uses_ = this;
+  } else {
+    next_ = nullptr;
+    prev_ = nullptr;
+  }
+}
+
+unsigned Value::getNumUses() const {
+  unsigned n = 0;
+  for (Use *u = uses_; u; u = u->getNext())
+    ++n;
+  return n;
+}
+
+std::vector<User *> Value::users() const {
+  std::vector<User *> result;
+  for (Use *u = uses_; u; u = u->getNext())
+    result.push_back(u->getUser());
+  return result;
+}
+
+void Value::replaceAllUsesWith(Value *v) {
+  assert(v != this && "replacing a value with itself");
+  while (uses_)
+    uses_->set(v);
+}
+
+User::User(Kind k, Type *t, Arena &arena, unsigned numOps, unsigned capacity)
+    : Value(k, t) {
+  capOps_ = std::max(numOps, capacity);
+  ops_ = arena.allocArray<Use>(capOps_);
+  for (unsigned i = 0; i < capOps_; ++i)
+    ops_[i].user_ = this;
+  numOps_ = numOps;
+}
+
+void User::dropAllReferences() {
+  for (unsigned i = 0; i < numOps_; ++i)
+    ops_[i].set(nullptr);
+}
+
+void User::addOperand(Arena &arena, Value *v) {
+  if (numOps_ == capOps_) {
+    unsigned newCap = std::max(4u, capOps_ * 2);
+    Use *newOps = arena.allocArray<Use>(newCap);
+    for (unsigned i = 0; i < newCap; ++i)
+      newOps[i].user_ = this;
+    for (unsigned i = 0; i < numOps_; ++i) {
+      newOps[i].set(ops_[i].get());
+      ops_[i].set(nullptr);
+    }
+    ops_ = newOps;
+    capOps_ = newCap;
+  }
+  ops_[numOps_++].set(v);
+}
+
+void User::removeOperand(unsigned i) {
+  assert(i < numOps_);
+  for (unsigned j = i; j + 1 < numOps_; ++j)
+    ops_[j].set(ops_[j + 1].get());
+  ops_[--numOps_].set(nullptr);
+}
+
+//===----------------------------------------------------------------------===//
+// Instructions
+//===----------------------------------------------------------------------===//
+
+bool Instruction::mayReadMemory() const {
+  return getKind() == Kind::Load || getKind() == Kind::Call;
+}
+
+bool Instruction::mayWriteMemory() const {
+  return getKind() == Kind::Store || getKind() == Kind::Call;
+}
+
+bool Instruction::mayHaveSideEffects() const {
+  return mayWriteMemory() || isTerminator();
+}
+
+void Instruction::insertBefore(Instruction *pos) {
+  assert(!parent_ && pos->parent_);
+  BasicBlock::link(this, pos, pos->parent_);
+}
+
+void Instruction::insertAfter(Instruction *pos) {
+  assert(!parent_ && pos->parent_);
+  BasicBlock::link(this, pos->next_, pos->parent_);
+}
+
+void Instruction::moveBefore(Instruction *pos) {
+  removeFromParent();
+  insertBefore(pos);
+}
+
+void Instruction::removeFromParent() {
+  if (!parent_)
+    return;
+  if (prev_)
+    prev_->next_ = next_;
+  else
+    parent_->first_ = next_;
+  if (next_)
+    next_->prev_ = prev_;
+  else
+    parent_->last_ = prev_;
+  parent_ = nullptr;
+  prev_ = next_ = nullptr;
+}
+
+void Instruction::eraseFromParent() {
+  assert(!hasUses() && "erasing an instruction that is still used");
+  removeFromParent();
+  dropAllReferences();
+}
+
+Instruction *Instruction::clone(Arena &arena) const {
+  Instruction *c = nullptr;
+  switch (getKind()) {
+  case Kind::Alloca:
+    c = arena.create<AllocaInst>(arena,
+                                 cast<AllocaInst>(this)->getAllocatedType());
+    break;
+  case Kind::Load:
+    c = arena.create<LoadInst>(arena, getOperand(0));
+    break;
+  case Kind::Store:
+    c = arena.create<StoreInst>(arena, getOperand(0), getOperand(1));
+    break;
+  case Kind::GEP: {
+    std::vector<Value *> indices(op_begin() + 1, op_end());
+    c = arena.create<GetElementPtrInst>(arena, getOperand(0),
+                                        ArrayRef<Value *>(indices));
+    break;
+  }
+  case Kind::Binary:
+    c = arena.create<BinaryInst>(arena, cast<BinaryInst>(this)->getOpcode(),
+                                 getOperand(0), getOperand(1));
+    break;
+  case Kind::ICmp:
+    c = arena.create<ICmpInst>(arena, cast<ICmpInst>(this)->getPredicate(),
+                               getOperand(0), getOperand(1));
+    break;
+  case Kind::Cast:
+    c = arena.create<CastInst>(arena, cast<CastInst>(this)->getOpcode(),
+                               getOperand(0), getType());
+    break;
+  case Kind::Phi: {
+    auto *phi = cast<PhiInst>(this);
+    auto *p = arena.create<PhiInst>(arena, getType(), phi->getNumIncoming());
+    for (unsigned i = 0; i < phi->getNumIncoming(); ++i)
+      p->addIncoming(arena, phi->getIncomingValue(i), phi->getIncomingBlock(i));
+    c = p;
+    break;
+  }
+  case Kind::Call: {
+    std::vector<Value *> args(op_begin() + 1, op_end());
+    c = arena.create<CallInst>(arena, cast<CallInst>(this)->getCallee(),
+                               ArrayRef<Value *>(args));
+    break;
+  }
+  case Kind::Br: {
+    auto *br = cast<BranchInst>(this);
+    if (br->isConditional())
+      c = arena.create<BranchInst>(arena, br->getCondition(),
+                                   br->getSuccessor(0), br->getSuccessor(1));
+    else
+      c = arena.create<BranchInst>(arena, br->getSuccessor(0));
+    break;
+  }
+  case Kind::Ret:
+    c = arena.create<RetInst>(arena, cast<RetInst>(this)->getReturnValue());
+    break;
+  default:
+    assert(false && "not an instruction");
+  }
+  c->setName(getName());
+  return c;
+}
+
+LoadInst::LoadInst(Arena &arena, Value *ptr)
+    : Instruction(Kind::Load,
+                  cast<PointerType>(ptr->getType())->getElementType(), arena,
+                  1) {
+  setOperand(0, ptr);
+}
+
+StoreInst::StoreInst(Arena &arena, Value *val, Value *ptr)
+    : Instruction(Kind::Store, Type::getVoidTy(), arena, 2) {
+  setOperand(0, val);
+  setOperand(1, ptr);
+}
+
+Type *GetElementPtrInst::getIndexedType(Type *source, unsigned numIndices) {
+  Type *t = source;
+  for (unsigned i = 1; i < numIndices; ++i)
+    t = cast<ArrayType>(t)->getElementType();
+  return t;
+}
+
+GetElementPtrInst::GetElementPtrInst(Arena &arena, Value *ptr,
+                                     ArrayRef<Value *> indices)
+    : Instruction(
+          Kind::GEP,
+          getIndexedType(cast<PointerType>(ptr->getType())->getElementType(),
+                         indices.size())
+              ->getPointerTo(),
+          arena, indices.size() + 1) {
+  setOperand(0, ptr);
+  for (unsigned i = 0; i < indices.size(); ++i)
+    setOperand(i + 1, indices[i]);
+}
+
+BinaryInst::BinaryInst(Arena &arena, Opcode op, Value *lhs, Value *rhs)
+    : Instruction(Kind::Binary, lhs->getType(), arena, 2) {
+  subclassData_ = op;
+  setOperand(0, lhs);
+  setOperand(1, rhs);
+}
+
+const char *BinaryInst::getOpcodeName(Opcode op) {
+  switch (op) {
+  case Add:
+    return "add";
+  case Sub:
+    return "sub";
+  case Mul:
+    return "mul";
+  case SDiv:
+    return "sdiv";
+  case SRem:
+    return "srem";
+  case Shl:
+    return "shl";
+  case AShr:
+    return "ashr";
+  case LShr:
+    return "lshr";
+  case And:
+    return "and";
+  case Or:
+    return "or";
+  case Xor:
+    return "xor";
+  }
+  return "";
+}
+
+bool BinaryInst::fold(Opcode op, int32_t lhs, int32_t rhs, int32_t &result) {
+  uint32_t a = lhs, b = rhs;
+  switch (op) {
+  case Add:
+    result = static_cast<int32_t>(a + b);
+    return true;
+  case Sub:
+    result = static_cast<int32_t>(a - b);
+    return true;
+  case Mul:
+    result = static_cast<int32_t>(a * b);
+    return true;
+  case SDiv:
+    if (rhs == 0 || (lhs == INT_MIN && rhs == -1))
+      return false;
+    result = lhs / rhs;
+    return true;
+  case SRem:
+    if (rhs == 0 || (lhs == INT_MIN && rhs == -1))
+      return false;
+    result = lhs % rhs;
+    return true;
+  case Shl:
+    if (b >= 32)
+      return false;
+    result = static_cast<int32_t>(a << b);
+    return true;
+  case AShr:
+    if (b >= 32)
+      return false;
+    result = lhs >> b;
+    return true;
+  case LShr:
+    if (b >= 32)
+      return false;
+    result = static_cast<int32_t>(a >> b);
+    return true;
+  case And:
+    result = lhs & rhs;
+    return true;
+  case Or:
+    result = lhs | rhs;
+    return true;
+  case Xor:
+    result = lhs ^ rhs;
+    return true;
+  }
+  return false;
+}
+
+ICmpInst::ICmpInst(Arena &arena, Predicate pred, Value *lhs, Value *rhs)
+    : Instruction(Kind::ICmp, Type::getInt1Ty(), arena, 2) {
+  subclassData_ = pred;
+  setOperand(0, lhs);
+  setOperand(1, rhs);
+}
+
+const char *ICmpInst::getPredicateName(Predicate p) {
+  switch (p) {
+  case EQ:
+    return "eq";
+  case NE:
+    return "ne";
+  case SLT:
+    return "slt";
+  case SGT:
+    return "sgt";
+  case SLE:
+    return "sle";
+  case SGE:
+    return "sge";
+  }
+  return "";
+}
+
+ICmpInst::Predicate ICmpInst::getSwappedPredicate(Predicate p) {
+  switch (p) {
+  case SLT:
+    return SGT;
+  case SGT:
+    return SLT;
+  case SLE:
+    return SGE;
+  case SGE:
+    return SLE;
+  default:
+    return p;
+  }
+}
+
+ICmpInst::Predicate ICmpInst::getInversePredicate(Predicate p) {
+  switch (p) {
+  case EQ:
+    return NE;
+  case NE:
+    return EQ;
+  case SLT:
+    return SGE;
+  case SGT:
+    return SLE;
+  case SLE:
+    return SGT;
+  case SGE:
+    return SLT;
+  }
+  return p;
+}
+
+bool ICmpInst::fold(Predicate p, int32_t lhs, int32_t rhs) {
+  switch (p) {
+  case EQ:
+    return lhs == rhs;
+  case NE:
+    return lhs != rhs;
+  case SLT:
+    return lhs < rhs;
+  case SGT:
+    return lhs > rhs;
+  case SLE:
+    return lhs <= rhs;
+  case SGE:
+    return lhs >= rhs;
+  }
+  return false;
+}
+
+CastInst::CastInst(Arena &arena, Opcode op, Value *v, Type *dest)
+    : Instruction(Kind::Cast, dest, arena, 1) {
+  subclassData_ = op;
+  setOperand(0, v);
+}
+
+PhiInst::PhiInst(Arena &arena, Type *t, unsigned reserved)
+    : Instruction(Kind::Phi, t, arena, 0, reserved) {
+  blocks_ = arena.allocArray<BasicBlock *>(capOps_);
+}
+
+void PhiInst::addIncoming(Arena &arena, Value *v, BasicBlock *bb) {
+  unsigned oldCap = capOps_;
+  addOperand(arena, v);
+  if (capOps_ != oldCap) {
+    BasicBlock **blocks = arena.allocArray<BasicBlock *>(capOps_);
+    std::copy(blocks_, blocks_ + numOps_ - 1, blocks);
+    blocks_ = blocks;
+  }
+  blocks_[numOps_ - 1] = bb;
+}
+
+void PhiInst::removeIncoming(unsigned i) {
+  removeOperand(i);
+  std::copy(blocks_ + i + 1, blocks_ + numOps_ + 1, blocks_ + i);
+}
+
+int PhiInst::getBasicBlockIndex(const BasicBlock *bb) const {
+  for (unsigned i = 0; i < numOps_; ++i)
+    if (blocks_[i] == bb)
+      return i;
+  return -1;
+}
+
+Value *PhiInst::getIncomingValueForBlock(const BasicBlock *bb) const {
+  int i = getBasicBlockIndex(bb);
+  return i < 0 ? nullptr : getIncomingValue(i);
+}
+
+Value *PhiInst::hasConstantValue() const {
+  Value *common = nullptr;
+  for (unsigned i = 0; i < numOps_; ++i) {
+    Value *v = getIncomingValue(i);
+    if (v == this)
+      continue;
+    if (common && v != common)
+      return nullptr;
+    common = v;
+  }
+  return common;
+}
+
+CallInst::CallInst(Arena &arena, Function *callee, ArrayRef<Value *> args)
+    : Instruction(Kind::Call, callee->getReturnType(), arena,
+                  args.size() + 1) {
+  setOperand(0, callee);
+  for (unsigned i = 0; i < args.size(); ++i)
+    setOperand(i + 1, args[i]);
+}
+
+BranchInst::BranchInst(Arena &arena, BasicBlock *dest)
+    : Instruction(Kind::Br, Type::getVoidTy(), arena, 1) {
+  setOperand(0, dest);
+}
+
+BranchInst::BranchInst(Arena &arena, Value *cond, BasicBlock *ifTrue,
+                       BasicBlock *ifFalse)
+    : Instruction(Kind::Br, Type::getVoidTy(), arena, 3) {
+  setOperand(0, cond);
+  setOperand(1, ifTrue);
+  setOperand(2, ifFalse);
+}
+
+BasicBlock *BranchInst::getSuccessor(unsigned i) const {
+  return cast<BasicBlock>(getOperand(isConditional() ? i + 1 : 0));
+}
+
+void BranchInst::setSuccessor(unsigned i, BasicBlock *bb) {
+  setOperand(isConditional() ? i + 1 : 0, bb);
+}
+
+RetInst::RetInst(Arena &arena, Value *v)
+    : Instruction(Kind::Ret, Type::getVoidTy(), arena, v ? 1 : 0) {
+  if (v)
+    setOperand(0, v);
+}
+
+//===----------------------------------------------------------------------===//
+// BasicBlock
+//===----------------------------------------------------------------------===//
+
+void BasicBlock::link(Instruction *inst, Instruction *pos, BasicBlock *bb) {
+  inst->parent_ = bb;
+  if (!pos) {
+    inst->prev_ = bb->last_;
+    inst->next_ = nullptr;
+    if (bb->last_)
+      bb->last_->next_ = inst;
+    else
+      bb->first_ = inst;
+    bb->last_ = inst;
+    return;
+  }
+  inst->next_ = pos;
+  inst->prev_ = pos->prev_;
+  if (pos->prev_)
+    pos->prev_->next_ = inst;
+  else
+    bb->first_ = inst;
+  pos->prev_ = inst;
+}
+
+unsigned BasicBlock::size() const {
+  unsigned n = 0;
+  for (Instruction *i = first_; i; i = i->getNextNode())
+    ++n;
+  return n;
+}
+
+Instruction *BasicBlock::getFirstNonPhi() const {
+  Instruction *i = first_;
+  while (i && isa<PhiInst>(i))
+    i = i->getNextNode();
+  return i;
+}
+
+unsigned BasicBlock::getNumSuccessors() const {
+  if (auto *br = dyn_cast<BranchInst>(last_))
+    return br->getNumSuccessors();
+  return 0;
+}
+
+BasicBlock *BasicBlock::getSuccessor(unsigned i) const {
+  return cast<BranchInst>(last_)->getSuccessor(i);
+}
+
+std::vector<BasicBlock *> BasicBlock::successors() const {
+  std::vector<BasicBlock *> result;
+  if (auto *br = dyn_cast<BranchInst>(last_))
+    for (unsigned i = 0; i < br->getNumSuccessors(); ++i)
+      result.push_back(br->getSuccessor(i));
+  return result;
+}
+
+std::vector<BasicBlock *> BasicBlock::predecessors() const {
+  std::vector<BasicBlock *> result;
+  for (Use *u = getFirstUse(); u; u = u->getNext())
+    result.push_back(cast<Instruction>(u->getUser())->getParent());
+  return result;
+}
+
+BasicBlock *BasicBlock::getSinglePredecessor() const {
+  Use *u = getFirstUse();
+  if (!u || u->getNext())
+    return nullptr;
+  return cast<Instruction>(u->getUser())->getParent();
+}
+
+BasicBlock *BasicBlock::getSingleSuccessor() const {
+  auto *br = dyn_cast<BranchInst>(last_);
+  return br && !br->isConditional() ? br->getSuccessor(0) : nullptr;
+}
+
+void BasicBlock::removePredecessor(BasicBlock *pred) {
+  for (Instruction *i = first_; i && isa<PhiInst>(i); i = i->getNextNode()) {
+    auto *phi = cast<PhiInst>(i);
+    int idx = phi->getBasicBlockIndex(pred);
+    if (idx >= 0)
+      phi->removeIncoming(idx);
+  }
+}
+
+void BasicBlock::replacePhiUsesWith(BasicBlock *from, BasicBlock *to) {
+  for (Instruction *i = first_; i && isa<PhiInst>(i); i = i->getNextNode()) {
+    auto *phi = cast<PhiInst>(i);
+    for (unsigned k = 0; k < phi->getNumIncoming(); ++k)
+      if (phi->getIncomingBlock(k) == from)
+        phi->setIncomingBlock(k, to);
+  }
+}
+
+BasicBlock *BasicBlock::splitAt(Instruction *pos, std::string_view name) {
+  assert(pos->getParent() == this);
+  BasicBlock *tail = parent_->createBlock(name, next_);
+  tail->first_ = pos;
+  tail->last_ = last_;
+  last_ = pos->prev_;
+  if (last_)
+    last_->next_ = nullptr;
+  else
+    first_ = nullptr;
+  pos->prev_ = nullptr;
+  for (Instruction *i = pos; i; i = i->next_)
+    i->parent_ = tail;
+  for (BasicBlock *succ : tail->successors())
+    succ->replacePhiUsesWith(this, tail);
+  return tail;
+}
+
+void BasicBlock::eraseFromParent() {
+  for (Instruction *i = first_; i; i = i->getNextNode())
+    i->dropAllReferences();
+  parent_->removeBlock(this);
+}
+
+void BasicBlock::moveAfter(BasicBlock *pos) {
+  Function *f = parent_;
+  f->removeBlock(this);
+  f->insertBlock(this, pos->next_);
+}
+
+//===----------------------------------------------------------------------===//
+// Function and Module
+//===----------------------------------------------------------------------===//
+
+Function::Function(Module *parent, FunctionType *type, std::string_view name)
+    : Value(Kind::Function, type), parent_(parent) {
+  setName(name);
+  numArgs_ = type->getNumParams();
+  args_ = arena_.allocArray<Argument *>(numArgs_);
+  for (unsigned i = 0; i < numArgs_; ++i)
+    args_[i] = arena_.create<Argument>(type->getParamType(i), this, i);
+}
+
+Function::~Function() = default;
+
+BasicBlock *Function::createBlock(std::string_view name, BasicBlock *before) {
+  auto *bb = arena_.create<BasicBlock>(name);
+  insertBlock(bb, before);
+  return bb;
+}
+
+void Function::insertBlock(BasicBlock *bb, BasicBlock *before) {
+  bb->parent_ = this;
+  if (!before) {
+    bb->prev_ = last_;
+    bb->next_ = nullptr;
+    if (last_)
+      last_->next_ = bb;
+    else
+      first_ = bb;
+    last_ = bb;
+    return;
+  }
+  bb->next_ = before;
+  bb->prev_ = before->prev_;
+  if (before->prev_)
+    before->prev_->next_ = bb;
+  else
+    first_ = bb;
+  before->prev_ = bb;
+}
+
+void Function::removeBlock(BasicBlock *bb) {
+  if (bb->prev_)
+    bb->prev_->next_ = bb->next_;
+  else
+    first_ = bb->next_;
+  if (bb->next_)
+    bb->next_->prev_ = bb->prev_;
+  else
+    last_ = bb->prev_;
+  bb->prev_ = bb->next_ = nullptr;
+  bb->parent_ = nullptr;
+}
+
+unsigned Function::renumberBlocks() {
+  unsigned n = 0;
+  for (BasicBlock *bb = first_; bb; bb = bb->next_)
+    bb->number_ = n++;
+  return n;
+}
+
+unsigned Function::getNumBlocks() const {
+  unsigned n = 0;
+  for (BasicBlock *bb = first_; bb; bb = bb->next_)
+    ++n;
+  return n;
+}
+
+unsigned Function::getInstructionCount() const {
+  unsigned n = 0;
+  for (BasicBlock *bb = first_; bb; bb = bb->next_)
+    n += bb->size();
+  return n;
+}
+
+ConstantInt *Function::getConstantInt(IntegerType *t, int32_t v) {
+  if (t->getBitWidth() == 1)
+    v &= 1;
+  uint64_t key = (uint64_t)t->getBitWidth() << 32 | (uint32_t)v;
+  ConstantInt *&slot = constants_[key];
+  if (!slot)
+    slot = arena_.create<ConstantInt>(t, v);
+  return slot;
+}
+
+UndefValue *Function::getUndef(Type *t) {
+  UndefValue *&slot = undefs_[t];
+  if (!slot)
+    slot = arena_.create<UndefValue>(t);
+  return slot;
+}
+
+void Function::dropAllReferences() {
+  for (BasicBlock *bb = first_; bb; bb = bb->next_)
+    for (Instruction *i = bb->front(); i; i = i->getNextNode())
+      i->dropAllReferences();
+}
+
+Module::~Module() = default;
+
+Function *Module::createFunction(FunctionType *type, std::string_view name) {
+  name = internString(name);
+  functions_.push_back(std::make_unique<Function>(this, type, name));
+  Function *f = functions_.back().get();
+  symbols_[name] = f;
+  return f;
+}
+
+GlobalVariable *Module::createGlobal(Type *valueType, std::string_view name,
+                                     bool isConstant, bool isPrivate) {
+  name = internString(name);
+  auto *g = arena_.create<GlobalVariable>(valueType, name, isConstant,
+                                          isPrivate);
+  globals_.push_back(g);
+  symbols_[name] = g;
+  return g;
+}
+
+void Module::eraseFunction(Function *f) {
+  assert(!f->hasUses() && "erasing a function that is still called");
+  f->dropAllReferences();
+  symbols_.erase(f->getName());
+  auto it = std::find_if(functions_.begin(), functions_.end(),
+                         [f](const auto &p) { return p.get() == f; });
+  functions_.erase(it);
+}
+
+Function *Module::getFunction(std::string_view name) const {
+  auto it = symbols_.find(name);
+  return it == symbols_.end() ? nullptr : dyn_cast<Function>(it->second);
+}
+
+GlobalVariable *Module::getGlobal(std::string_view name) const {
+  auto it = symbols_.find(name);
+  return it == symbols_.end() ? nullptr : dyn_cast<GlobalVariable>(it->second);
+}
@@ -0,0 +1,810 @@
+#include "IRGen.h"
+
+#include <cassert>
+
+namespace {
+
+struct LibFunction {
+  const char *sourceName;
+  const char *runtimeName;
+  bool returnsInt;
+  int numParams;
+  bool pointerParam[2];
+};
+
+// The sylib runtime (test/resources/sylib.h). starttime()/stoptime() are
+// macros that pass the source line to the underlying runtime function.
+const LibFunction kLibFunctions[] = {
+    {"getint", "getint", true, 0, {}},
+    {"getch", "getch", true, 0, {}},
+    {"getarray", "getarray", true, 1, {true}},
+    {"putint", "putint", false, 1, {false}},
+    {"putch", "putch", false, 1, {false}},
+    {"putarray", "putarray", false, 2, {false, true}},
+    {"starttime", "_sysy_starttime", false, 1, {false}},
+    {"stoptime", "_sysy_stoptime", false, 1, {false}},
+};
+
+unsigned rankOf(Type *t) {
+  unsigned rank = 0;
+  while (auto *a = dyn_cast<ArrayType>(t)) {
+    ++rank;
+    t = a->getElementType();
+  }
+  return rank;
+}
+
+std::vector<uint32_t> dimsOf(Type *t) {
+  std::vector<uint32_t> dims;
+  while (auto *a = dyn_cast<ArrayType>(t)) {
+    dims.push_back(a->getNumElements());
+    t = a->getElementType();
+  }
+  return dims;
+}
+
+bool isComparison(BinaryOp op) {
+  switch (op) {
+  case BinaryOp::Lt:
+  case BinaryOp::Gt:
+  case BinaryOp::Le:
+  case BinaryOp::Ge:
+  case BinaryOp::Eq:
+  case BinaryOp::Ne:
+    return true;
+  default:
+    return false;
+  }
+}
+
+ICmpInst::Predicate predicateOf(BinaryOp op) {
+  switch (op) {
+  case BinaryOp::Lt:
+    return ICmpInst::SLT;
+  case BinaryOp::Gt:
+    return ICmpInst::SGT;
+  case BinaryOp::Le:
+    return ICmpInst::SLE;
+  case BinaryOp::Ge:
+    return ICmpInst::SGE;
+  case BinaryOp::Eq:
+    return ICmpInst::EQ;
+  default:
+    return ICmpInst::NE;
+  }
+}
+
+BinaryInst::Opcode opcodeOf(BinaryOp op) {
+  switch (op) {
+  case BinaryOp::Add:
+    return BinaryInst::Add;
+  case BinaryOp::Sub:
+    return BinaryInst::Sub;
+  case BinaryOp::Mul:
+    return BinaryInst::Mul;
+  case BinaryOp::Div:
+    return BinaryInst::SDiv;
+  default:
+    return BinaryInst::SRem;
+  }
+}
+
+// Local arrays with more elements than this are cleared with memset before
+// their explicit initializers are stored.
+constexpr size_t kMemsetThreshold = 16;
+
+} // namespace
+
+void IRGen::run(const CompUnit *cu) {
+  pushScope();
+  for (const TopLevel &item : cu->items) {
+    if (item.decl)
+      genGlobalDecl(item.decl);
+    else
+      genFunction(item.func);
+  }
+  popScope();
+}
+
+//===----------------------------------------------------------------------===//
+// Symbol table
+//===----------------------------------------------------------------------===//
+
+void IRGen::pushScope() { scopes_.emplace_back(); }
+
+void IRGen::popScope() {
+  for (Symbol *sym : scopes_.back()) {
+    if (sym->shadowed)
+      symbols_[sym->name] = sym->shadowed;
+    else
+      symbols_.erase(sym->name);
+  }
+  scopes_.pop_back();
+}
+
+IRGen::Symbol *IRGen::declare(std::string_view name, uint32_t line) {
+  Symbol *&slot = symbols_[name];
+  if (slot && slot->depth == scopes_.size())
+    throw CompileError(line, "redefinition of '" + std::string(name) + "'");
+  auto *sym = symbolArena_.create<Symbol>();
+  sym->name = name;
+  sym->depth = scopes_.size();
+  sym->shadowed = slot;
+  slot = sym;
+  scopes_.back().push_back(sym);
+  return sym;
+}
+
+IRGen::Symbol *IRGen::lookup(std::string_view name, uint32_t line) const {
+  auto it = symbols_.find(name);
+  if (it == symbols_.end())
+    throw CompileError(line, "use of undeclared identifier '" +
+                                 std::string(name) + "'");
+  return it->second;
+}
+
+Function *IRGen::lookupFunction(std::string_view name, uint32_t line) {
+  auto it = functions_.find(name);
+  if (it != functions_.end())
+    return it->second;
+  for (const LibFunction &lib : kLibFunctions) {
+    if (name != lib.sourceName)
+      continue;
+    std::vector<Type *> params;
+    for (int i = 0; i < lib.numParams; ++i)
+      params.push_back(lib.pointerParam[i]
+                           ? static_cast<Type *>(Type::getInt32Ty()->getPointerTo())
+                           : Type::getInt32Ty());
+    Type *ret = lib.returnsInt ? static_cast<Type *>(Type::getInt32Ty())
+                               : Type::getVoidTy();
+    Function *f =
+        m_.createFunction(FunctionType::get(ret, params), lib.runtimeName);
+    functions_[name] = f;
+    return f;
+  }
+  throw CompileError(line, "call to undeclared function '" +
+                               std::string(name) + "'");
+}
+
+//===----------------------------------------------------------------------===//
+// Declarations
+//===----------------------------------------------------------------------===//
+
+std::vector<uint32_t> IRGen::evalDims(ArrayRef<Expr *> dims) {
+  std::vector<uint32_t> result;
+  for (const Expr *e : dims) {
+    int32_t n = evalConstOrFail(e);
+    if (n < 0)
+      throw CompileError(e->line, "array dimension is negative");
+    result.push_back(n);
+  }
+  return result;
+}
+
+Type *IRGen::arrayTypeOf(const std::vector<uint32_t> &dims) {
+  Type *t = Type::getInt32Ty();
+  for (auto it = dims.rbegin(); it != dims.rend(); ++it)
+    t = ArrayType::get(t, *it);
+  return t;
+}
+
+void IRGen::flattenInit(const InitVal *init, const std::vector<uint32_t> &dims,
+                        std::vector<const Expr *> &out) {
+  std::vector<size_t> strides(dims.size() + 1, 1);
+  for (size_t i = dims.size(); i-- > 0;)
+    strides[i] = strides[i + 1] * dims[i];
+  out.assign(strides[0], nullptr);
+  if (!init->isList()) {
+    if (!dims.empty())
+      throw CompileError(init->expr->line,
+                         "array must be initialized with a brace list");
+    out[0] = init->expr;
+    return;
+  }
+  flattenList(init, strides, 0, 0, out);
+}
+
+void IRGen::flattenList(const InitVal *list, const std::vector<size_t> &strides,
+                        size_t level, size_t begin,
+                        std::vector<const Expr *> &out) {
+  size_t rank = strides.size() - 1;
+  size_t cursor = begin, end = begin + strides[level];
+  for (const InitVal *item : list->list) {
+    if (cursor >= end)
+      break;
+    if (!item->isList()) {
+      out[cursor++] = item->expr;
+      continue;
+    }
+    // A nested list initializes the largest sub-array that starts at the
+    // cursor.
+    size_t sub = std::min(level + 1, rank);
+    while (sub < rank && (cursor - begin) % strides[sub] != 0)
+      ++sub;
+    flattenList(item, strides, sub, cursor, out);
+    cursor += strides[sub];
+  }
+}
+
+ArrayRef<int32_t> IRGen::evalInit(const std::vector<const Expr *> &flat) {
+  std::vector<int32_t> values(flat.size(), 0);
+  for (size_t i = 0; i < flat.size(); ++i)
+    if (flat[i])
+      values[i] = evalConstOrFail(flat[i]);
+  return m_.getArena().copyArray(values);
+}
+
+void IRGen::genGlobalDecl(const DeclStmt *decl) {
+  for (const VarDef *def : decl->defs) {
+    std::vector<uint32_t> dims = evalDims(def->dims);
+    Type *type = arrayTypeOf(dims);
+    ArrayRef<int32_t> values;
+    if (def->init) {
+      std::vector<const Expr *> flat;
+      flattenInit(def->init, dims, flat);
+      values = evalInit(flat);
+    } else if (def->isConst) {
+      throw CompileError(def->line, "const variable needs an initializer");
+    }
+
+    Symbol *sym = declare(def->name, def->line);
+    sym->type = type;
+    sym->isConst = def->isConst;
+    sym->constVals = values;
+    if (def->isConst && dims.empty())
+      continue;
+
+    // Trailing zeroes are implied by the initializer's shorter length.
+    size_t n = values.size();
+    while (n > 0 && values[n - 1] == 0)
+      --n;
+    GlobalVariable *g = m_.createGlobal(type, def->name, def->isConst);
+    g->setInitializer(ArrayRef<int32_t>(values.data(), n));
+    sym->addr = g;
+  }
+}
+
+void IRGen::genLocalDecl(const DeclStmt *decl) {
+  for (const VarDef *def : decl->defs) {
+    std::vector<uint32_t> dims = evalDims(def->dims);
+    Type *type = arrayTypeOf(dims);
+    std::vector<const Expr *> flat;
+    if (def->init)
+      flattenInit(def->init, dims, flat);
+    else if (def->isConst)
+      throw CompileError(def->line, "const variable needs an initializer");
+
+    if (def->isConst) {
+      ArrayRef<int32_t> values = evalInit(flat);
+      Symbol *sym = declare(def->name, def->line);
+      sym->type = type;
+      sym->isConst = true;
+      sym->constVals = values;
+      if (dims.empty())
+        continue;
+      // Const arrays live in read-only memory, named after their function so
+      // that the LLVM output stays readable.
+      std::string name = "__const." + std::string(curFunc_->getName()) + "." +
+                         std::string(def->name);
+      std::string unique = name;
+      for (unsigned i = 1; m_.getGlobal(unique); ++i)
+        unique = name + "." + std::to_string(i);
+      size_t n = values.size();
+      while (n > 0 && values[n - 1] == 0)
+        --n;
+      GlobalVariable *g = m_.createGlobal(type, unique, true, true);
+      g->setInitializer(ArrayRef<int32_t>(values.data(), n));
+      sym->addr = g;
+      continue;
+    }
+
+    // The variable is in scope in its own initializer, as in C.
+    Symbol *sym = declare(def->name, def->line);
+    sym->type = type;
+    AllocaInst *slot =
+        createEntryAlloca(type, curFunc_->getArena().copyString(def->name));
+    sym->addr = slot;
+    if (!def->init)
+      continue;
+    if (dims.empty())
+      builder_.createStore(genExpr(flat[0]), slot);
+    else
+      storeLocalArrayInit(slot, type, flat);
+  }
+}
+
+void IRGen::storeLocalArrayInit(Value *addr, Type *type,
+                                const std::vector<const Expr *> &flat) {
+  // Address the array as a flat i32 buffer.
+  std::vector<Value *> zeros(rankOf(type) + 1, builder_.getInt32(0));
+  Value *base = builder_.createGEP(addr, ArrayRef<Value *>(zeros));
+
+  bool useMemset = flat.size() > kMemsetThreshold;
+  if (useMemset) {
+    Type *i8Ptr = Type::getInt8Ty()->getPointerTo();
+    Value *raw = builder_.createBitCast(addr, i8Ptr);
+    Value *args[] = {
+        raw, curFunc_->getConstantInt(Type::getInt8Ty(), 0),
+        builder_.getInt32(static_cast<int32_t>(type->getSizeInBytes())),
+        builder_.getInt1(false)};
+    builder_.createCall(getMemset(), ArrayRef<Value *>(args, 4));
+  }
+  for (size_t i = 0; i < flat.size(); ++i) {
+    Value *v;
+    if (flat[i]) {
+      v = genExpr(flat[i]);
+    } else if (!useMemset) {
+      v = builder_.getInt32(0);
+    } else {
+      continue;
+    }
+    if (useMemset && isa<ConstantInt>(v) && cast<ConstantInt>(v)->isZero())
+      continue;
+    Value *ptr =
+        i == 0 ? base
+               : builder_.createGEP(base, {builder_.getInt32(static_cast<int32_t>(i))});
+    builder_.createStore(v, ptr);
+  }
+}
+
+Function *IRGen::getMemset() {
+  if (Function *f = m_.getFunction("llvm.memset.p0i8.i32"))
+    return f;
+  std::vector<Type *> params = {Type::getInt8Ty()->getPointerTo(),
+                                Type::getInt8Ty(), Type::getInt32Ty(),
+                                Type::getInt1Ty()};
+  return m_.createFunction(FunctionType::get(Type::getVoidTy(), params),
+                           "llvm.memset.p0i8.i32");
+}
+
+AllocaInst *IRGen::createEntryAlloca(Type *t, std::string_view name) {
+  Arena &arena = curFunc_->getArena();
+  auto *slot = arena.create<AllocaInst>(arena, t);
+  slot->setName(name);
+  BasicBlock *entry = curFunc_->getEntryBlock();
+  if (lastAlloca_)
+    slot->insertAfter(lastAlloca_);
+  else if (!entry->empty())
+    slot->insertBefore(entry->front());
+  else
+    entry->push_back(slot);
+  lastAlloca_ = slot;
+  return slot;
+}
+
+void IRGen::genFunction(const FuncDef *def) {
+  if (functions_.count(def->name))
+    throw CompileError(def->line,
+                       "redefinition of function '" + std::string(def->name) + "'");
+
+  std::vector<Type *> paramTypes;
+  std::vector<Type *> pointeeTypes;
+  for (const FuncParam *p : def->params) {
+    if (!p->isArray) {
+      paramTypes.push_back(Type::getInt32Ty());
+      continue;
+    }
+    Type *elem = arrayTypeOf(evalDims(p->dims));
+    paramTypes.push_back(elem->getPointerTo());
+  }
+  Type *ret = def->returnsVoid ? Type::getVoidTy()
+                               : static_cast<Type *>(Type::getInt32Ty());
+  Function *f = m_.createFunction(FunctionType::get(ret, paramTypes), def->name);
+  functions_[def->name] = f;
+
+  curFunc_ = f;
+  lastAlloca_ = nullptr;
+  builder_ = IRBuilder(f);
+  builder_.setInsertPoint(f->createBlock("entry"));
+
+  pushScope();
+  for (unsigned i = 0; i < def->params.size(); ++i) {
+    const FuncParam *p = def->params[i];
+    std::string_view name = f->getArena().copyString(p->name);
+    Argument *arg = f->getArg(i);
+    arg->setName(name);
+    Symbol *sym = declare(p->name, def->line);
+    sym->type = arg->getType();
+    sym->isArrayParam = p->isArray;
+    AllocaInst *slot = createEntryAlloca(arg->getType(), name);
+    builder_.createStore(arg, slot);
+    sym->addr = slot;
+  }
+  genBlock(def->body);
+  popScope();
+
+  if (!builder_.getInsertBlock()->getTerminator())
+    emitDefaultReturn();
+  curFunc_ = nullptr;
+}
+
+//===----------------------------------------------------------------------===//
+// Statements
+//===----------------------------------------------------------------------===//
+
+void IRGen::ensureInsertBlock() {
+  if (builder_.getInsertBlock()->getTerminator())
+    builder_.setInsertPoint(curFunc_->createBlock("dead"));
+}
+
+void IRGen::emitDefaultReturn() {
+  if (curFunc_->getReturnType()->isVoidTy())
+    builder_.createRet(nullptr);
+  else
+    builder_.createRet(builder_.getInt32(0));
+}
+
+void IRGen::genStmt(const Stmt *s) {
+  ensureInsertBlock();
+  switch (s->kind) {
+  case Stmt::Kind::Decl:
+    genLocalDecl(cast<DeclStmt>(s));
+    break;
+  case Stmt::Kind::Assign: {
+    auto *a = cast<AssignStmt>(s);
+    const Symbol *sym = lookup(a->lval->name, a->lval->line);
+    if (sym->isConst)
+      throw CompileError(s->line, "cannot assign to const variable '" +
+                                      std::string(sym->name) + "'");
+    unsigned rank = sym->isArrayParam
+                        ? 1 + rankOf(cast<PointerType>(sym->type)->getElementType())
+                        : rankOf(sym->type);
+    if (a->lval->indices.size() != rank)
+      throw CompileError(s->line, "assignment to an array");
+    Value *addr = genAddress(a->lval, sym, false);
+    builder_.createStore(genExpr(a->value), addr);
+    break;
+  }
+  case Stmt::Kind::Expr:
+    if (const Expr *e = cast<ExprStmt>(s)->expr)
+      genExpr(e);
+    break;
+  case Stmt::Kind::Block:
+    genBlock(cast<BlockStmt>(s));
+    break;
+  case Stmt::Kind::If:
+    genIf(cast<IfStmt>(s));
+    break;
+  case Stmt::Kind::While:
+    genWhile(cast<WhileStmt>(s));
+    break;
+  case Stmt::Kind::Break:
+    if (loops_.empty())
+      throw CompileError(s->line, "'break' outside of a loop");
+    builder_.createBr(loops_.back().breakTarget);
+    break;
+  case Stmt::Kind::Continue:
+    if (loops_.empty())
+      throw CompileError(s->line, "'continue' outside of a loop");
+    builder_.createBr(loops_.back().continueTarget);
+    break;
+  case Stmt::Kind::Return:
+    genReturn(cast<ReturnStmt>(s));
+    break;
+  }
+}
+
+void IRGen::genBlock(const BlockStmt *b) {
+  pushScope();
+  for (const Stmt *s : b->items)
+    genStmt(s);
+  popScope();
+}
+
+void IRGen::genIf(const IfStmt *s) {
+  BasicBlock *thenBB = curFunc_->createBlock("if.then");
+  BasicBlock *elseBB = s->elseStmt ? curFunc_->createBlock("if.else") : nullptr;
+  BasicBlock *endBB = curFunc_->createBlock("if.end");
+  genCond(s->cond, thenBB, elseBB ? elseBB : endBB);
+
+  builder_.setInsertPoint(thenBB);
+  genStmt(s->thenStmt);
+  if (!builder_.getInsertBlock()->getTerminator())
+    builder_.createBr(endBB);
+
+  if (elseBB) {
+    elseBB->moveAfter(builder_.getInsertBlock());
+    builder_.setInsertPoint(elseBB);
+    genStmt(s->elseStmt);
+    if (!builder_.getInsertBlock()->getTerminator())
+      builder_.createBr(endBB);
+  }
+  endBB->moveAfter(builder_.getInsertBlock());
+  builder_.setInsertPoint(endBB);
+}
+
+void IRGen::genWhile(const WhileStmt *s) {
+  BasicBlock *condBB = curFunc_->createBlock("while.cond");
+  BasicBlock *bodyBB = curFunc_->createBlock("while.body");
+  BasicBlock *endBB = curFunc_->createBlock("while.end");
+  builder_.createBr(condBB);
+
+  builder_.setInsertPoint(condBB);
+  genCond(s->cond, bodyBB, endBB);
+
+  bodyBB->moveAfter(builder_.getInsertBlock());
+  builder_.setInsertPoint(bodyBB);
+  loops_.push_back({condBB, endBB});
+  genStmt(s->body);
+  loops_.pop_back();
+  if (!builder_.getInsertBlock()->getTerminator())
+    builder_.createBr(condBB);
+
+  endBB->moveAfter(builder_.getInsertBlock());
+  builder_.setInsertPoint(endBB);
+}
+
+void IRGen::genReturn(const ReturnStmt *s) {
+  if (curFunc_->getReturnType()->isVoidTy()) {
+    if (s->value)
+      genExpr(s->value);
+    builder_.createRet(nullptr);
+    return;
+  }
+  if (!s->value) {
+    emitDefaultReturn();
+    return;
+  }
+  builder_.createRet(genExpr(s->value));
+}
+
+//===----------------------------------------------------------------------===//
+// Expressions
+//===----------------------------------------------------------------------===//
+
+Value *IRGen::genExpr(const Expr *e) {
+  switch (e->kind) {
+  case Expr::Kind::IntLiteral:
+    return builder_.getInt32(cast<IntLiteral>(e)->value);
+  case Expr::Kind::LVal:
+    return genLVal(cast<LValExpr>(e));
+  case Expr::Kind::Call:
+    return genCall(cast<CallExpr>(e));
+  case Expr::Kind::Unary: {
+    auto *u = cast<UnaryExpr>(e);
+    Value *v = genExpr(u->operand);
+    switch (u->op) {
+    case UnaryOp::Plus:
+      return v;
+    case UnaryOp::Minus:
+      return builder_.createSub(builder_.getInt32(0), v);
+    case UnaryOp::Not:
+      return builder_.createZExt(
+          builder_.createICmp(ICmpInst::EQ, v, builder_.getInt32(0)),
+          Type::getInt32Ty());
+    }
+    break;
+  }
+  case Expr::Kind::Binary:
+    return genBinary(cast<BinaryExpr>(e));
+  }
+  assert(false && "unknown expression");
+  return nullptr;
+}
+
+Value *IRGen::genBinary(const BinaryExpr *e) {
+  if (isComparison(e->op))
+    return builder_.createZExt(genCmp(e), Type::getInt32Ty());
+  if (e->op == BinaryOp::And || e->op == BinaryOp::Or) {
+    // A logical operator used as a value: branch on it and merge the outcome
+    // with a phi.
+    BasicBlock *trueBB = curFunc_->createBlock("bool.true");
+    BasicBlock *falseBB = curFunc_->createBlock("bool.false");
+    BasicBlock *endBB = curFunc_->createBlock("bool.end");
+    genCond(e, trueBB, falseBB);
+    trueBB->moveAfter(builder_.getInsertBlock());
+    builder_.setInsertPoint(trueBB);
+    builder_.createBr(endBB);
+    falseBB->moveAfter(trueBB);
+    builder_.setInsertPoint(falseBB);
+    builder_.createBr(endBB);
+    endBB->moveAfter(falseBB);
+    builder_.setInsertPoint(endBB);
+    PhiInst *phi = builder_.createPhi(Type::getInt1Ty());
+    phi->addIncoming(curFunc_->getArena(), builder_.getInt1(true), trueBB);
+    phi->addIncoming(curFunc_->getArena(), builder_.getInt1(false), falseBB);
+    return builder_.createZExt(phi, Type::getInt32Ty());
+  }
+  Value *lhs = genExpr(e->lhs);
+  Value *rhs = genExpr(e->rhs);
+  return builder_.createBinary(opcodeOf(e->op), lhs, rhs);
+}
+
+Value *IRGen::genCmp(const BinaryExpr *e) {
+  Value *lhs = genExpr(e->lhs);
+  Value *rhs = genExpr(e->rhs);
+  return builder_.createICmp(predicateOf(e->op), lhs, rhs);
+}
+
+void IRGen::genCond(const Expr *e, BasicBlock *ifTrue, BasicBlock *ifFalse) {
+  int32_t c;
+  if (evalConst(e, c)) {
+    builder_.createBr(c ? ifTrue : ifFalse);
+    return;
+  }
+  if (auto *u = dyn_cast<UnaryExpr>(e); u && u->op == UnaryOp::Not) {
+    genCond(u->operand, ifFalse, ifTrue);
+    return;
+  }
+  Value *cond;
+  auto *b = dyn_cast<BinaryExpr>(e);
+  if (b && (b->op == BinaryOp::And || b->op == BinaryOp::Or)) {
+    bool isAnd = b->op == BinaryOp::And;
+    BasicBlock *rhsBB = curFunc_->createBlock(isAnd ? "land.rhs" : "lor.rhs");
+    if (isAnd)
+      genCond(b->lhs, rhsBB, ifFalse);
+    else
+      genCond(b->lhs, ifTrue, rhsBB);
+    rhsBB->moveAfter(builder_.getInsertBlock());
+    builder_.setInsertPoint(rhsBB);
+    genCond(b->rhs, ifTrue, ifFalse);
+    return;
+  }
+  if (b && isComparison(b->op))
+    cond = genCmp(b);
+  else
+    cond = builder_.createICmp(ICmpInst::NE, genExpr(e), builder_.getInt32(0));
+
+  if (auto *k = dyn_cast<ConstantInt>(cond))
+    builder_.createBr(k->getValue() ? ifTrue : ifFalse);
+  else
+    builder_.createCondBr(cond, ifTrue, ifFalse);
+}
+
+Value *IRGen::genAddress(const LValExpr *e, const Symbol *sym, bool decay) {
+  if (!sym->isArrayParam && !sym->type->isArrayTy()) {
+    if (!e->indices.empty())
+      throw CompileError(e->line, "subscripted value is not an array");
+    return sym->addr;
+  }
+
+  std::vector<Value *> indices;
+  Value *base;
+  unsigned rank;
+  if (sym->isArrayParam) {
+    base = builder_.createLoad(sym->addr);
+    rank = 1 + rankOf(cast<PointerType>(sym->type)->getElementType());
+    if (e->indices.empty())
+      return base;
+  } else {
+    base = sym->addr;
+    rank = rankOf(sym->type);
+    indices.push_back(builder_.getInt32(0));
+  }
+  if (e->indices.size() > rank)
+    throw CompileError(e->line, "too many subscripts for '" +
+                                    std::string(e->name) + "'");
+  for (const Expr *idx : e->indices)
+    indices.push_back(genExpr(idx));
+
+  Type *source = cast<PointerType>(base->getType())->getElementType();
+  if (decay &&
+      GetElementPtrInst::getIndexedType(source, indices.size())->isArrayTy())
+    indices.push_back(builder_.getInt32(0));
+  return builder_.createGEP(base, ArrayRef<Value *>(indices));
+}
+
+Value *IRGen::genLVal(const LValExpr *e) {
+  const Symbol *sym = lookup(e->name, e->line);
+  unsigned rank = sym->isArrayParam
+                      ? 1 + rankOf(cast<PointerType>(sym->type)->getElementType())
+                      : rankOf(sym->type);
+
+  if (sym->isConst && e->indices.size() == rank) {
+    int32_t v;
+    if (evalConst(e, v))
+      return builder_.getInt32(v);
+  }
+
+  Value *addr = genAddress(e, sym, true);
+  if (e->indices.size() < rank)
+    return addr;
+  return builder_.createLoad(addr);
+}
+
+Value *IRGen::genCall(const CallExpr *e) {
+  Function *callee = lookupFunction(e->callee, e->line);
+  FunctionType *fty = callee->getFunctionType();
+  std::vector<Value *> args;
+  if (callee->getName() == "_sysy_starttime" ||
+      callee->getName() == "_sysy_stoptime") {
+    args.push_back(builder_.getInt32(static_cast<int32_t>(e->line)));
+  } else {
+    if (e->args.size() != fty->getNumParams())
+      throw CompileError(e->line, "wrong number of arguments to '" +
+                                      std::string(e->callee) + "'");
+    for (unsigned i = 0; i < e->args.size(); ++i) {
+      const Expr *arg = e->args[i];
+      if (!fty->getParamType(i)->isPointerTy()) {
+        args.push_back(genExpr(arg));
+        continue;
+      }
+      auto *lval = dyn_cast<LValExpr>(arg);
+      if (!lval)
+        throw CompileError(arg->line, "expected an array argument");
+      args.push_back(genAddress(lval, lookup(lval->name, lval->line), true));
+    }
+  }
+  return builder_.createCall(callee, ArrayRef<Value *>(args));
+}
+
+bool IRGen::evalConst(const Expr *e, int32_t &result) const {
+  switch (e->kind) {
+  case Expr::Kind::IntLiteral:
+    result = cast<IntLiteral>(e)->value;
+    return true;
+  case Expr::Kind::LVal: {
+    auto *lval = cast<LValExpr>(e);
+    auto it = symbols_.find(lval->name);
+    if (it == symbols_.end() || !it->second->isConst)
+      return false;
+    const Symbol *sym = it->second;
+    std::vector<uint32_t> dims = dimsOf(sym->type);
+    if (lval->indices.size() != dims.size())
+      return false;
+    size_t flat = 0;
+    for (size_t i = 0; i < dims.size(); ++i) {
+      int32_t idx;
+      if (!evalConst(lval->indices[i], idx) || idx < 0 ||
+          static_cast<uint32_t>(idx) >= dims[i])
+        return false;
+      flat = flat * dims[i] + idx;
+    }
+    result = flat < sym->constVals.size() ? sym->constVals[flat] : 0;
+    return true;
+  }
+  case Expr::Kind::Call:
+    return false;
+  case Expr::Kind::Unary: {
+    auto *u = cast<UnaryExpr>(e);
+    int32_t v;
+    if (!evalConst(u->operand, v))
+      return false;
+    switch (u->op) {
+    case UnaryOp::Plus:
+      result = v;
+      break;
+    case UnaryOp::Minus:
+      result = static_cast<int32_t>(0u - static_cast<uint32_t>(v));
+      break;
+    case UnaryOp::Not:
+      result = v == 0;
+      break;
+    }
+    return true;
+  }
+  case Expr::Kind::Binary: {
+    auto *b = cast<BinaryExpr>(e);
+    int32_t l, r;
+    if (!evalConst(b->lhs, l))
+      return false;
+    if (b->op == BinaryOp::And && l == 0) {
+      result = 0;
+      return true;
+    }
+    if (b->op == BinaryOp::Or && l != 0) {
+      result = 1;
+      return true;
+    }
+    if (!evalConst(b->rhs, r))
+      return false;
+    if (b->op == BinaryOp::And || b->op == BinaryOp::Or) {
+      result = r != 0;
+      return true;
+    }
+    if (isComparison(b->op)) {
+      result = ICmpInst::fold(predicateOf(b->op), l, r);
+      return true;
+    }
+    return BinaryInst::fold(opcodeOf(b->op), l, r, result);
+  }
+  }
+  return false;
+}
+
+int32_t IRGen::evalConstOrFail(const Expr *e) const {
+  int32_t v;
+  if (!evalConst(e, v))
+    throw CompileError(e->line, "expression is not a compile-time constant");
+  return v;
+}
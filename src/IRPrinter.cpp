@@ -0,0 +1,368 @@
+#include "IRPrinter.h"
+#include "ThreadPool.h"
+
+#include <charconv>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// LLVM truncates local names longer than 1024 characters, so that two long
+// names with a common prefix would clash; longer hints are cut down and
+// always get a numeric suffix.
+constexpr size_t kMaxHintLength = 64;
+
+void appendInt(std::string &out, int64_t v) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), v);
+  out.append(buf, res.ptr);
+}
+
+class FunctionPrinter {
+public:
+  FunctionPrinter(const Function &f, std::string &out) : f_(f), out_(out) {}
+
+  void print();
+
+private:
+  void assignName(Value *v);
+  void printLocalName(const Value *v);
+  void printName(const Value *v);
+  void printOperand(const Value *v, bool withType = true);
+  void printInstruction(const Instruction *inst);
+
+  const Function &f_;
+  std::string &out_;
+  std::unordered_set<std::string_view> bareNames_;
+  uint32_t counter_ = 0;
+};
+
+// aux == 0 selects the bare hint; otherwise the name is "<hint>.<aux - 1>".
+void FunctionPrinter::assignName(Value *v) {
+  uint32_t n = counter_++;
+  std::string_view hint = v->getName();
+  if (!hint.empty() && hint.size() <= kMaxHintLength &&
+      bareNames_.insert(hint).second)
+    v->aux = 0;
+  else
+    v->aux = n + 1;
+}
+
+void FunctionPrinter::printName(const Value *v) {
+  switch (v->getKind()) {
+  case Value::Kind::Function:
+  case Value::Kind::GlobalVariable:
+    out_ += '@';
+    out_ += v->getName();
+    return;
+  default:
+    break;
+  }
+  out_ += '%';
+  printLocalName(v);
+}
+
+void FunctionPrinter::printLocalName(const Value *v) {
+  std::string_view hint = v->getName();
+  if (v->aux == 0) {
+    out_ += hint;
+    return;
+  }
+  out_ += hint.empty() ? "t" : hint.substr(0, kMaxHintLength);
+  out_ += '.';
+  appendInt(out_, v->aux - 1);
+}
+
+void FunctionPrinter::printOperand(const Value *v, bool withType) {
+  if (withType) {
+    v->getType()->print(out_);
+    out_ += ' ';
+  }
+  if (auto *c = dyn_cast<ConstantInt>(v)) {
+    if (c->getType()->isIntegerTy(1))
+      out_ += c->getValue() ? "true" : "false";
+    else
+      appendInt(out_, c->getValue());
+    return;
+  }
+  if (isa<UndefValue>(v)) {
+    out_ += "undef";
+    return;
+  }
+  printName(v);
+}
+
+void FunctionPrinter::print() {
+  for (unsigned i = 0; i < f_.getNumArgs(); ++i)
+    assignName(f_.getArg(i));
+  for (BasicBlock *bb : f_) {
+    assignName(bb);
+    for (Instruction *inst : *bb)
+      if (!inst->getType()->isVoidTy())
+        assignName(inst);
+  }
+
+  out_ += "define ";
+  f_.getReturnType()->print(out_);
+  out_ += " @";
+  out_ += f_.getName();
+  out_ += '(';
+  for (unsigned i = 0; i < f_.getNumArgs(); ++i) {
+    if (i)
+      out_ += ", ";
+    printOperand(f_.getArg(i));
+  }
+  out_ += ") {\n";
+  for (BasicBlock *bb : f_) {
+    if (bb != f_.getEntryBlock())
+      out_ += '\n';
+    printLocalName(bb);
+    out_ += ":\n";
+    for (Instruction *inst : *bb)
+      printInstruction(inst);
+  }
+  out_ += "}\n";
+}
+
+void FunctionPrinter::printInstruction(const Instruction *inst) {
+  out_ += "  ";
+  if (!inst->getType()->isVoidTy()) {
+    printName(inst);
+    out_ += " = ";
+  }
+  switch (inst->getKind()) {
+  case Value::Kind::Alloca:
+    out_ += "alloca ";
+    cast<AllocaInst>(inst)->getAllocatedType()->print(out_);
+    break;
+  case Value::Kind::Load:
+    out_ += "load ";
+    inst->getType()->print(out_);
+    out_ += ", ";
+    printOperand(inst->getOperand(0));
+    break;
+  case Value::Kind::Store:
+    out_ += "store ";
+    printOperand(inst->getOperand(0));
+    out_ += ", ";
+    printOperand(inst->getOperand(1));
+    break;
+  case Value::Kind::GEP: {
+    auto *gep = cast<GetElementPtrInst>(inst);
+    out_ += "getelementptr ";
+    gep->getSourceElementType()->print(out_);
+    for (unsigned i = 0; i < gep->getNumOperands(); ++i) {
+      out_ += ", ";
+      printOperand(gep->getOperand(i));
+    }
+    break;
+  }
+  case Value::Kind::Binary:
+    out_ += BinaryInst::getOpcodeName(cast<BinaryInst>(inst)->getOpcode());
+    out_ += ' ';
+    printOperand(inst->getOperand(0));
+    out_ += ", ";
+    printOperand(inst->getOperand(1), false);
+    break;
+  case Value::Kind::ICmp:
+    out_ += "icmp ";
+    out_ += ICmpInst::getPredicateName(cast<ICmpInst>(inst)->getPredicate());
+    out_ += ' ';
+    printOperand(inst->getOperand(0));
+    out_ += ", ";
+    printOperand(inst->getOperand(1), false);
+    break;
+  case Value::Kind::Cast:
+    out_ += cast<CastInst>(inst)->getOpcode() == CastInst::ZExt ? "zext "
+                                                                : "bitcast ";
+    printOperand(inst->getOperand(0));
+    out_ += " to ";
+    inst->getType()->print(out_);
+    break;
+  case Value::Kind::Phi: {
+    auto *phi = cast<PhiInst>(inst);
+    out_ += "phi ";
+    phi->getType()->print(out_);
+    for (unsigned i = 0; i < phi->getNumIncoming(); ++i) {
+      out_ += i ? ", [ " : " [ ";
+      printOperand(phi->getIncomingValue(i), false);
+      out_ += ", ";
+      printName(phi->getIncomingBlock(i));
+      out_ += " ]";
+    }
+    break;
+  }
+  case Value::Kind::Call: {
+    auto *call = cast<CallInst>(inst);
+    out_ += "call ";
+    call->getType()->print(out_);
+    out_ += ' ';
+    printName(call->getCallee());
+    out_ += '(';
+    for (unsigned i = 0; i < call->getNumArgs(); ++i) {
+      if (i)
+        out_ += ", ";
+      printOperand(call->getArg(i));
+    }
+    out_ += ')';
+    break;
+  }
+  case Value::Kind::Br: {
+    auto *br = cast<BranchInst>(inst);
+    out_ += "br ";
+    if (br->isConditional()) {
+      printOperand(br->getCondition());
+      out_ += ", ";
+    }
+    for (unsigned i = 0; i < br->getNumSuccessors(); ++i) {
+      if (i)
+        out_ += ", ";
+      out_ += "label ";
+      printName(br->getSuccessor(i));
+    }
+    break;
+  }
+  case Value::Kind::Ret:
+    out_ += "ret ";
+    if (Value *v = cast<RetInst>(inst)->getReturnValue())
+      printOperand(v);
+    else
+      out_ += "void";
+    break;
+  default:
+    break;
+  }
+  out_ += '\n';
+}
+
+bool isZeroRange(const GlobalVariable *g, size_t begin, size_t count) {
+  ArrayRef<int32_t> init = g->getInitializer();
+  for (size_t i = begin; i < begin + count && i < init.size(); ++i)
+    if (init[i] != 0)
+      return false;
+  return true;
+}
+
+size_t scalarCount(Type *t) {
+  if (auto *a = dyn_cast<ArrayType>(t))
+    return a->getNumElements() * scalarCount(a->getElementType());
+  return 1;
+}
+
+void printInitializer(const GlobalVariable *g, Type *t, size_t &offset,
+                      std::string &out) {
+  auto *a = dyn_cast<ArrayType>(t);
+  if (!a) {
+    appendInt(out, g->getInitialElement(offset++));
+    return;
+  }
+  size_t count = scalarCount(t);
+  if (isZeroRange(g, offset, count)) {
+    out += "zeroinitializer";
+    offset += count;
+    return;
+  }
+  out += '[';
+  for (uint32_t i = 0; i < a->getNumElements(); ++i) {
+    if (i)
+      out += ", ";
+    a->getElementType()->print(out);
+    out += ' ';
+    printInitializer(g, a->getElementType(), offset, out);
+  }
+  out += ']';
+}
+
+void printGlobal(const GlobalVariable *g, std::string &out) {
+  out += '@';
+  out += g->getName();
+  out += " = ";
+  if (g->isPrivate())
+    out += "private unnamed_addr ";
+  out += g->isConstant() ? "constant " : "global ";
+  g->getValueType()->print(out);
+  out += ' ';
+  size_t offset = 0;
+  printInitializer(g, g->getValueType(), offset, out);
+  out += '\n';
+}
+
+void printDeclaration(const Function &f, std::string &out) {
+  out += "declare ";
+  f.getReturnType()->print(out);
+  out += " @";
+  out += f.getName();
+  out += '(';
+  for (unsigned i = 0; i < f.getNumArgs(); ++i) {
+    if (i)
+      out += ", ";
+    f.getArg(i)->getType()->print(out);
+  }
+  out += ")\n";
+}
+
+} // namespace
+
+void printFunction(const Function &f, std::string &out) {
+  if (f.isDeclaration())
+    printDeclaration(f, out);
+  else
+    FunctionPrinter(f, out).print();
+}
+
+namespace {
+
+// Prints the globals and the function declarations.
+void printModuleHeader(const Module &m, std::string &out) {
+  for (const GlobalVariable *g : m.globals())
+    printGlobal(g, out);
+  if (!m.globals().empty())
+    out += '\n';
+
+  bool anyDeclaration = false;
+  for (const auto &f : m.functions()) {
+    if (f->isDeclaration()) {
+      printDeclaration(*f, out);
+      anyDeclaration = true;
+    }
+  }
+  if (anyDeclaration)
+    out += '\n';
+}
+
+void appendBodies(const std::vector<std::string> &bodies, std::string &out) {
+  for (size_t i = 0; i < bodies.size(); ++i) {
+    if (i)
+      out += '\n';
+    out += bodies[i];
+  }
+}
+
+} // namespace
+
+void printModule(const Module &m, std::string &out, ThreadPool *pool) {
+  printModuleHeader(m, out);
+  std::vector<const Function *> definitions;
+  for (const auto &f : m.functions())
+    if (!f->isDeclaration())
+      definitions.push_back(f.get());
+  if (!pool) {
+    for (size_t i = 0; i < definitions.size(); ++i) {
+      if (i)
+        out += '\n';
+      FunctionPrinter(*definitions[i], out).print();
+    }
+    return;
+  }
+  std::vector<std::string> bodies(definitions.size());
+  pool->parallelFor(definitions.size(), [&](size_t i) {
+    FunctionPrinter(*definitions[i], bodies[i]).print();
+  });
+  appendBodies(bodies, out);
+}
+
+void printModule(const Module &m, const std::vector<std::string> &bodies,
+                 std::string &out) {
+  printModuleHeader(m, out);
+  appendBodies(bodies, out);
+}
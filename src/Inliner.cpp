@@ -0,0 +1,163 @@
+#include "CallGraph.h"
+#include "Passes.h"
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Callees up to this many instructions (after the credits below) are
+// inlined everywhere.
+constexpr int kInlineThreshold = 60;
+// A function with a single call site disappears once inlined, so only
+// the growth of its caller limits it.
+constexpr int kSingleCallSiteThreshold = 1000;
+// Callers stop growing at this size.
+constexpr unsigned kMaxCallerSize = 5000;
+// Credit for each constant argument, which usually lets part of the body
+// fold away.
+constexpr int kConstantArgBonus = 5;
+
+bool shouldInline(const CallInst *call) {
+  Function *caller = call->getFunction();
+  Function *callee = call->getCallee();
+  unsigned size = callee->getInstructionCount();
+  if (caller->getInstructionCount() + size > kMaxCallerSize)
+    return false;
+  // The call itself, its arguments and the return go away.
+  int cost = static_cast<int>(size - call->getNumArgs()) - 2;
+  for (unsigned i = 0; i < call->getNumArgs(); ++i)
+    if (isa<ConstantInt>(call->getArg(i)))
+      cost -= kConstantArgBonus;
+  int threshold =
+      callee->hasOneUse() ? kSingleCallSiteThreshold : kInlineThreshold;
+  return cost <= threshold;
+}
+
+// Replaces `call` with a copy of the callee's body. The caller's block is
+// split after the call; the copied returns branch to the second half, where
+// a phi merges the returned values. Allocas are moved to the caller's entry
+// block so that inlining into a loop does not grow the stack.
+class InlinedCall {
+public:
+  explicit InlinedCall(CallInst *call)
+      : call_(call), caller_(*call->getFunction()),
+        callee_(*call->getCallee()) {}
+
+  void run();
+
+private:
+  // Maps a value of the callee to the caller. Constants are uniqued per
+  // function, so they are looked up again in the caller.
+  Value *remap(Value *v) {
+    auto it = map_.find(v);
+    if (it != map_.end())
+      return it->second;
+    if (auto *c = dyn_cast<ConstantInt>(v))
+      return caller_.getConstantInt(cast<IntegerType>(c->getType()),
+                                    c->getValue());
+    if (isa<UndefValue>(v))
+      return caller_.getUndef(v->getType());
+    return v;
+  }
+
+  CallInst *call_;
+  Function &caller_;
+  Function &callee_;
+  std::unordered_map<Value *, Value *> map_;
+};
+
+void InlinedCall::run() {
+  Arena &arena = caller_.getArena();
+  BasicBlock *bb = call_->getParent();
+  BasicBlock *cont = bb->splitAt(call_->getNextNode(), "inline.cont");
+  for (unsigned i = 0; i < call_->getNumArgs(); ++i)
+    map_[callee_.getArg(i)] = call_->getArg(i);
+
+  // Names live in the callee's arena, which may go away; copy them.
+  for (BasicBlock *cb : callee_)
+    map_[cb] = caller_.createBlock(arena.copyString(cb->getName()), cont);
+  BasicBlock *entry = caller_.getEntryBlock();
+  std::vector<Instruction *> clones;
+  std::vector<std::pair<RetInst *, BasicBlock *>> returns;
+  for (BasicBlock *cb : callee_) {
+    auto *copy = cast<BasicBlock>(map_[cb]);
+    for (Instruction *inst : *cb) {
+      if (auto *ret = dyn_cast<RetInst>(inst)) {
+        returns.emplace_back(ret, copy);
+        continue;
+      }
+      Instruction *clone = inst->clone(arena);
+      clone->setName(arena.copyString(inst->getName()));
+      if (isa<AllocaInst>(clone))
+        entry->push_front(clone);
+      else
+        copy->push_back(clone);
+      map_[inst] = clone;
+      clones.push_back(clone);
+    }
+  }
+  for (Instruction *clone : clones) {
+    for (Use *u = clone->op_begin(); u != clone->op_end(); ++u)
+      u->set(remap(u->get()));
+    auto *phi = dyn_cast<PhiInst>(clone);
+    for (unsigned i = 0; phi && i < phi->getNumIncoming(); ++i)
+      phi->setIncomingBlock(i,
+                            cast<BasicBlock>(map_[phi->getIncomingBlock(i)]));
+  }
+
+  Value *result = nullptr;
+  if (!call_->getType()->isVoidTy()) {
+    if (returns.size() == 1) {
+      result = remap(returns[0].first->getReturnValue());
+    } else if (returns.empty()) {
+      result = caller_.getUndef(call_->getType());
+    } else {
+      auto *phi =
+          arena.create<PhiInst>(arena, call_->getType(), returns.size());
+      phi->setName(arena.copyString(callee_.getName()));
+      for (auto &[ret, from] : returns)
+        phi->addIncoming(arena, remap(ret->getReturnValue()), from);
+      cont->push_front(phi);
+      result = phi;
+    }
+    call_->replaceAllUsesWith(result);
+  }
+  for (auto &[ret, from] : returns)
+    from->push_back(arena.create<BranchInst>(arena, cont));
+  call_->eraseFromParent();
+  auto *body = cast<BasicBlock>(map_[callee_.getEntryBlock()]);
+  bb->push_back(arena.create<BranchInst>(arena, body));
+}
+
+} // namespace
+
+bool runInliner(Module &m) {
+  CallGraph cg(m);
+  bool changed = false;
+  // Bottom-up, so a callee has already had its own calls inlined when the
+  // decision about it is made.
+  for (const auto &scc : cg.getSCCsBottomUp()) {
+    for (Function *f : scc) {
+      for (CallInst *call : cg.getCallSites(f)) {
+        Function *callee = call->getCallee();
+        // Declarations are the sylib runtime and intrinsics, which have no
+        // body to inline.
+        if (callee->isDeclaration() || cg.isRecursive(callee) ||
+            !shouldInline(call))
+          continue;
+        InlinedCall(call).run();
+        changed = true;
+      }
+    }
+  }
+
+  std::vector<Function *> dead;
+  for (const auto &f : m.functions())
+    if (!f->isDeclaration() && !f->hasUses() && f->getName() != "main")
+      dead.push_back(f.get());
+  for (Function *f : dead)
+    m.eraseFunction(f);
+  return changed || !dead.empty();
+}
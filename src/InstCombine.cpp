@@ -0,0 +1,435 @@
+#include "IRBuilder.h"
+#include "Passes.h"
+#include "TransformUtils.h"
+
+#include <climits>
+#include <utility>
+
+namespace {
+
+bool isPowerOf2(int32_t v) { return v > 0 && (v & (v - 1)) == 0; }
+
+unsigned log2(int32_t v) {
+  unsigned k = 0;
+  while ((1 << k) != v)
+    ++k;
+  return k;
+}
+
+ConstantInt *getConstant(Value *v) { return dyn_cast<ConstantInt>(v); }
+
+bool isConstantValue(Value *v, int32_t c) {
+  auto *ci = getConstant(v);
+  return ci && ci->getValue() == c;
+}
+
+// `sub 0, x`
+Value *matchNeg(Value *v) {
+  auto *bi = dyn_cast<BinaryInst>(v);
+  if (bi && bi->getOpcode() == BinaryInst::Sub && isConstantValue(bi->getLHS(), 0))
+    return bi->getRHS();
+  return nullptr;
+}
+
+// `zext i1 b`
+Value *matchZExtBool(Value *v) {
+  auto *ci = dyn_cast<CastInst>(v);
+  if (ci && ci->getOpcode() == CastInst::ZExt &&
+      ci->getOperand(0)->getType()->isIntegerTy(1))
+    return ci->getOperand(0);
+  return nullptr;
+}
+
+bool isKnownNonNegative(Value *v) {
+  if (auto *c = getConstant(v))
+    return c->getValue() >= 0;
+  if (matchZExtBool(v))
+    return true;
+  if (auto *bi = dyn_cast<BinaryInst>(v)) {
+    switch (bi->getOpcode()) {
+    case BinaryInst::LShr:
+      return !isConstantValue(bi->getRHS(), 0);
+    case BinaryInst::And:
+      return isKnownNonNegative(bi->getLHS()) ||
+             isKnownNonNegative(bi->getRHS());
+    case BinaryInst::SRem:
+    case BinaryInst::SDiv:
+    case BinaryInst::AShr:
+      return isKnownNonNegative(bi->getLHS()) &&
+             isKnownNonNegative(bi->getRHS());
+    default:
+      break;
+    }
+  }
+  return false;
+}
+
+// Peephole simplification and canonicalization over a worklist, in the
+// spirit of LLVM's InstCombine. Each visit either returns a value that
+// replaces the instruction, returns the instruction itself after changing it
+// in place, or returns null.
+class InstCombiner {
+public:
+  explicit InstCombiner(Function &f) : f_(f), builder_(&f) {}
+
+  bool run();
+
+private:
+  void push(Value *v) {
+    auto *inst = dyn_cast<Instruction>(v);
+    if (inst && !inst->aux) {
+      inst->aux = 1;
+      work_.push_back(inst);
+    }
+  }
+  void pushUsers(Value *v) {
+    for (Use *u = v->getFirstUse(); u; u = u->getNext())
+      push(u->getUser());
+  }
+  Value *emit(BinaryInst::Opcode op, Value *lhs, Value *rhs) {
+    Value *v = builder_.createBinary(op, lhs, rhs);
+    push(v);
+    return v;
+  }
+  ConstantInt *getInt(Type *t, int32_t v) {
+    return f_.getConstantInt(cast<IntegerType>(t), v);
+  }
+
+  Value *visit(Instruction *inst);
+  Value *visitBinary(BinaryInst *bi);
+  Value *visitAdd(BinaryInst *bi, Value *l, Value *r, ConstantInt *cr);
+  Value *visitSub(BinaryInst *bi, Value *l, Value *r, ConstantInt *cr);
+  Value *visitMul(BinaryInst *bi, Value *l, ConstantInt *cr);
+  Value *visitDivRem(BinaryInst *bi, Value *l, ConstantInt *cr);
+  Value *visitICmp(ICmpInst *ci);
+  Value *visitPhi(PhiInst *phi);
+
+  Function &f_;
+  IRBuilder builder_;
+  std::vector<Instruction *> work_;
+};
+
+bool InstCombiner::run() {
+  for (BasicBlock *bb : f_)
+    for (Instruction *inst : *bb)
+      inst->aux = 0;
+  // Seed in reverse so that instructions are popped in program order.
+  for (BasicBlock *bb = f_.back(); bb; bb = bb->getPrevNode())
+    for (Instruction *inst = bb->back(); inst; inst = inst->getPrevNode())
+      push(inst);
+
+  bool changed = false;
+  while (!work_.empty()) {
+    Instruction *inst = work_.back();
+    work_.pop_back();
+    inst->aux = 0;
+    if (!inst->getParent())
+      continue;
+
+    if (isInstructionTriviallyDead(inst)) {
+      for (Use *u = inst->op_begin(); u != inst->op_end(); ++u)
+        push(u->get());
+      inst->eraseFromParent();
+      changed = true;
+      continue;
+    }
+
+    builder_.setInsertPoint(inst);
+    Value *v = visit(inst);
+    if (!v)
+      continue;
+    changed = true;
+    if (v == inst) {
+      push(inst);
+      pushUsers(inst);
+      continue;
+    }
+    pushUsers(inst);
+    inst->replaceAllUsesWith(v);
+    push(v);
+    for (Use *u = inst->op_begin(); u != inst->op_end(); ++u)
+      push(u->get());
+    inst->eraseFromParent();
+  }
+  return changed;
+}
+
+Value *InstCombiner::visit(Instruction *inst) {
+  switch (inst->getKind()) {
+  case Value::Kind::Binary:
+    return visitBinary(cast<BinaryInst>(inst));
+  case Value::Kind::ICmp:
+    return visitICmp(cast<ICmpInst>(inst));
+  case Value::Kind::Cast:
+    if (auto *c = getConstant(inst->getOperand(0)))
+      if (cast<CastInst>(inst)->getOpcode() == CastInst::ZExt)
+        return getInt(inst->getType(), c->getValue());
+    return nullptr;
+  case Value::Kind::Phi:
+    return visitPhi(cast<PhiInst>(inst));
+  default:
+    return nullptr;
+  }
+}
+
+Value *InstCombiner::visitBinary(BinaryInst *bi) {
+  Value *l = bi->getLHS();
+  Value *r = bi->getRHS();
+  ConstantInt *cl = getConstant(l);
+  ConstantInt *cr = getConstant(r);
+  if (cl && cr) {
+    int32_t folded;
+    if (BinaryInst::fold(bi->getOpcode(), cl->getValue(), cr->getValue(),
+                         folded))
+      return getInt(bi->getType(), folded);
+    return nullptr;
+  }
+
+  // Constants go on the right of commutative operations.
+  bool swapped = false;
+  if (cl && bi->isCommutative()) {
+    bi->setOperand(0, r);
+    bi->setOperand(1, l);
+    std::swap(l, r);
+    std::swap(cl, cr);
+    swapped = true;
+  }
+
+  Value *result = nullptr;
+  switch (bi->getOpcode()) {
+  case BinaryInst::Add:
+    result = visitAdd(bi, l, r, cr);
+    break;
+  case BinaryInst::Sub:
+    result = visitSub(bi, l, r, cr);
+    break;
+  case BinaryInst::Mul:
+    result = visitMul(bi, l, cr);
+    break;
+  case BinaryInst::SDiv:
+  case BinaryInst::SRem:
+    if (cl && cl->isZero())
+      result = cl;
+    else
+      result = visitDivRem(bi, l, cr);
+    break;
+  case BinaryInst::Shl:
+  case BinaryInst::AShr:
+  case BinaryInst::LShr:
+    if (cr && cr->isZero())
+      result = l;
+    else if (cl && cl->isZero())
+      result = cl;
+    break;
+  case BinaryInst::And:
+    if (cr && cr->isZero())
+      result = cr;
+    else if ((cr && cr->getValue() == -1) || l == r)
+      result = l;
+    break;
+  case BinaryInst::Or:
+    if ((cr && cr->isZero()) || l == r)
+      result = l;
+    else if (cr && cr->getValue() == -1)
+      result = cr;
+    break;
+  case BinaryInst::Xor:
+    if (cr && cr->isZero())
+      result = l;
+    else if (l == r)
+      result = getInt(bi->getType(), 0);
+    break;
+  }
+  if (result)
+    return result;
+  return swapped ? bi : nullptr;
+}
+
+Value *InstCombiner::visitAdd(BinaryInst *bi, Value *l, Value *r,
+                              ConstantInt *cr) {
+  if (cr) {
+    if (cr->isZero())
+      return l;
+    // (x + c1) + c2  ->  x + (c1 + c2)
+    auto *inner = dyn_cast<BinaryInst>(l);
+    if (inner && inner->getOpcode() == BinaryInst::Add)
+      if (auto *c1 = getConstant(inner->getRHS()))
+        return emit(BinaryInst::Add, inner->getLHS(),
+                    getInt(bi->getType(), static_cast<int32_t>(
+                                              static_cast<uint32_t>(c1->getValue()) +
+                                              static_cast<uint32_t>(cr->getValue()))));
+    return nullptr;
+  }
+  // x + (0 - y)  ->  x - y
+  if (Value *y = matchNeg(r))
+    return emit(BinaryInst::Sub, l, y);
+  if (Value *y = matchNeg(l))
+    return emit(BinaryInst::Sub, r, y);
+  // x + x  ->  x << 1
+  if (l == r)
+    return emit(BinaryInst::Shl, l, getInt(bi->getType(), 1));
+  return nullptr;
+}
+
+Value *InstCombiner::visitSub(BinaryInst *bi, Value *l, Value *r,
+                              ConstantInt *cr) {
+  if (l == r)
+    return getInt(bi->getType(), 0);
+  if (cr) {
+    if (cr->isZero())
+      return l;
+    // x - c  ->  x + (-c), so that constant chains fold in visitAdd.
+    if (cr->getValue() != INT_MIN)
+      return emit(BinaryInst::Add, l, getInt(bi->getType(), -cr->getValue()));
+    return nullptr;
+  }
+  // x - (0 - y)  ->  x + y
+  if (Value *y = matchNeg(r))
+    return emit(BinaryInst::Add, l, y);
+  // (x + y) - y  ->  x
+  if (auto *add = dyn_cast<BinaryInst>(l);
+      add && add->getOpcode() == BinaryInst::Add) {
+    if (add->getRHS() == r)
+      return add->getLHS();
+    if (add->getLHS() == r)
+      return add->getRHS();
+  }
+  return nullptr;
+}
+
+Value *InstCombiner::visitMul(BinaryInst *bi, Value *l, ConstantInt *cr) {
+  if (!cr)
+    return nullptr;
+  int32_t c = cr->getValue();
+  if (c == 0)
+    return cr;
+  if (c == 1)
+    return l;
+  if (c == -1)
+    return emit(BinaryInst::Sub, getInt(bi->getType(), 0), l);
+  // (x * c1) * c2  ->  x * (c1 * c2)
+  auto *inner = dyn_cast<BinaryInst>(l);
+  if (inner && inner->getOpcode() == BinaryInst::Mul)
+    if (auto *c1 = getConstant(inner->getRHS()))
+      return emit(BinaryInst::Mul, inner->getLHS(),
+                  getInt(bi->getType(),
+                         static_cast<int32_t>(static_cast<uint32_t>(c1->getValue()) *
+                                              static_cast<uint32_t>(c))));
+  if (isPowerOf2(c))
+    return emit(BinaryInst::Shl, l, getInt(bi->getType(), log2(c)));
+  if (c != INT_MIN && isPowerOf2(-c))
+    return emit(BinaryInst::Sub, getInt(bi->getType(), 0),
+                emit(BinaryInst::Shl, l, getInt(bi->getType(), log2(-c))));
+  return nullptr;
+}
+
+// Signed division and remainder by ±2^k become shifts. For a possibly
+// negative dividend the quotient must round toward zero, so 2^k - 1 is added
+// first when the dividend is negative:
+//   bias = (x >> 31) >>> (32 - k)      (logical shift of the sign mask)
+//   x / 2^k = (x + bias) >> k
+//   x % 2^k = x - ((x + bias) & -2^k)
+Value *InstCombiner::visitDivRem(BinaryInst *bi, Value *l, ConstantInt *cr) {
+  if (!cr)
+    return nullptr;
+  bool isDiv = bi->getOpcode() == BinaryInst::SDiv;
+  int32_t c = cr->getValue();
+  Type *t = bi->getType();
+  if (c == 1 || c == -1) {
+    if (!isDiv)
+      return getInt(t, 0);
+    return c == 1 ? l : emit(BinaryInst::Sub, getInt(t, 0), l);
+  }
+  if (c == INT_MIN || c == 0)
+    return nullptr;
+  int32_t mag = c < 0 ? -c : c;
+  if (!isPowerOf2(mag))
+    return nullptr;
+  unsigned k = log2(mag);
+
+  if (isKnownNonNegative(l)) {
+    if (!isDiv)
+      return emit(BinaryInst::And, l, getInt(t, mag - 1));
+    Value *q = emit(BinaryInst::AShr, l, getInt(t, k));
+    return c < 0 ? emit(BinaryInst::Sub, getInt(t, 0), q) : q;
+  }
+
+  Value *sign = k == 1 ? l : emit(BinaryInst::AShr, l, getInt(t, 31));
+  Value *bias = emit(BinaryInst::LShr, sign, getInt(t, 32 - k));
+  Value *biased = emit(BinaryInst::Add, l, bias);
+  if (isDiv) {
+    Value *q = emit(BinaryInst::AShr, biased, getInt(t, k));
+    return c < 0 ? emit(BinaryInst::Sub, getInt(t, 0), q) : q;
+  }
+  Value *rounded = emit(BinaryInst::And, biased, getInt(t, -mag));
+  return emit(BinaryInst::Sub, l, rounded);
+}
+
+Value *InstCombiner::visitICmp(ICmpInst *ci) {
+  Value *l = ci->getLHS();
+  Value *r = ci->getRHS();
+  ConstantInt *cl = getConstant(l);
+  ConstantInt *cr = getConstant(r);
+  ICmpInst::Predicate pred = ci->getPredicate();
+  if (cl && cr)
+    return f_.getInt1(ICmpInst::fold(pred, cl->getValue(), cr->getValue()));
+  if (l == r)
+    return f_.getInt1(pred == ICmpInst::EQ || pred == ICmpInst::SLE ||
+                      pred == ICmpInst::SGE);
+
+  if (cl) {
+    ci->setOperand(0, r);
+    ci->setOperand(1, l);
+    ci->setPredicate(ICmpInst::getSwappedPredicate(pred));
+    return ci;
+  }
+  if (!cr)
+    return nullptr;
+
+  // Comparing a zero-extended boolean with a constant tests the boolean.
+  if (Value *b = matchZExtBool(l)) {
+    bool ifFalse = ICmpInst::fold(pred, 0, cr->getValue());
+    bool ifTrue = ICmpInst::fold(pred, 1, cr->getValue());
+    if (ifFalse == ifTrue)
+      return f_.getInt1(ifTrue);
+    if (ifTrue)
+      return b;
+    if (auto *inner = dyn_cast<ICmpInst>(b)) {
+      Value *v = builder_.createICmp(
+          ICmpInst::getInversePredicate(inner->getPredicate()),
+          inner->getLHS(), inner->getRHS());
+      push(v);
+      return v;
+    }
+    return emit(BinaryInst::Xor, b, f_.getInt1(true));
+  }
+
+  // Equality tests can move constants and subtractions across.
+  if (pred == ICmpInst::EQ || pred == ICmpInst::NE) {
+    auto *bi = dyn_cast<BinaryInst>(l);
+    if (bi && bi->getOpcode() == BinaryInst::Add)
+      if (auto *c1 = getConstant(bi->getRHS())) {
+        ci->setOperand(0, bi->getLHS());
+        ci->setOperand(1, getInt(r->getType(),
+                                 static_cast<int32_t>(
+                                     static_cast<uint32_t>(cr->getValue()) -
+                                     static_cast<uint32_t>(c1->getValue()))));
+        return ci;
+      }
+    if (bi && bi->getOpcode() == BinaryInst::Sub && cr->isZero()) {
+      ci->setOperand(0, bi->getLHS());
+      ci->setOperand(1, bi->getRHS());
+      return ci;
+    }
+  }
+  return nullptr;
+}
+
+Value *InstCombiner::visitPhi(PhiInst *phi) {
+  Value *v = phi->hasConstantValue();
+  return v && v != phi ? v : nullptr;
+}
+
+} // namespace
+
+bool runInstCombine(Function &f) { return InstCombiner(f).run(); }
@@ -0,0 +1,623 @@
+#include "LoopInfo.h"
+#include "MachineIR.h"
+
+#include <algorithm>
+
+namespace {
+
+unsigned sizeOf(const Type *t) { return t->isPointerTy() ? 8 : 4; }
+
+CondCode getCondCode(ICmpInst::Predicate p) {
+  switch (p) {
+  case ICmpInst::EQ:
+    return CondCode::E;
+  case ICmpInst::NE:
+    return CondCode::NE;
+  case ICmpInst::SLT:
+    return CondCode::L;
+  case ICmpInst::SGT:
+    return CondCode::G;
+  case ICmpInst::SLE:
+    return CondCode::LE;
+  default:
+    return CondCode::GE;
+  }
+}
+
+bool isPowerOf2(uint32_t v) { return v && (v & (v - 1)) == 0; }
+
+unsigned log2Ceil(uint32_t v) {
+  unsigned l = 0;
+  while ((uint64_t(1) << l) < v)
+    ++l;
+  return l;
+}
+
+// Pointers that are a fixed offset from a frame object or a global. They
+// never get a register of their own: loads and stores address them
+// directly, and other uses recompute them with a lea.
+bool isConstantAddress(const Value *v) {
+  if (isa<AllocaInst>(v) || isa<GlobalVariable>(v))
+    return true;
+  if (auto *cast = dyn_cast<CastInst>(v))
+    return isConstantAddress(cast->getOperand(0));
+  auto *gep = dyn_cast<GetElementPtrInst>(v);
+  if (!gep || !isConstantAddress(gep->getPointerOperand()))
+    return false;
+  for (unsigned i = 0; i < gep->getNumIndices(); ++i)
+    if (!isa<ConstantInt>(gep->getIndex(i)))
+      return false;
+  return true;
+}
+
+// Whether the address `gep` computes is folded into the addressing mode of
+// its user. Besides constant addresses, these are GEPs whose only use is as
+// the address of a load, store or GEP in the same block.
+bool isFoldedGEP(const GetElementPtrInst *gep) {
+  if (isConstantAddress(gep))
+    return true;
+  if (!gep->hasOneUse())
+    return false;
+  auto *user = cast<Instruction>(gep->getFirstUse()->getUser());
+  if (user->getParent() != gep->getParent())
+    return false;
+  if (isa<LoadInst>(user) || isa<GetElementPtrInst>(user))
+    return user->getOperand(0) == gep;
+  return isa<StoreInst>(user) && user->getOperand(1) == gep &&
+         user->getOperand(0) != gep;
+}
+
+// A compare whose only use is the branch at the end of its block is
+// emitted right before the jump, which then tests the flags directly.
+bool isFoldedCompare(const ICmpInst *cmp) {
+  if (!cmp->hasOneUse())
+    return false;
+  auto *user = cast<Instruction>(cmp->getFirstUse()->getUser());
+  return isa<BranchInst>(user) && user->getParent() == cmp->getParent();
+}
+
+class InstructionSelector {
+public:
+  InstructionSelector(Function &f, MFunction &mf) : f_(f), mf_(mf) {}
+
+  void run();
+
+private:
+  void emit(const MInst &inst) { cur_->push_back(inst); }
+  void emitMov(unsigned size, MOperand src, MOperand dst) {
+    emit(MInst(MOpcode::Mov, size, src, dst));
+  }
+
+  // The virtual register holding the result of an instruction or argument.
+  Reg vregFor(Value *v);
+  // `v` as an immediate or a register.
+  MOperand operand(Value *v);
+  // `v` in a register.
+  Reg reg(Value *v);
+  // A memory operand addressing what `ptr` points to.
+  MOperand address(Value *ptr);
+  MOperand gepAddress(GetElementPtrInst *gep);
+  void addIndex(MOperand &addr, Value *index, uint64_t scale);
+  // A register holding the address of `addr`.
+  Reg materialize(const MOperand &addr);
+
+  void selectInstruction(Instruction *inst);
+  void selectBinary(BinaryInst *bin);
+  bool selectDivByConstant(BinaryInst *bin, int32_t divisor);
+  CondCode emitCompare(ICmpInst *cmp);
+  void selectCall(CallInst *call);
+  void selectBranch(BranchInst *br);
+  // The block to jump to for the edge from `from` to `to`. Edges into
+  // blocks with phis get a block of their own for the phi copies, since
+  // the copies cannot go into `from` if it has other successors.
+  MBlock *edgeTarget(BasicBlock *from, BasicBlock *to);
+  void emitPhiCopies(BasicBlock *from, BasicBlock *to);
+
+  Function &f_;
+  MFunction &mf_;
+  // Indexed by IR block number.
+  std::vector<MBlock *> blocks_;
+  MBlock *cur_ = nullptr;
+  // Blocks created for edges of the current block; they are laid out right
+  // after it.
+  std::vector<MBlock *> edgeBlocks_;
+};
+
+Reg InstructionSelector::vregFor(Value *v) {
+  if (!v->aux)
+    v->aux = mf_.createVReg();
+  return v->aux;
+}
+
+MOperand InstructionSelector::operand(Value *v) {
+  if (auto *c = dyn_cast<ConstantInt>(v))
+    return MOperand::makeImm(c->getValue());
+  if (isa<UndefValue>(v))
+    return MOperand::makeImm(0);
+  bool isAddress = isa<GlobalVariable>(v) || isa<AllocaInst>(v) ||
+                   (isa<CastInst>(v) && v->getType()->isPointerTy()) ||
+                   (isa<GetElementPtrInst>(v) &&
+                    isFoldedGEP(cast<GetElementPtrInst>(v)));
+  if (isAddress)
+    return MOperand::makeReg(materialize(address(v)));
+  return MOperand::makeReg(vregFor(v));
+}
+
+Reg InstructionSelector::reg(Value *v) {
+  MOperand op = operand(v);
+  if (op.isReg())
+    return op.reg;
+  Reg r = mf_.createVReg();
+  emitMov(sizeOf(v->getType()), op, MOperand::makeReg(r));
+  return r;
+}
+
+MOperand InstructionSelector::address(Value *ptr) {
+  if (isa<AllocaInst>(ptr))
+    return MOperand::makeFrame(ptr->aux - 1);
+  if (isa<GlobalVariable>(ptr))
+    return MOperand::makeGlobal(ptr->getName());
+  if (auto *cast = dyn_cast<CastInst>(ptr))
+    return address(cast->getOperand(0));
+  auto *gep = dyn_cast<GetElementPtrInst>(ptr);
+  if (gep && isFoldedGEP(gep))
+    return gepAddress(gep);
+  return MOperand::makeMem(reg(ptr));
+}
+
+MOperand InstructionSelector::gepAddress(GetElementPtrInst *gep) {
+  MOperand addr = address(gep->getPointerOperand());
+  Type *t = gep->getSourceElementType();
+  for (unsigned i = 0; i < gep->getNumIndices(); ++i) {
+    if (i)
+      t = cast<ArrayType>(t)->getElementType();
+    uint64_t size = t->getSizeInBytes();
+    if (auto *c = dyn_cast<ConstantInt>(gep->getIndex(i)))
+      addr.imm += int64_t(c->getValue()) * int64_t(size);
+    else
+      addIndex(addr, gep->getIndex(i), size);
+  }
+  return addr;
+}
+
+void InstructionSelector::addIndex(MOperand &addr, Value *index,
+                                   uint64_t scale) {
+  Reg x = mf_.createVReg();
+  emit(MInst(MOpcode::Movsx, 8, MOperand::makeReg(reg(index)),
+             MOperand::makeReg(x)));
+  if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+    Reg scaled = mf_.createVReg();
+    MInst mul(MOpcode::Imul3, 8, MOperand::makeReg(x),
+              MOperand::makeReg(scaled));
+    mul.ops[2] = MOperand::makeImm(scale);
+    emit(mul);
+    x = scaled;
+    scale = 1;
+  }
+  // %rip-relative addresses take no index, and neither does one that has
+  // one already.
+  if (!addr.symbol.empty() || addr.index != kNoReg)
+    addr = MOperand::makeMem(materialize(addr));
+  addr.index = x;
+  addr.scale = scale;
+}
+
+Reg InstructionSelector::materialize(const MOperand &addr) {
+  if (addr.reg != kNoReg && addr.index == kNoReg && addr.imm == 0)
+    return addr.reg;
+  Reg r = mf_.createVReg();
+  emit(MInst(MOpcode::Lea, 8, addr, MOperand::makeReg(r)));
+  return r;
+}
+
+void InstructionSelector::run() {
+  f_.renumberBlocks();
+  DominatorTree dt(f_);
+  LoopInfo li(dt);
+
+  for (unsigned i = 0; i < f_.getNumArgs(); ++i)
+    f_.getArg(i)->aux = 0;
+  for (BasicBlock *bb : f_) {
+    MBlock *mbb = mf_.createBlock();
+    mbb->loopDepth = li.getLoopDepth(bb);
+    blocks_.push_back(mbb);
+    for (Instruction *inst : *bb) {
+      inst->aux = 0;
+      if (auto *alloca = dyn_cast<AllocaInst>(inst)) {
+        Type *t = alloca->getAllocatedType();
+        inst->aux = mf_.createFrameObject(t->getSizeInBytes(),
+                                          t->isPointerTy() ? 8 : 4) +
+                    1;
+      }
+    }
+  }
+
+  // Copy the arguments out of the argument registers and the caller's
+  // frame. The entry block must not be a branch target for that.
+  std::vector<MBlock *> layout;
+  MBlock *entry = blocks_[0];
+  if (!f_.getEntryBlock()->predecessors().empty()) {
+    entry = mf_.createBlock();
+    entry->push_back(MInst(MOpcode::Jmp, 8, MOperand::makeLabel(blocks_[0])));
+    entry->addSuccessor(blocks_[0]);
+    layout.push_back(entry);
+  }
+  std::vector<MInst> argCopies;
+  for (unsigned i = 0; i < f_.getNumArgs(); ++i) {
+    Argument *arg = f_.getArg(i);
+    if (!arg->hasUses())
+      continue;
+    unsigned size = sizeOf(arg->getType());
+    MOperand src = i < 6 ? MOperand::makeReg(kArgRegs[i])
+                         : MOperand::makeMem(RBP, 16 + 8 * (i - 6));
+    argCopies.push_back(MInst(MOpcode::Mov, size, src,
+                              MOperand::makeReg(vregFor(arg))));
+  }
+  entry->insts().insert(entry->insts().begin(), argCopies.begin(),
+                        argCopies.end());
+
+  for (BasicBlock *bb : f_) {
+    cur_ = blocks_[bb->getNumber()];
+    layout.push_back(cur_);
+    for (Instruction *inst : *bb)
+      selectInstruction(inst);
+    layout.insert(layout.end(), edgeBlocks_.begin(), edgeBlocks_.end());
+    edgeBlocks_.clear();
+  }
+  mf_.setLayout(layout);
+}
+
+void InstructionSelector::selectInstruction(Instruction *inst) {
+  switch (inst->getKind()) {
+  case Value::Kind::Alloca:
+  case Value::Kind::Phi:
+    break;
+  case Value::Kind::Load:
+    if (inst->hasUses())
+      emitMov(sizeOf(inst->getType()), address(inst->getOperand(0)),
+              MOperand::makeReg(vregFor(inst)));
+    break;
+  case Value::Kind::Store: {
+    Value *v = inst->getOperand(0);
+    MOperand src = operand(v);
+    emitMov(sizeOf(v->getType()), src, address(inst->getOperand(1)));
+    break;
+  }
+  case Value::Kind::GEP: {
+    auto *gep = cast<GetElementPtrInst>(inst);
+    if (isFoldedGEP(gep) || !gep->hasUses())
+      break;
+    MOperand addr = gepAddress(gep);
+    if (addr.reg != kNoReg && addr.index == kNoReg && addr.imm == 0)
+      emitMov(8, MOperand::makeReg(addr.reg), MOperand::makeReg(vregFor(gep)));
+    else
+      emit(MInst(MOpcode::Lea, 8, addr, MOperand::makeReg(vregFor(gep))));
+    break;
+  }
+  case Value::Kind::Binary:
+    if (inst->hasUses())
+      selectBinary(cast<BinaryInst>(inst));
+    break;
+  case Value::Kind::ICmp: {
+    auto *cmp = cast<ICmpInst>(inst);
+    if (isFoldedCompare(cmp) || !cmp->hasUses())
+      break;
+    CondCode cc = emitCompare(cmp);
+    Reg byte = mf_.createVReg();
+    MInst set(MOpcode::Setcc, 4, {}, MOperand::makeReg(byte));
+    set.cond = cc;
+    emit(set);
+    emit(MInst(MOpcode::Movzx8, 4, MOperand::makeReg(byte),
+               MOperand::makeReg(vregFor(cmp))));
+    break;
+  }
+  case Value::Kind::Cast:
+    // Booleans are kept zero-extended in 32-bit registers, so zext is a
+    // copy; bitcasts only change the pointer type.
+    if (cast<CastInst>(inst)->getOpcode() == CastInst::ZExt && inst->hasUses())
+      emitMov(4, operand(inst->getOperand(0)),
+              MOperand::makeReg(vregFor(inst)));
+    break;
+  case Value::Kind::Call:
+    selectCall(cast<CallInst>(inst));
+    break;
+  case Value::Kind::Br:
+    selectBranch(cast<BranchInst>(inst));
+    break;
+  case Value::Kind::Ret: {
+    MInst ret(MOpcode::Ret, 8);
+    if (Value *v = cast<RetInst>(inst)->getReturnValue()) {
+      emitMov(sizeOf(v->getType()), operand(v), MOperand::makeReg(RAX));
+      ret.ops[0] = MOperand::makeReg(RAX);
+    }
+    emit(ret);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void InstructionSelector::selectBinary(BinaryInst *bin) {
+  BinaryInst::Opcode op = bin->getOpcode();
+  Value *lhs = bin->getLHS(), *rhs = bin->getRHS();
+  if (bin->isCommutative() && isa<ConstantInt>(lhs) && !isa<ConstantInt>(rhs))
+    std::swap(lhs, rhs);
+  auto *c = dyn_cast<ConstantInt>(rhs);
+  MOperand dst = MOperand::makeReg(vregFor(bin));
+
+  switch (op) {
+  case BinaryInst::SDiv:
+  case BinaryInst::SRem: {
+    if (c && selectDivByConstant(bin, c->getValue()))
+      return;
+    Reg divisor = reg(rhs);
+    emitMov(4, operand(lhs), MOperand::makeReg(RAX));
+    emit(MInst(MOpcode::Cdq, 4));
+    emit(MInst(MOpcode::Idiv, 4, MOperand::makeReg(divisor)));
+    emitMov(4, MOperand::makeReg(op == BinaryInst::SDiv ? RAX : RDX), dst);
+    return;
+  }
+  case BinaryInst::Shl:
+  case BinaryInst::AShr:
+  case BinaryInst::LShr: {
+    MOpcode shift = op == BinaryInst::Shl    ? MOpcode::Shl
+                    : op == BinaryInst::AShr ? MOpcode::Sar
+                                             : MOpcode::Shr;
+    emitMov(4, operand(lhs), dst);
+    if (c) {
+      emit(MInst(shift, 4, MOperand::makeImm(c->getValue() & 31), dst));
+    } else {
+      emitMov(4, operand(rhs), MOperand::makeReg(RCX));
+      emit(MInst(shift, 4, MOperand::makeReg(RCX), dst));
+    }
+    return;
+  }
+  case BinaryInst::Mul:
+    if (c && isPowerOf2(c->getValue())) {
+      emitMov(4, operand(lhs), dst);
+      emit(MInst(MOpcode::Shl, 4,
+                 MOperand::makeImm(log2Ceil(c->getValue())), dst));
+      return;
+    }
+    if (c) {
+      MInst mul(MOpcode::Imul3, 4, MOperand::makeReg(reg(lhs)), dst);
+      mul.ops[2] = MOperand::makeImm(c->getValue());
+      emit(mul);
+      return;
+    }
+    break;
+  default:
+    break;
+  }
+
+  MOpcode opcode = op == BinaryInst::Add   ? MOpcode::Add
+                   : op == BinaryInst::Sub ? MOpcode::Sub
+                   : op == BinaryInst::Mul ? MOpcode::Imul
+                   : op == BinaryInst::And ? MOpcode::And
+                   : op == BinaryInst::Or  ? MOpcode::Or
+                                           : MOpcode::Xor;
+  emitMov(4, operand(lhs), dst);
+  emit(MInst(opcode, 4, operand(rhs), dst));
+}
+
+// Division by a constant without idiv: powers of two become shifts that
+// round towards zero, other divisors a multiplication by a fixed-point
+// reciprocal. With l = ceil(log2 |d|) and m = 2^(31+l) / |d| + 1 (which is
+// below 2^32), (x * m) >> (31 + l) is floor(x / |d|) for x >= 0 and one less
+// than the rounded-towards-zero quotient for x < 0, which subtracting the
+// sign of x corrects.
+bool InstructionSelector::selectDivByConstant(BinaryInst *bin,
+                                              int32_t divisor) {
+  bool isRem = bin->getOpcode() == BinaryInst::SRem;
+  MOperand dst = MOperand::makeReg(vregFor(bin));
+  if (divisor == 1 || divisor == -1) {
+    if (isRem) {
+      emitMov(4, MOperand::makeImm(0), dst);
+      return true;
+    }
+    emitMov(4, operand(bin->getLHS()), dst);
+    if (divisor == -1)
+      emit(MInst(MOpcode::Neg, 4, {}, dst));
+    return true;
+  }
+  if (divisor == INT32_MIN || divisor == 0)
+    return false;
+
+  uint32_t d = divisor < 0 ? -uint32_t(divisor) : uint32_t(divisor);
+  MOperand x = MOperand::makeReg(reg(bin->getLHS()));
+  MOperand q = MOperand::makeReg(mf_.createVReg());
+  if (isPowerOf2(d)) {
+    // q = (x + (x < 0 ? d - 1 : 0)) >> log2(d)
+    unsigned s = log2Ceil(d);
+    emitMov(4, x, q);
+    emit(MInst(MOpcode::Sar, 4, MOperand::makeImm(31), q));
+    emit(MInst(MOpcode::Shr, 4, MOperand::makeImm(32 - s), q));
+    emit(MInst(MOpcode::Add, 4, x, q));
+    if (isRem) {
+      emit(MInst(MOpcode::And, 4, MOperand::makeImm(-int64_t(d)), q));
+      emitMov(4, x, dst);
+      emit(MInst(MOpcode::Sub, 4, q, dst));
+      return true;
+    }
+    emit(MInst(MOpcode::Sar, 4, MOperand::makeImm(s), q));
+  } else {
+    unsigned l = log2Ceil(d);
+    uint64_t m = (uint64_t(1) << (31 + l)) / d + 1;
+    MOperand magic = MOperand::makeReg(mf_.createVReg());
+    MOperand sign = MOperand::makeReg(mf_.createVReg());
+    emit(MInst(MOpcode::Movsx, 8, x, q));
+    // A 32-bit move zero-extends, so it can load m up to 2^32 - 1.
+    emitMov(4, MOperand::makeImm(int64_t(m)), magic);
+    emit(MInst(MOpcode::Imul, 8, magic, q));
+    emit(MInst(MOpcode::Sar, 8, MOperand::makeImm(31 + l), q));
+    emitMov(4, x, sign);
+    emit(MInst(MOpcode::Sar, 4, MOperand::makeImm(31), sign));
+    emit(MInst(MOpcode::Sub, 4, sign, q));
+    if (isRem) {
+      MOperand prod = MOperand::makeReg(mf_.createVReg());
+      MInst mul(MOpcode::Imul3, 4, q, prod);
+      mul.ops[2] = MOperand::makeImm(d);
+      emit(mul);
+      emitMov(4, x, dst);
+      emit(MInst(MOpcode::Sub, 4, prod, dst));
+      return true;
+    }
+  }
+  if (divisor < 0)
+    emit(MInst(MOpcode::Neg, 4, {}, q));
+  emitMov(4, q, dst);
+  return true;
+}
+
+CondCode InstructionSelector::emitCompare(ICmpInst *cmp) {
+  Value *lhs = cmp->getLHS(), *rhs = cmp->getRHS();
+  ICmpInst::Predicate pred = cmp->getPredicate();
+  if (isa<ConstantInt>(lhs) && !isa<ConstantInt>(rhs)) {
+    std::swap(lhs, rhs);
+    pred = ICmpInst::getSwappedPredicate(pred);
+  }
+  Reg l = reg(lhs);
+  MOperand r = operand(rhs);
+  if (r.isImm() && r.imm == 0 &&
+      (pred == ICmpInst::EQ || pred == ICmpInst::NE))
+    emit(MInst(MOpcode::Test, 4, MOperand::makeReg(l), MOperand::makeReg(l)));
+  else
+    emit(MInst(MOpcode::Cmp, sizeOf(lhs->getType()), r, MOperand::makeReg(l)));
+  return getCondCode(pred);
+}
+
+void InstructionSelector::selectCall(CallInst *call) {
+  Function *callee = call->getCallee();
+  std::string_view name = callee->getName();
+  unsigned numArgs = call->getNumArgs();
+  // llvm.memset(ptr, i8 val, i32 len, i1 volatile) becomes memset(ptr, val,
+  // len); a 32-bit move zero-extends the length to size_t.
+  if (name.substr(0, 11) == "llvm.memset") {
+    name = "memset";
+    numArgs = 3;
+  }
+
+  // Stack arguments go first, so that the argument registers are only live
+  // for the moves right before the call.
+  for (unsigned i = 6; i < numArgs; ++i) {
+    Value *arg = call->getArg(i);
+    emitMov(sizeOf(arg->getType()), operand(arg),
+            MOperand::makeMem(RSP, 8 * (i - 6)));
+  }
+  if (numArgs > 6)
+    mf_.outgoingArgSize = std::max(mf_.outgoingArgSize, 8 * (numArgs - 6));
+  unsigned numArgRegs = std::min(numArgs, 6u);
+  MOperand args[6];
+  for (unsigned i = 0; i < numArgRegs; ++i)
+    args[i] = operand(call->getArg(i));
+  for (unsigned i = 0; i < numArgRegs; ++i)
+    emitMov(sizeOf(call->getArg(i)->getType()), args[i],
+            MOperand::makeReg(kArgRegs[i]));
+
+  MInst inst(MOpcode::Call, 8, MOperand::makeGlobal(name),
+             MOperand::makeImm(callee->isDeclaration()));
+  inst.numArgRegs = numArgRegs;
+  emit(inst);
+  if (!call->getType()->isVoidTy() && call->hasUses())
+    emitMov(4, MOperand::makeReg(RAX), MOperand::makeReg(vregFor(call)));
+}
+
+void InstructionSelector::emitPhiCopies(BasicBlock *from, BasicBlock *to) {
+  struct Copy {
+    Reg dst;
+    MOperand src;
+    unsigned size;
+  };
+  std::vector<Copy> copies;
+  for (Instruction *inst : *to) {
+    auto *phi = dyn_cast<PhiInst>(inst);
+    if (!phi)
+      break;
+    if (!phi->hasUses())
+      continue;
+    Reg dst = vregFor(phi);
+    MOperand src = operand(phi->getIncomingValueForBlock(from));
+    if (!src.isReg() || src.reg != dst)
+      copies.push_back({dst, src, sizeOf(phi->getType())});
+  }
+
+  // The copies happen in parallel: emit a copy once no other copy still
+  // reads its destination, and break cycles with a temporary.
+  auto isRead = [&](Reg r) {
+    return std::any_of(copies.begin(), copies.end(), [&](const Copy &c) {
+      return c.src.isReg() && c.src.reg == r;
+    });
+  };
+  while (!copies.empty()) {
+    auto it = std::find_if(copies.begin(), copies.end(),
+                           [&](const Copy &c) { return !isRead(c.dst); });
+    if (it != copies.end()) {
+      emitMov(it->size, it->src, MOperand::makeReg(it->dst));
+      copies.erase(it);
+      continue;
+    }
+    Reg saved = copies.front().dst, tmp = mf_.createVReg();
+    emitMov(copies.front().size, MOperand::makeReg(saved),
+            MOperand::makeReg(tmp));
+    for (Copy &c : copies)
+      if (c.src.isReg() && c.src.reg == saved)
+        c.src.reg = tmp;
+  }
+}
+
+MBlock *InstructionSelector::edgeTarget(BasicBlock *from, BasicBlock *to) {
+  MBlock *target = blocks_[to->getNumber()];
+  if (to->empty() || !isa<PhiInst>(to->front()))
+    return target;
+  MBlock *edge = mf_.createBlock();
+  edge->loopDepth = cur_->loopDepth;
+  edgeBlocks_.push_back(edge);
+  MBlock *saved = cur_;
+  cur_ = edge;
+  emitPhiCopies(from, to);
+  emit(MInst(MOpcode::Jmp, 8, MOperand::makeLabel(target)));
+  edge->addSuccessor(target);
+  cur_ = saved;
+  return edge;
+}
+
+void InstructionSelector::selectBranch(BranchInst *br) {
+  BasicBlock *bb = br->getParent();
+  BasicBlock *dest = nullptr;
+  if (!br->isConditional() || br->getSuccessor(0) == br->getSuccessor(1))
+    dest = br->getSuccessor(0);
+  else if (auto *c = dyn_cast<ConstantInt>(br->getCondition()))
+    dest = br->getSuccessor(c->isZero() ? 1 : 0);
+  if (dest) {
+    emitPhiCopies(bb, dest);
+    MBlock *target = blocks_[dest->getNumber()];
+    emit(MInst(MOpcode::Jmp, 8, MOperand::makeLabel(target)));
+    cur_->addSuccessor(target);
+    return;
+  }
+
+  MBlock *ifTrue = edgeTarget(bb, br->getSuccessor(0));
+  MBlock *ifFalse = edgeTarget(bb, br->getSuccessor(1));
+  CondCode cc = CondCode::NE;
+  auto *cmp = dyn_cast<ICmpInst>(br->getCondition());
+  if (cmp && isFoldedCompare(cmp)) {
+    cc = emitCompare(cmp);
+  } else {
+    Reg cond = reg(br->getCondition());
+    emit(MInst(MOpcode::Test, 4, MOperand::makeReg(cond),
+               MOperand::makeReg(cond)));
+  }
+  MInst jcc(MOpcode::Jcc, 8, MOperand::makeLabel(ifTrue));
+  jcc.cond = cc;
+  emit(jcc);
+  emit(MInst(MOpcode::Jmp, 8, MOperand::makeLabel(ifFalse)));
+  cur_->addSuccessor(ifTrue);
+  cur_->addSuccessor(ifFalse);
+}
+
+} // namespace
+
+void selectInstructions(Function &f, MFunction &mf) {
+  InstructionSelector(f, mf).run();
+}
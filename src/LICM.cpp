@@ -0,0 +1,181 @@
+#include "IRBuilder.h"
+#include "LoopInfo.h"
+#include "Passes.h"
+#include "TransformUtils.h"
+
+#include <vector>
+
+namespace {
+
+// The memory a loop may write: a list of underlying objects, or everything
+// if the loop calls a function that could write anywhere.
+struct LoopWrites {
+  bool everything = false;
+  std::vector<Value *> objects;
+
+  bool mayWrite(Value *object) const {
+    if (everything)
+      return true;
+    for (Value *w : objects)
+      if (mayAlias(w, object))
+        return true;
+    return false;
+  }
+};
+
+LoopWrites collectWrites(const Loop &loop) {
+  LoopWrites writes;
+  for (BasicBlock *bb : loop.getBlocks()) {
+    for (Instruction *inst : *bb) {
+      if (auto *si = dyn_cast<StoreInst>(inst)) {
+        writes.objects.push_back(getUnderlyingObject(si->getPointerOperand()));
+        continue;
+      }
+      auto *call = dyn_cast<CallInst>(inst);
+      if (!call)
+        continue;
+      // Of the runtime functions only getarray writes memory, and memset
+      // only clears its argument; functions of the program may write
+      // anything.
+      Function *callee = call->getCallee();
+      if (!callee->isDeclaration()) {
+        writes.everything = true;
+        return writes;
+      }
+      for (unsigned i = 0; i < call->getNumArgs(); ++i)
+        if (call->getArg(i)->getType()->isPointerTy())
+          writes.objects.push_back(getUnderlyingObject(call->getArg(i)));
+    }
+  }
+  return writes;
+}
+
+// Division by a variable may trap, so it is only hoisted when the divisor
+// is a constant that makes it safe.
+bool isSafeToSpeculate(const Instruction *inst) {
+  auto *bi = dyn_cast<BinaryInst>(inst);
+  if (!bi || (bi->getOpcode() != BinaryInst::SDiv &&
+              bi->getOpcode() != BinaryInst::SRem))
+    return true;
+  auto *c = dyn_cast<ConstantInt>(bi->getRHS());
+  return c && c->getValue() != 0 && c->getValue() != -1;
+}
+
+// Loop-invariant code motion. Loops are visited inner to outer and
+// invariant computations are moved to the preheader, so that something
+// hoisted out of an inner loop can be hoisted again out of the outer one.
+// Loads are hoisted when nothing in the loop may write their memory and
+// they execute on every iteration. An address computation whose leading
+// indices are invariant is split so that the invariant part (the base of a
+// row of a multi-dimensional array, say) is hoisted on its own.
+class LICM {
+public:
+  LICM(Function &f, const DominatorTree &dt, const LoopInfo &li)
+      : f_(f), dt_(dt), li_(li) {}
+
+  bool run();
+
+private:
+  bool runOnLoop(Loop &loop);
+  bool canHoist(Instruction *inst, const Loop &loop) const;
+  bool isGuaranteedToExecute(const BasicBlock *bb) const {
+    for (BasicBlock *exiting : exiting_)
+      if (!dt_.dominates(bb, exiting))
+        return false;
+    return true;
+  }
+  // Hoists the invariant leading indices of `gep` into a GEP of their own.
+  bool splitInvariantPrefix(GetElementPtrInst *gep, const Loop &loop,
+                            BasicBlock *preheader);
+
+  Function &f_;
+  const DominatorTree &dt_;
+  const LoopInfo &li_;
+  LoopWrites writes_;
+  std::vector<BasicBlock *> exiting_;
+};
+
+bool LICM::canHoist(Instruction *inst, const Loop &loop) const {
+  switch (inst->getKind()) {
+  case Value::Kind::Binary:
+  case Value::Kind::ICmp:
+  case Value::Kind::Cast:
+  case Value::Kind::GEP:
+    break;
+  case Value::Kind::Load:
+    if (writes_.mayWrite(getUnderlyingObject(
+            cast<LoadInst>(inst)->getPointerOperand())) ||
+        !isGuaranteedToExecute(inst->getParent()))
+      return false;
+    break;
+  default:
+    return false;
+  }
+  for (Use *u = inst->op_begin(); u != inst->op_end(); ++u)
+    if (!loop.isLoopInvariant(u->get()))
+      return false;
+  return isSafeToSpeculate(inst);
+}
+
+bool LICM::splitInvariantPrefix(GetElementPtrInst *gep, const Loop &loop,
+                                BasicBlock *preheader) {
+  if (!loop.isLoopInvariant(gep->getPointerOperand()))
+    return false;
+  unsigned n = gep->getNumIndices(), prefix = 0;
+  while (prefix < n && loop.isLoopInvariant(gep->getIndex(prefix)))
+    ++prefix;
+  // A single leading index only steps over whole arrays; there is nothing
+  // worth hoisting unless it reaches into one.
+  if (prefix < 2 || prefix == n)
+    return false;
+  IRBuilder builder(&f_);
+  builder.setInsertPoint(preheader->getTerminator());
+  std::vector<Value *> indices(gep->op_begin() + 1,
+                               gep->op_begin() + 1 + prefix);
+  Value *base = builder.createGEP(gep->getPointerOperand(), indices);
+  indices.assign(1, f_.getInt32(0));
+  indices.insert(indices.end(), gep->op_begin() + 1 + prefix, gep->op_end());
+  builder.setInsertPoint(gep);
+  Value *rest = builder.createGEP(base, indices, gep->getName());
+  gep->replaceAllUsesWith(rest);
+  gep->eraseFromParent();
+  return true;
+}
+
+bool LICM::runOnLoop(Loop &loop) {
+  BasicBlock *preheader = loop.getLoopPreheader();
+  if (!preheader)
+    return false;
+  writes_ = collectWrites(loop);
+  exiting_ = loop.getExitingBlocks();
+  bool changed = false;
+  // Blocks come in reverse post-order, so operands are visited (and hoisted)
+  // before their users.
+  for (BasicBlock *bb : loop.getBlocks()) {
+    for (Instruction *inst : *bb) {
+      if (canHoist(inst, loop)) {
+        inst->moveBefore(preheader->getTerminator());
+        changed = true;
+      } else if (auto *gep = dyn_cast<GetElementPtrInst>(inst)) {
+        changed |= splitInvariantPrefix(gep, loop, preheader);
+      }
+    }
+  }
+  return changed;
+}
+
+bool LICM::run() {
+  bool changed = false;
+  for (Loop *loop : li_.getLoopsInPostOrder())
+    changed |= runOnLoop(*loop);
+  return changed;
+}
+
+} // namespace
+
+bool runLICM(Function &f) {
+  bool changed = formPreheaders(f);
+  DominatorTree dt(f);
+  LoopInfo li(dt);
+  return LICM(f, dt, li).run() || changed;
+}
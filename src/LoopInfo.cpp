@@ -0,0 +1,152 @@
+#include "LoopInfo.h"
+
+#include <algorithm>
+#include <utility>
+
+bool Loop::contains(const Loop *l) const {
+  while (l && l != this)
+    l = l->parent_;
+  return l == this;
+}
+
+bool Loop::contains(const BasicBlock *bb) const {
+  return contains(li_.getLoopFor(bb));
+}
+
+bool Loop::isLoopInvariant(const Value *v) const {
+  auto *inst = dyn_cast<Instruction>(v);
+  return !inst || !contains(inst);
+}
+
+BasicBlock *Loop::getLoopPreheader() const {
+  BasicBlock *preheader = nullptr;
+  for (BasicBlock *pred : header_->predecessors()) {
+    if (contains(pred))
+      continue;
+    if (preheader && preheader != pred)
+      return nullptr;
+    preheader = pred;
+  }
+  return preheader && preheader->getSingleSuccessor() == header_ ? preheader
+                                                                 : nullptr;
+}
+
+BasicBlock *Loop::getLoopLatch() const {
+  BasicBlock *latch = nullptr;
+  for (BasicBlock *pred : header_->predecessors()) {
+    if (!contains(pred))
+      continue;
+    if (latch && latch != pred)
+      return nullptr;
+    latch = pred;
+  }
+  return latch;
+}
+
+std::vector<BasicBlock *> Loop::getExitingBlocks() const {
+  std::vector<BasicBlock *> exiting;
+  for (BasicBlock *bb : blocks_) {
+    for (BasicBlock *succ : bb->successors()) {
+      if (!contains(succ)) {
+        exiting.push_back(bb);
+        break;
+      }
+    }
+  }
+  return exiting;
+}
+
+std::vector<BasicBlock *> Loop::getExitBlocks() const {
+  std::vector<BasicBlock *> exits;
+  for (BasicBlock *bb : blocks_)
+    for (BasicBlock *succ : bb->successors())
+      if (!contains(succ) &&
+          std::find(exits.begin(), exits.end(), succ) == exits.end())
+        exits.push_back(succ);
+  return exits;
+}
+
+unsigned Loop::getSize() const {
+  unsigned n = 0;
+  for (BasicBlock *bb : blocks_)
+    n += bb->size();
+  return n;
+}
+
+LoopInfo::LoopInfo(const DominatorTree &dt) {
+  loopFor_.assign(dt.getNumBlocks(), nullptr);
+  // Visit headers bottom-up in the dominator tree so that inner loops are
+  // discovered before the loops around them. A loop is collected by walking
+  // backwards from its back edges; when the walk runs into a block that
+  // already belongs to a loop, that loop's outermost ancestor becomes a
+  // subloop and the walk continues from the ancestor's header.
+  std::vector<BasicBlock *> preOrder = dt.getPreOrder();
+  std::vector<BasicBlock *> work;
+  for (auto it = preOrder.rbegin(); it != preOrder.rend(); ++it) {
+    BasicBlock *header = *it;
+    for (BasicBlock *pred : header->predecessors())
+      if (dt.isReachable(pred) && dt.dominates(header, pred))
+        work.push_back(pred);
+    if (work.empty())
+      continue;
+    loops_.push_back(std::unique_ptr<Loop>(new Loop(*this, header)));
+    Loop *loop = loops_.back().get();
+    loopFor_[header->getNumber()] = loop;
+    while (!work.empty()) {
+      BasicBlock *bb = work.back();
+      work.pop_back();
+      Loop *sub = loopFor_[bb->getNumber()];
+      if (!sub) {
+        loopFor_[bb->getNumber()] = loop;
+        for (BasicBlock *pred : bb->predecessors())
+          if (dt.isReachable(pred))
+            work.push_back(pred);
+        continue;
+      }
+      while (sub->parent_)
+        sub = sub->parent_;
+      if (sub == loop)
+        continue;
+      sub->parent_ = loop;
+      loop->subLoops_.push_back(sub);
+      for (BasicBlock *pred : sub->header_->predecessors())
+        if (dt.isReachable(pred) && !dt.dominates(sub->header_, pred))
+          work.push_back(pred);
+    }
+  }
+
+  // Loops were created inner to outer; list subloops and top-level loops in
+  // program order instead.
+  for (auto it = loops_.rbegin(); it != loops_.rend(); ++it) {
+    Loop *loop = it->get();
+    std::reverse(loop->subLoops_.begin(), loop->subLoops_.end());
+    if (!loop->parent_)
+      topLevel_.push_back(loop);
+    else
+      loop->depth_ = loop->parent_->depth_ + 1;
+  }
+  for (BasicBlock *bb : dt.getReversePostOrder())
+    for (Loop *l = loopFor_[bb->getNumber()]; l; l = l->parent_)
+      l->blocks_.push_back(bb);
+}
+
+std::vector<Loop *> LoopInfo::getLoopsInPostOrder() const {
+  std::vector<Loop *> order;
+  order.reserve(loops_.size());
+  std::vector<std::pair<Loop *, size_t>> stack;
+  for (Loop *top : topLevel_) {
+    stack.emplace_back(top, 0);
+    while (!stack.empty()) {
+      Loop *l = stack.back().first;
+      size_t i = stack.back().second;
+      if (i < l->subLoops_.size()) {
+        stack.back().second = i + 1;
+        stack.emplace_back(l->subLoops_[i], 0);
+        continue;
+      }
+      order.push_back(l);
+      stack.pop_back();
+    }
+  }
+  return order;
+}
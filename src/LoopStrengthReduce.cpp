@@ -0,0 +1,209 @@
+#include "IRBuilder.h"
+#include "LoopInfo.h"
+#include "Passes.h"
+#include "TransformUtils.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// A header phi that starts at `start` and grows by the constant `step`
+// every iteration.
+struct InductionVariable {
+  PhiInst *phi;
+  Value *start;
+  int32_t step;
+};
+
+bool matchInductionVariable(PhiInst *phi, BasicBlock *preheader,
+                            BasicBlock *latch, InductionVariable &iv) {
+  if (phi->getNumIncoming() != 2 || !phi->getType()->isIntegerTy(32))
+    return false;
+  int fromLatch = phi->getBasicBlockIndex(latch);
+  int fromPreheader = phi->getBasicBlockIndex(preheader);
+  if (fromLatch < 0 || fromPreheader < 0)
+    return false;
+  auto *inc = dyn_cast<BinaryInst>(phi->getIncomingValue(fromLatch));
+  if (!inc || inc->getOpcode() != BinaryInst::Add || inc->getLHS() != phi)
+    return false;
+  auto *step = dyn_cast<ConstantInt>(inc->getRHS());
+  if (!step)
+    return false;
+  iv = {phi, phi->getIncomingValue(fromPreheader), step->getValue()};
+  return true;
+}
+
+// Strength reduction of array addressing in loops, in the spirit of LLVM's
+// LoopStrengthReduce. An address `gep base, ..., iv + c, ...` whose other
+// operands are loop invariant advances by a fixed distance every iteration.
+// It is rewritten into a pointer phi that starts at the address of the
+// first iteration and is bumped by `step` elements in the latch, so the
+// multiply-add of the index disappears from the loop. Addresses that only
+// differ in `c` share one phi and add `c` as a constant offset.
+class LoopStrengthReduce {
+public:
+  explicit LoopStrengthReduce(Function &f) : f_(f), builder_(&f) {}
+
+  bool runOnLoop(Loop &loop);
+
+private:
+  // The index position that varies, or -1 if the GEP is not a candidate.
+  int findVaryingIndex(GetElementPtrInst *gep, const Loop &loop,
+                       const InductionVariable *&iv, int32_t &offset) const;
+  // Whether the GEP's value can be replaced by one computed from the
+  // current iteration's pointer phi.
+  bool usesAreInLoop(GetElementPtrInst *gep, const Loop &loop) const;
+  // Splits the indices after `pos` off into a second GEP so that the
+  // varying index is the last one. Returns the GEP that ends at `pos`.
+  GetElementPtrInst *splitAfter(GetElementPtrInst *gep, unsigned pos);
+
+  Function &f_;
+  IRBuilder builder_;
+  std::vector<InductionVariable> ivs_;
+};
+
+int LoopStrengthReduce::findVaryingIndex(GetElementPtrInst *gep,
+                                         const Loop &loop,
+                                         const InductionVariable *&iv,
+                                         int32_t &offset) const {
+  if (!loop.isLoopInvariant(gep->getPointerOperand()))
+    return -1;
+  int varying = -1;
+  for (unsigned i = 0; i < gep->getNumIndices(); ++i) {
+    Value *idx = gep->getIndex(i);
+    if (loop.isLoopInvariant(idx))
+      continue;
+    if (varying >= 0)
+      return -1;
+    varying = i;
+    Value *base = idx;
+    offset = 0;
+    auto *bi = dyn_cast<BinaryInst>(idx);
+    if (bi && bi->getOpcode() == BinaryInst::Add) {
+      if (auto *c = dyn_cast<ConstantInt>(bi->getRHS())) {
+        base = bi->getLHS();
+        offset = c->getValue();
+      }
+    }
+    iv = nullptr;
+    for (const InductionVariable &candidate : ivs_)
+      if (candidate.phi == base)
+        iv = &candidate;
+    if (!iv)
+      return -1;
+  }
+  return varying;
+}
+
+bool LoopStrengthReduce::usesAreInLoop(GetElementPtrInst *gep,
+                                       const Loop &loop) const {
+  for (Use *u = gep->getFirstUse(); u; u = u->getNext()) {
+    auto *user = cast<Instruction>(u->getUser());
+    // A header phi would see the previous iteration's address.
+    if (!loop.contains(user) ||
+        (isa<PhiInst>(user) && user->getParent() == loop.getHeader()))
+      return false;
+  }
+  return true;
+}
+
+GetElementPtrInst *LoopStrengthReduce::splitAfter(GetElementPtrInst *gep,
+                                                  unsigned pos) {
+  if (pos + 1 == gep->getNumIndices())
+    return gep;
+  builder_.setInsertPoint(gep);
+  std::vector<Value *> indices(gep->op_begin() + 1, gep->op_begin() + 2 + pos);
+  GetElementPtrInst *head = builder_.createGEP(gep->getPointerOperand(),
+                                               indices);
+  indices.assign(1, f_.getInt32(0));
+  indices.insert(indices.end(), gep->op_begin() + 2 + pos, gep->op_end());
+  Value *tail = builder_.createGEP(head, indices, gep->getName());
+  gep->replaceAllUsesWith(tail);
+  gep->eraseFromParent();
+  return head;
+}
+
+bool LoopStrengthReduce::runOnLoop(Loop &loop) {
+  BasicBlock *preheader = loop.getLoopPreheader();
+  BasicBlock *latch = loop.getLoopLatch();
+  if (!preheader || !latch)
+    return false;
+  ivs_.clear();
+  for (Instruction *inst : *loop.getHeader()) {
+    auto *phi = dyn_cast<PhiInst>(inst);
+    if (!phi)
+      break;
+    InductionVariable iv;
+    if (matchInductionVariable(phi, preheader, latch, iv))
+      ivs_.push_back(iv);
+  }
+  if (ivs_.empty())
+    return false;
+
+  // Subloops were done first, so what is left there only varies with this
+  // loop's induction variables.
+  struct Candidate {
+    GetElementPtrInst *gep;
+    const InductionVariable *iv;
+    int32_t offset;
+  };
+  std::vector<Candidate> candidates;
+  for (BasicBlock *bb : loop.getBlocks()) {
+    for (Instruction *inst : *bb) {
+      auto *gep = dyn_cast<GetElementPtrInst>(inst);
+      const InductionVariable *iv = nullptr;
+      int32_t offset = 0;
+      if (!gep || !usesAreInLoop(gep, loop))
+        continue;
+      int pos = findVaryingIndex(gep, loop, iv, offset);
+      if (pos < 0)
+        continue;
+      candidates.push_back({splitAfter(gep, pos), iv, offset});
+    }
+  }
+
+  // One pointer phi per base address and induction variable, keyed by the
+  // invariant operands.
+  std::map<std::vector<Value *>, PhiInst *> phis;
+  for (const Candidate &c : candidates) {
+    GetElementPtrInst *gep = c.gep;
+    std::vector<Value *> key(gep->op_begin(), gep->op_end() - 1);
+    key.push_back(c.iv->phi);
+    PhiInst *&ptr = phis[key];
+    if (!ptr) {
+      builder_.setInsertPoint(preheader->getTerminator());
+      std::vector<Value *> indices(gep->op_begin() + 1, gep->op_end() - 1);
+      indices.push_back(c.iv->start);
+      Value *init = builder_.createGEP(gep->getPointerOperand(), indices);
+      builder_.setInsertPoint(loop.getHeader()->front());
+      ptr = builder_.createPhi(gep->getType(), 2, "lsr.ptr");
+      builder_.setInsertPoint(latch->getTerminator());
+      Value *next = builder_.createGEP(ptr, {f_.getInt32(c.iv->step)},
+                                       "lsr.next");
+      ptr->addIncoming(f_.getArena(), init, preheader);
+      ptr->addIncoming(f_.getArena(), next, latch);
+    }
+    Value *addr = ptr;
+    if (c.offset) {
+      builder_.setInsertPoint(gep);
+      addr = builder_.createGEP(ptr, {f_.getInt32(c.offset)}, gep->getName());
+    }
+    gep->replaceAllUsesWith(addr);
+    recursivelyDeleteTriviallyDeadInstructions(gep);
+  }
+  return !candidates.empty();
+}
+
+} // namespace
+
+bool runLoopStrengthReduce(Function &f) {
+  bool changed = formPreheaders(f);
+  DominatorTree dt(f);
+  LoopInfo li(dt);
+  LoopStrengthReduce lsr(f);
+  for (Loop *loop : li.getLoopsInPostOrder())
+    changed |= lsr.runOnLoop(*loop);
+  return changed;
+}
@@ -0,0 +1,255 @@
+#include "LoopInfo.h"
+#include "Passes.h"
+#include "TransformUtils.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Fully unrolled loops may grow to this many instructions.
+constexpr unsigned kFullUnrollSize = 400;
+// Partially unrolled loop bodies may grow to this many instructions.
+constexpr unsigned kPartialUnrollSize = 160;
+constexpr unsigned kMaxUnrollFactor = 8;
+// Trip counts are found by running the loop's exit test; give up on loops
+// that run longer than this.
+constexpr unsigned kMaxTripCount = 1 << 20;
+
+// A loop in the shape `while (iv pred bound)` as IRGen emits it: the header
+// is the only exiting block and tests an induction variable with constant
+// start and step against a constant.
+struct UnrollCandidate {
+  std::vector<BasicBlock *> blocks;
+  BasicBlock *header, *preheader, *latch, *exit;
+  // Which successor of the header's branch stays in the loop.
+  unsigned stayIndex;
+  unsigned tripCount;
+  unsigned size;
+};
+
+bool computeTripCount(const Loop &loop, UnrollCandidate &c) {
+  auto *br = dyn_cast<BranchInst>(c.header->getTerminator());
+  if (!br || !br->isConditional())
+    return false;
+  auto *cmp = dyn_cast<ICmpInst>(br->getCondition());
+  if (!cmp)
+    return false;
+  ICmpInst::Predicate pred = cmp->getPredicate();
+  Value *lhs = cmp->getLHS();
+  auto *bound = dyn_cast<ConstantInt>(cmp->getRHS());
+  if (!bound) {
+    bound = dyn_cast<ConstantInt>(lhs);
+    lhs = cmp->getRHS();
+    pred = ICmpInst::getSwappedPredicate(pred);
+  }
+  auto *phi = dyn_cast<PhiInst>(lhs);
+  if (!bound || !phi || phi->getParent() != c.header ||
+      phi->getNumIncoming() != 2)
+    return false;
+  auto *start =
+      dyn_cast<ConstantInt>(phi->getIncomingValueForBlock(c.preheader));
+  auto *inc = dyn_cast<BinaryInst>(phi->getIncomingValueForBlock(c.latch));
+  if (!start || !inc || inc->getOpcode() != BinaryInst::Add ||
+      inc->getLHS() != phi || !isa<ConstantInt>(inc->getRHS()))
+    return false;
+  int32_t step = cast<ConstantInt>(inc->getRHS())->getValue();
+  bool stayIfTrue = loop.contains(br->getSuccessor(0));
+  c.stayIndex = stayIfTrue ? 0 : 1;
+
+  uint32_t v = start->getValue();
+  unsigned count = 0;
+  while (ICmpInst::fold(pred, v, bound->getValue()) == stayIfTrue) {
+    if (++count > kMaxTripCount)
+      return false;
+    v += step;
+  }
+  c.tripCount = count;
+  return true;
+}
+
+bool analyzeLoop(const Loop &loop, UnrollCandidate &c) {
+  if (!loop.isInnermost())
+    return false;
+  c.header = loop.getHeader();
+  c.preheader = loop.getLoopPreheader();
+  c.latch = loop.getLoopLatch();
+  if (!c.preheader || !c.latch)
+    return false;
+  std::vector<BasicBlock *> exiting = loop.getExitingBlocks();
+  std::vector<BasicBlock *> exits = loop.getExitBlocks();
+  if (exiting.size() != 1 || exiting[0] != c.header || exits.size() != 1)
+    return false;
+  c.exit = exits[0];
+  c.blocks = loop.getBlocks();
+  c.size = loop.getSize();
+  return computeTripCount(loop, c);
+}
+
+// Unrolls a loop `factor` times by cloning its blocks. Copy k's latch
+// branches to copy k+1's header, the last copy's latch back to the
+// original header, and the header phis of the copies are replaced by the
+// values of the previous copy. The header tests of the copies are folded
+// away, since the trip count says how they come out: in a partial unroll
+// every copy but the original stays in the loop, and in a full unroll
+// (with one copy more than the trip count) every copy but the last does.
+class LoopUnroller {
+public:
+  LoopUnroller(Function &f, const UnrollCandidate &c) : f_(f), c_(c) {}
+
+  void unroll(unsigned factor, bool full);
+
+private:
+  using ValueMap = std::unordered_map<Value *, Value *>;
+
+  static Value *lookup(const ValueMap &map, Value *v) {
+    auto it = map.find(v);
+    return it == map.end() ? v : it->second;
+  }
+  void cloneBlocks(const ValueMap &prev, ValueMap &map, BasicBlock *pos);
+
+  Function &f_;
+  const UnrollCandidate &c_;
+};
+
+void LoopUnroller::cloneBlocks(const ValueMap &prev, ValueMap &map,
+                               BasicBlock *pos) {
+  Arena &arena = f_.getArena();
+  for (BasicBlock *bb : c_.blocks)
+    map[bb] = f_.createBlock(bb->getName(), pos);
+  std::vector<Instruction *> clones;
+  for (BasicBlock *bb : c_.blocks) {
+    auto *copy = cast<BasicBlock>(map[bb]);
+    for (Instruction *inst : *bb) {
+      if (auto *phi = dyn_cast<PhiInst>(inst); phi && bb == c_.header) {
+        map[phi] = lookup(prev, phi->getIncomingValueForBlock(c_.latch));
+        continue;
+      }
+      Instruction *clone = inst->clone(arena);
+      clone->setName(inst->getName());
+      copy->push_back(clone);
+      map[inst] = clone;
+      clones.push_back(clone);
+    }
+  }
+  for (Instruction *clone : clones) {
+    for (Use *u = clone->op_begin(); u != clone->op_end(); ++u)
+      u->set(lookup(map, u->get()));
+    if (auto *phi = dyn_cast<PhiInst>(clone))
+      for (unsigned i = 0; i < phi->getNumIncoming(); ++i)
+        phi->setIncomingBlock(
+            i, cast<BasicBlock>(lookup(map, phi->getIncomingBlock(i))));
+  }
+}
+
+void LoopUnroller::unroll(unsigned factor, bool full) {
+  std::unordered_set<BasicBlock *> inLoop(c_.blocks.begin(), c_.blocks.end());
+  BasicBlock *pos = nullptr;
+  for (BasicBlock *bb : f_)
+    if (inLoop.count(bb))
+      pos = bb->getNextNode();
+
+  // maps[0] is the identity: copy 0 is the original loop.
+  std::vector<ValueMap> maps(factor);
+  std::vector<BasicBlock *> headers{c_.header}, latches{c_.latch};
+  for (unsigned k = 1; k < factor; ++k) {
+    cloneBlocks(maps[k - 1], maps[k], pos);
+    headers.push_back(cast<BasicBlock>(maps[k][c_.header]));
+    latches.push_back(cast<BasicBlock>(maps[k][c_.latch]));
+  }
+
+  // Chain the copies together and close the loop from the last one.
+  Arena &arena = f_.getArena();
+  for (unsigned k = 0; k < factor; ++k) {
+    BasicBlock *next = k + 1 < factor ? headers[k + 1] : c_.header;
+    auto *br = cast<BranchInst>(latches[k]->getTerminator());
+    for (unsigned i = 0; i < br->getNumSuccessors(); ++i)
+      if (br->getSuccessor(i) == headers[k])
+        br->setSuccessor(i, next);
+  }
+  for (Instruction *inst : *c_.header) {
+    auto *phi = dyn_cast<PhiInst>(inst);
+    if (!phi)
+      break;
+    int idx = phi->getBasicBlockIndex(c_.latch);
+    phi->setIncomingValue(idx, lookup(maps[factor - 1],
+                                      phi->getIncomingValue(idx)));
+    phi->setIncomingBlock(idx, latches[factor - 1]);
+  }
+  // Every copy of the header can leave the loop, for now.
+  std::vector<std::pair<PhiInst *, Value *>> exitValues;
+  for (Instruction *inst : *c_.exit) {
+    auto *phi = dyn_cast<PhiInst>(inst);
+    if (!phi)
+      break;
+    exitValues.emplace_back(phi, phi->getIncomingValueForBlock(c_.header));
+  }
+
+  if (full && factor > 1) {
+    // The loop is left from the last copy, so code after the loop uses
+    // that copy's values. Collect the uses first: the replacement may be
+    // another value of the original header.
+    std::unordered_set<BasicBlock *> inCopies(inLoop);
+    for (unsigned k = 1; k < factor; ++k)
+      for (BasicBlock *bb : c_.blocks)
+        inCopies.insert(cast<BasicBlock>(maps[k][bb]));
+    std::vector<std::pair<Use *, Value *>> outside;
+    for (Instruction *inst : *c_.header)
+      for (Use *u : inst->uses())
+        if (!inCopies.count(cast<Instruction>(u->getUser())->getParent()))
+          outside.emplace_back(u, lookup(maps[factor - 1], inst));
+    for (auto &[u, v] : outside)
+      u->set(v);
+  }
+
+  for (auto &[phi, v] : exitValues)
+    for (unsigned k = 1; k < factor; ++k)
+      phi->addIncoming(arena, lookup(maps[k], v), headers[k]);
+
+  for (unsigned k = 0; k < factor; ++k) {
+    if (!full && k == 0)
+      continue;
+    bool leave = full && k + 1 == factor;
+    auto *br = cast<BranchInst>(headers[k]->getTerminator());
+    foldBranchTo(headers[k],
+                 br->getSuccessor(leave ? 1 - c_.stayIndex : c_.stayIndex));
+  }
+}
+
+} // namespace
+
+bool runLoopUnroll(Function &f) {
+  bool changed = formPreheaders(f);
+  std::vector<UnrollCandidate> candidates;
+  {
+    DominatorTree dt(f);
+    LoopInfo li(dt);
+    for (Loop *loop : li.getLoopsInPostOrder()) {
+      UnrollCandidate c;
+      if (analyzeLoop(*loop, c))
+        candidates.push_back(std::move(c));
+    }
+  }
+  // Candidates are innermost loops and so never overlap; unrolling one
+  // leaves the blocks of the others alone.
+  for (const UnrollCandidate &c : candidates) {
+    LoopUnroller unroller(f, c);
+    if (static_cast<uint64_t>(c.tripCount + 1) * c.size <= kFullUnrollSize) {
+      unroller.unroll(c.tripCount + 1, true);
+      changed = true;
+      continue;
+    }
+    for (unsigned factor = kMaxUnrollFactor; factor > 1; factor /= 2) {
+      if (c.tripCount % factor == 0 && factor * c.size <= kPartialUnrollSize) {
+        unroller.unroll(factor, false);
+        changed = true;
+        break;
+      }
+    }
+  }
+  if (changed)
+    removeUnreachableBlocks(f);
+  return changed;
+}
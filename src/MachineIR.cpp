@@ -0,0 +1,69 @@
+#include "MachineIR.h"
+
+#include <algorithm>
+
+const Reg kArgRegs[6] = {RDI, RSI, RDX, RCX, R8, R9};
+const Reg kCallerSavedRegs[9] = {RAX, RCX, RDX, RSI, RDI, R8, R9, R10, R11};
+
+bool isCalleeSaved(Reg r) {
+  return r == RBX || r == RBP || (r >= R12 && r <= R15);
+}
+
+const char *getRegName(Reg r, unsigned size) {
+  static const char *const kNames64[] = {
+      "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+      "r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15"};
+  static const char *const kNames32[] = {
+      "eax", "ecx", "edx",  "ebx",  "esp",  "ebp",  "esi",  "edi",
+      "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+  static const char *const kNames8[] = {
+      "al",  "cl",  "dl",   "bl",   "spl",  "bpl",  "sil",  "dil",
+      "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"};
+  if (size == 8)
+    return kNames64[r];
+  return size == 4 ? kNames32[r] : kNames8[r];
+}
+
+CondCode getInverseCond(CondCode cc) {
+  switch (cc) {
+  case CondCode::E:
+    return CondCode::NE;
+  case CondCode::NE:
+    return CondCode::E;
+  case CondCode::L:
+    return CondCode::GE;
+  case CondCode::G:
+    return CondCode::LE;
+  case CondCode::LE:
+    return CondCode::G;
+  default:
+    return CondCode::L;
+  }
+}
+
+const char *getCondSuffix(CondCode cc) {
+  static const char *const kSuffixes[] = {"e", "ne", "l", "g", "le", "ge"};
+  return kSuffixes[static_cast<unsigned>(cc)];
+}
+
+void MBlock::addSuccessor(MBlock *bb) {
+  if (std::find(succs_.begin(), succs_.end(), bb) == succs_.end())
+    succs_.push_back(bb);
+}
+
+MBlock *MFunction::createBlock() {
+  blocks_.push_back(std::make_unique<MBlock>(blocks_.size()));
+  return blocks_.back().get();
+}
+
+void MFunction::setLayout(const std::vector<MBlock *> &order) {
+  std::vector<std::unique_ptr<MBlock>> blocks(blocks_.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    blocks[i] = std::move(blocks_[order[i]->getNumber()]);
+  blocks_ = std::move(blocks);
+}
+
+int MFunction::createFrameObject(uint32_t size, uint32_t align) {
+  frame_.push_back({size, align});
+  return static_cast<int>(frame_.size()) - 1;
+}
@@ -0,0 +1,286 @@
+#include "Mem2Reg.h"
+#include "Dominators.h"
+
+#include <utility>
+
+namespace {
+
+// A scalar alloca whose address is used by nothing but the pointer operand of
+// loads and stores.
+bool isPromotable(const AllocaInst *ai) {
+  if (isa<ArrayType>(ai->getAllocatedType()))
+    return false;
+  for (Use *u = ai->getFirstUse(); u; u = u->getNext()) {
+    User *user = u->getUser();
+    if (isa<LoadInst>(user))
+      continue;
+    auto *si = dyn_cast<StoreInst>(user);
+    if (!si || si->getValueOperand() == ai)
+      return false;
+  }
+  return true;
+}
+
+class PromoteMem2Reg {
+public:
+  PromoteMem2Reg(Function &f, std::vector<AllocaInst *> allocas)
+      : f_(f), allocas_(std::move(allocas)), dt_(f), df_(dt_),
+        newPhis_(dt_.getNumBlocks()) {}
+
+  void run();
+
+private:
+  // 1 + the index of the promoted alloca `ptr` refers to, or 0.
+  static unsigned allocaIndex(Value *ptr) {
+    auto *ai = dyn_cast<AllocaInst>(ptr);
+    return ai ? ai->aux : 0;
+  }
+  Value *initialValue(Type *t) {
+    if (auto *it = dyn_cast<IntegerType>(t))
+      return f_.getConstantInt(it, 0);
+    return f_.getUndef(t);
+  }
+
+  void computeBlockInfo();
+  void placePhis(unsigned idx);
+  void rename();
+  void cleanUp();
+
+  Function &f_;
+  std::vector<AllocaInst *> allocas_;
+  DominatorTree dt_;
+  DominanceFrontier df_;
+  // Per alloca: blocks that store to it, and blocks where it is read before
+  // being written.
+  std::vector<std::vector<BasicBlock *>> defBlocks_;
+  std::vector<std::vector<BasicBlock *>> liveInBlocks_;
+  // Per block: the phis placed there and the alloca each one stands for.
+  std::vector<std::vector<std::pair<PhiInst *, unsigned>>> newPhis_;
+  std::vector<bool> visited_;
+};
+
+void PromoteMem2Reg::computeBlockInfo() {
+  unsigned n = allocas_.size();
+  defBlocks_.assign(n, {});
+  liveInBlocks_.assign(n, {});
+  // Block number + 1 of the last block that accessed (stored to) each
+  // alloca, to find the first access per block in a single walk.
+  std::vector<unsigned> accessed(n, 0), stored(n, 0);
+  for (BasicBlock *bb : f_) {
+    unsigned stamp = bb->getNumber() + 1;
+    for (Instruction *inst : *bb) {
+      if (auto *li = dyn_cast<LoadInst>(inst)) {
+        unsigned idx = allocaIndex(li->getPointerOperand());
+        if (idx-- == 0)
+          continue;
+        if (accessed[idx] != stamp)
+          liveInBlocks_[idx].push_back(bb);
+        accessed[idx] = stamp;
+      } else if (auto *si = dyn_cast<StoreInst>(inst)) {
+        unsigned idx = allocaIndex(si->getPointerOperand());
+        if (idx-- == 0)
+          continue;
+        if (stored[idx] != stamp)
+          defBlocks_[idx].push_back(bb);
+        accessed[idx] = stored[idx] = stamp;
+      }
+    }
+  }
+}
+
+void PromoteMem2Reg::placePhis(unsigned idx) {
+  unsigned n = dt_.getNumBlocks();
+  std::vector<bool> liveIn(n, false), isDef(n, false), hasPhi(n, false);
+  for (BasicBlock *bb : defBlocks_[idx])
+    isDef[bb->getNumber()] = true;
+
+  // The variable is live into every block on a path from an upward-exposed
+  // read back to a definition.
+  std::vector<BasicBlock *> work = liveInBlocks_[idx];
+  for (BasicBlock *bb : work)
+    liveIn[bb->getNumber()] = true;
+  while (!work.empty()) {
+    BasicBlock *bb = work.back();
+    work.pop_back();
+    for (BasicBlock *pred : bb->predecessors()) {
+      unsigned p = pred->getNumber();
+      if (liveIn[p] || isDef[p])
+        continue;
+      liveIn[p] = true;
+      work.push_back(pred);
+    }
+  }
+
+  AllocaInst *ai = allocas_[idx];
+  Arena &arena = f_.getArena();
+  work.clear();
+  for (BasicBlock *bb : defBlocks_[idx])
+    if (dt_.isReachable(bb))
+      work.push_back(bb);
+  while (!work.empty()) {
+    BasicBlock *bb = work.back();
+    work.pop_back();
+    for (BasicBlock *front : df_.get(bb)) {
+      unsigned b = front->getNumber();
+      if (hasPhi[b] || !liveIn[b])
+        continue;
+      hasPhi[b] = true;
+      auto *phi = arena.create<PhiInst>(arena, ai->getAllocatedType());
+      phi->setName(ai->getName());
+      front->push_front(phi);
+      newPhis_[b].emplace_back(phi, idx);
+      if (!isDef[b])
+        work.push_back(front);
+    }
+  }
+}
+
+void PromoteMem2Reg::rename() {
+  struct Item {
+    BasicBlock *bb;
+    BasicBlock *pred;
+    std::vector<Value *> values;
+  };
+
+  Arena &arena = f_.getArena();
+  visited_.assign(dt_.getNumBlocks(), false);
+  std::vector<Value *> initial;
+  initial.reserve(allocas_.size());
+  for (AllocaInst *ai : allocas_)
+    initial.push_back(initialValue(ai->getAllocatedType()));
+
+  std::vector<Item> work;
+  work.push_back({f_.getEntryBlock(), nullptr, std::move(initial)});
+  while (!work.empty()) {
+    Item item = std::move(work.back());
+    work.pop_back();
+    unsigned b = item.bb->getNumber();
+    for (auto &[phi, idx] : newPhis_[b]) {
+      phi->addIncoming(arena, item.values[idx], item.pred);
+      item.values[idx] = phi;
+    }
+    if (visited_[b])
+      continue;
+    visited_[b] = true;
+
+    for (Instruction *inst : *item.bb) {
+      if (auto *li = dyn_cast<LoadInst>(inst)) {
+        if (unsigned idx = allocaIndex(li->getPointerOperand())) {
+          li->replaceAllUsesWith(item.values[idx - 1]);
+          li->eraseFromParent();
+        }
+      } else if (auto *si = dyn_cast<StoreInst>(inst)) {
+        if (unsigned idx = allocaIndex(si->getPointerOperand())) {
+          item.values[idx - 1] = si->getValueOperand();
+          si->eraseFromParent();
+        }
+      }
+    }
+
+    // One item per edge, so that a block reached twice from the same branch
+    // gets two phi entries, as LLVM expects.
+    unsigned numSuccs = item.bb->getNumSuccessors();
+    for (unsigned i = 0; i < numSuccs; ++i) {
+      BasicBlock *succ = item.bb->getSuccessor(i);
+      if (i + 1 == numSuccs)
+        work.push_back({succ, item.bb, std::move(item.values)});
+      else
+        work.push_back({succ, item.bb, item.values});
+    }
+  }
+}
+
+void PromoteMem2Reg::cleanUp() {
+  Arena &arena = f_.getArena();
+
+  // Accesses left over in unreachable blocks.
+  for (AllocaInst *ai : allocas_) {
+    Value *init = initialValue(ai->getAllocatedType());
+    for (Use *u : ai->uses()) {
+      auto *inst = cast<Instruction>(u->getUser());
+      if (isa<LoadInst>(inst))
+        inst->replaceAllUsesWith(init);
+      inst->eraseFromParent();
+    }
+    ai->eraseFromParent();
+  }
+
+  // Phis need an entry for every predecessor, reachable or not.
+  std::vector<PhiInst *> phis;
+  for (BasicBlock *bb : f_) {
+    auto &placed = newPhis_[bb->getNumber()];
+    if (placed.empty())
+      continue;
+    for (BasicBlock *pred : bb->predecessors()) {
+      if (visited_[pred->getNumber()])
+        continue;
+      for (auto &[phi, idx] : placed)
+        phi->addIncoming(arena, initialValue(phi->getType()), pred);
+    }
+    for (auto &entry : placed)
+      phis.push_back(entry.first);
+  }
+
+  // Remove phis that merge a single value or feed nothing. Removing one may
+  // make others trivial, so users go back on the worklist.
+  std::vector<bool> erased(phis.size(), false);
+  for (size_t i = 0; i < phis.size(); ++i)
+    phis[i]->aux = i;
+  std::vector<unsigned> work(phis.size());
+  for (size_t i = 0; i < phis.size(); ++i)
+    work[i] = phis.size() - 1 - i;
+  while (!work.empty()) {
+    unsigned i = work.back();
+    work.pop_back();
+    if (erased[i])
+      continue;
+    PhiInst *phi = phis[i];
+    Value *same = phi->hasUses() ? phi->hasConstantValue() : phi;
+    if (!same)
+      continue;
+    for (User *user : phi->users())
+      if (auto *p = dyn_cast<PhiInst>(user))
+        if (p != phi && p->aux < phis.size() && phis[p->aux] == p)
+          work.push_back(p->aux);
+    if (same != phi)
+      phi->replaceAllUsesWith(same);
+    // Incoming values may now have lost their last use.
+    for (unsigned k = 0; k < phi->getNumIncoming(); ++k)
+      if (auto *p = dyn_cast<PhiInst>(phi->getIncomingValue(k)))
+        if (p != phi && p->aux < phis.size() && phis[p->aux] == p)
+          work.push_back(p->aux);
+    phi->eraseFromParent();
+    erased[i] = true;
+  }
+}
+
+void PromoteMem2Reg::run() {
+  computeBlockInfo();
+  for (unsigned i = 0; i < allocas_.size(); ++i)
+    placePhis(i);
+  rename();
+  cleanUp();
+}
+
+} // namespace
+
+bool promoteMemoryToRegister(Function &f) {
+  if (f.isDeclaration())
+    return false;
+
+  std::vector<AllocaInst *> allocas;
+  for (BasicBlock *bb : f)
+    for (Instruction *inst : *bb)
+      if (auto *ai = dyn_cast<AllocaInst>(inst)) {
+        ai->aux = 0;
+        if (isPromotable(ai)) {
+          allocas.push_back(ai);
+          ai->aux = allocas.size();
+        }
+      }
+  if (allocas.empty())
+    return false;
+
+  PromoteMem2Reg(f, std::move(allocas)).run();
+  return true;
+}
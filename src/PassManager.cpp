@@ -0,0 +1,175 @@
+#include "PassManager.h"
+#include "Mem2Reg.h"
+#include "Passes.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+uint64_t countInstructions(const Module &m) {
+  uint64_t n = 0;
+  for (const auto &f : m.functions())
+    n += f->getInstructionCount();
+  return n;
+}
+
+} // namespace
+
+void PassManager::addPass(const char *name, FunctionPass pass) {
+  passes_.push_back({name, pass, nullptr, {}});
+}
+
+void PassManager::addModulePass(const char *name, ModulePass pass) {
+  passes_.push_back({name, nullptr, pass, {}});
+}
+
+void PassManager::Stats::add(const Stats &o) {
+  seconds += o.seconds;
+  runs += o.runs;
+  changed += o.changed;
+  instsBefore += o.instsBefore;
+  instsAfter += o.instsAfter;
+}
+
+void PassManager::runFunctionPasses(size_t first, size_t last, Function &f,
+                                    Stats *stats) {
+  for (size_t i = first; i < last; ++i) {
+    FunctionPass pass = passes_[i].functionPass;
+    if (!timePasses_) {
+      pass(f);
+      if (afterPass_)
+        afterPass_(i);
+      continue;
+    }
+    Stats &s = stats[i - first];
+    unsigned before = f.getInstructionCount();
+    Clock::time_point start = Clock::now();
+    bool changed = pass(f);
+    s.seconds += secondsSince(start);
+    ++s.runs;
+    s.changed += changed;
+    s.instsBefore += before;
+    s.instsAfter += f.getInstructionCount();
+    if (afterPass_)
+      afterPass_(i);
+  }
+}
+
+void PassManager::runOnFunctions(const std::vector<Function *> &functions,
+                                 size_t first, size_t last) {
+  if (first == last)
+    return;
+  // Each function gets its own statistics, which are summed in module order
+  // afterwards so that the report does not depend on scheduling.
+  size_t width = last - first;
+  std::vector<Stats> stats(timePasses_ ? functions.size() * width : 0);
+  auto runOn = [&](size_t k) {
+    runFunctionPasses(first, last, *functions[k],
+                      timePasses_ ? &stats[k * width] : nullptr);
+  };
+  if (pool_)
+    pool_->parallelFor(functions.size(), runOn);
+  else
+    for (size_t k = 0; k < functions.size(); ++k)
+      runOn(k);
+  for (size_t k = 0; k < stats.size(); ++k)
+    passes_[first + k % width].stats.add(stats[k]);
+}
+
+void PassManager::run(Module &m, size_t first, size_t last) {
+  for (size_t i = first; i < last;) {
+    Entry &e = passes_[i];
+    if (e.modulePass) {
+      if (!timePasses_) {
+        e.modulePass(m);
+      } else {
+        e.stats.instsBefore += countInstructions(m);
+        Clock::time_point start = Clock::now();
+        e.stats.changed += e.modulePass(m);
+        e.stats.seconds += secondsSince(start);
+        ++e.stats.runs;
+        e.stats.instsAfter += countInstructions(m);
+      }
+      if (afterPass_)
+        afterPass_(i);
+      ++i;
+      continue;
+    }
+    size_t end = i;
+    while (end < last && passes_[end].functionPass)
+      ++end;
+    std::vector<Function *> functions;
+    for (const auto &f : m.functions())
+      if (!f->isDeclaration())
+        functions.push_back(f.get());
+    runOnFunctions(functions, i, end);
+    i = end;
+  }
+}
+
+void PassManager::printTimeReport(std::string &out) const {
+  char line[160];
+  double total = 0;
+  for (const Entry &e : passes_)
+    total += e.stats.seconds;
+  out += "===--- Pass execution timing report ---===\n";
+  std::snprintf(line, sizeof(line), "%10s %6s %6s %8s %12s %12s %9s  %s\n",
+                "Time (ms)", "%", "Runs", "Changed", "Insts before",
+                "Insts after", "Delta", "Pass");
+  out += line;
+  for (const Entry &e : passes_) {
+    const Stats &s = e.stats;
+    std::snprintf(line, sizeof(line),
+                  "%10.3f %5.1f%% %6u %8u %12" PRIu64 " %12" PRIu64
+                  " %+9" PRId64 "  %s\n",
+                  s.seconds * 1000, total > 0 ? s.seconds / total * 100 : 0.0,
+                  s.runs, s.changed, s.instsBefore, s.instsAfter,
+                  static_cast<int64_t>(s.instsAfter - s.instsBefore), e.name);
+    out += line;
+  }
+  std::snprintf(line, sizeof(line), "%10.3f %5.1f%% %50s  Total\n",
+                total * 1000, 100.0, "");
+  out += line;
+}
+
+void buildPipeline(PassManager &pm, unsigned optLevel) {
+  if (optLevel == 0)
+    return;
+  pm.addModulePass("globalopt", runGlobalOpt);
+  pm.addPass("mem2reg", promoteMemoryToRegister);
+  pm.addPass("sccp", runSCCP);
+  pm.addPass("instcombine", runInstCombine);
+  pm.addPass("simplifycfg", runSimplifyCFG);
+  pm.addPass("tailcallelim", runTailRecursionElimination);
+  if (optLevel >= 2) {
+    // Callees are simplified before the inliner sizes them up; the callers
+    // are cleaned up again afterwards.
+    pm.addModulePass("inline", runInliner);
+    pm.addPass("sccp", runSCCP);
+    pm.addPass("instcombine", runInstCombine);
+    pm.addPass("gvn", runGVN);
+    pm.addPass("instcombine", runInstCombine);
+    pm.addPass("simplifycfg", runSimplifyCFG);
+  }
+  pm.addPass("licm", runLICM);
+  if (optLevel >= 2) {
+    pm.addPass("loop-unroll", runLoopUnroll);
+    pm.addPass("sccp", runSCCP);
+    pm.addPass("instcombine", runInstCombine);
+    pm.addPass("gvn", runGVN);
+    pm.addPass("simplifycfg", runSimplifyCFG);
+    pm.addPass("licm", runLICM);
+    pm.addPass("loop-reduce", runLoopStrengthReduce);
+  }
+  pm.addPass("adce", runADCE);
+  pm.addPass("simplifycfg", runSimplifyCFG);
+}
@@ -0,0 +1,422 @@
+#include "MachineIR.h"
+
+#include <algorithm>
+
+namespace {
+
+// Registers handed out by the allocator, caller-saved ones first since
+// they cost nothing to use. %r10 and %r11 are kept back for spill code.
+const Reg kAllocatable[] = {RAX, RCX, RDX, RSI, RDI, R8,  R9,
+                            RBX, R12, R13, R14, R15};
+const Reg kScratch[2] = {R10, R11};
+
+using BitVector = std::vector<uint64_t>;
+
+bool test(const BitVector &bits, unsigned i) {
+  return bits[i / 64] >> (i % 64) & 1;
+}
+void set(BitVector &bits, unsigned i) {
+  bits[i / 64] |= uint64_t(1) << (i % 64);
+}
+
+// The live interval of a virtual register: the positions from its first
+// definition or live-in point to its last use or live-out point. Every
+// instruction i has two positions, 2i where it reads its operands and
+// 2i + 1 where it writes its results.
+struct Interval {
+  Reg vreg;
+  uint32_t start = UINT32_MAX;
+  uint32_t end = 0;
+  // Estimated number of executions of the instructions that access the
+  // register, the cost of keeping it in memory.
+  float spillCost = 0;
+  Reg assigned = kNoReg;
+  bool spilled = false;
+
+  float weight() const { return spillCost / float(end - start + 1); }
+};
+
+class LinearScan {
+public:
+  explicit LinearScan(MFunction &mf) : mf_(mf) {}
+
+  void run();
+
+private:
+  Interval &interval(Reg vreg) { return intervals_[vreg - kFirstVirtReg]; }
+
+  void computeLiveness();
+  void buildIntervals();
+  void buildFixedRanges();
+  // Whether `phys` is taken by a fixed use of the register, e.g. an argument
+  // or a call clobber, somewhere in `iv`.
+  bool isBlocked(Reg phys, const Interval &iv) const;
+  void allocate();
+  Reg physFor(Reg r) const {
+    return isVirtReg(r) ? intervals_[r - kFirstVirtReg].assigned : r;
+  }
+  void rewrite();
+  void rewrite(MInst inst, std::vector<MInst> &out);
+  void layoutFrame();
+
+  MFunction &mf_;
+  unsigned numBlocks_ = 0;
+  unsigned words_ = 0;
+  std::vector<BitVector> liveIn_, liveOut_;
+  std::vector<uint32_t> blockStart_, blockEnd_;
+  std::vector<Interval> intervals_;
+  // Copy-related registers the allocator tries to assign the same register,
+  // so that the copy disappears.
+  std::vector<Reg> hints_;
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> fixed_;
+  std::vector<int> spillSlots_;
+};
+
+void LinearScan::computeLiveness() {
+  numBlocks_ = mf_.blocks().size();
+  words_ = (mf_.getNumVRegs() + 63) / 64;
+  std::vector<BitVector> uses(numBlocks_, BitVector(words_)),
+      defs(numBlocks_, BitVector(words_));
+  for (const auto &bb : mf_.blocks()) {
+    BitVector &use = uses[bb->getNumber()], &def = defs[bb->getNumber()];
+    for (MInst &inst : bb->insts()) {
+      forEachReg(inst, [&](Reg &r, bool isUse, bool) {
+        if (isUse && isVirtReg(r) && !test(def, r - kFirstVirtReg))
+          set(use, r - kFirstVirtReg);
+      });
+      forEachReg(inst, [&](Reg &r, bool, bool isDef) {
+        if (isDef && isVirtReg(r))
+          set(def, r - kFirstVirtReg);
+      });
+    }
+  }
+
+  // liveIn = use | (liveOut & ~def), iterated to a fixed point in reverse
+  // layout order.
+  liveIn_.assign(numBlocks_, BitVector(words_));
+  liveOut_.assign(numBlocks_, BitVector(words_));
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto it = mf_.blocks().rbegin(); it != mf_.blocks().rend(); ++it) {
+      unsigned n = (*it)->getNumber();
+      BitVector &out = liveOut_[n], &in = liveIn_[n];
+      for (MBlock *succ : (*it)->successors()) {
+        const BitVector &succIn = liveIn_[succ->getNumber()];
+        for (unsigned w = 0; w < words_; ++w)
+          out[w] |= succIn[w];
+      }
+      for (unsigned w = 0; w < words_; ++w) {
+        uint64_t v = uses[n][w] | (out[w] & ~defs[n][w]);
+        if (v != in[w]) {
+          in[w] = v;
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+void LinearScan::buildIntervals() {
+  intervals_.resize(mf_.getNumVRegs());
+  hints_.assign(mf_.getNumVRegs(), kNoReg);
+  for (unsigned i = 0; i < intervals_.size(); ++i)
+    intervals_[i].vreg = i + kFirstVirtReg;
+  blockStart_.resize(numBlocks_);
+  blockEnd_.resize(numBlocks_);
+
+  uint32_t index = 0;
+  for (const auto &bb : mf_.blocks()) {
+    unsigned n = bb->getNumber();
+    blockStart_[n] = 2 * index;
+    blockEnd_[n] = 2 * (index + bb->insts().size()) - 1;
+    for (unsigned w = 0; w < words_; ++w) {
+      for (uint64_t bits = liveIn_[n][w]; bits; bits &= bits - 1) {
+        Interval &iv = intervals_[64 * w + __builtin_ctzll(bits)];
+        iv.start = std::min(iv.start, blockStart_[n]);
+      }
+      for (uint64_t bits = liveOut_[n][w]; bits; bits &= bits - 1) {
+        Interval &iv = intervals_[64 * w + __builtin_ctzll(bits)];
+        iv.end = std::max(iv.end, blockEnd_[n]);
+      }
+    }
+    float freq = 1;
+    for (unsigned d = 0; d < std::min(bb->loopDepth, 8u); ++d)
+      freq *= 10;
+    for (MInst &inst : bb->insts()) {
+      uint32_t pos = 2 * index++;
+      forEachReg(inst, [&](Reg &r, bool isUse, bool isDef) {
+        if (!isVirtReg(r))
+          return;
+        Interval &iv = interval(r);
+        iv.start = std::min(iv.start, isUse ? pos : pos + 1);
+        iv.end = std::max(iv.end, isDef ? pos + 1 : pos);
+        iv.spillCost += freq;
+      });
+      if (inst.isCopy()) {
+        Reg src = inst.ops[0].reg, dst = inst.ops[1].reg;
+        if (isVirtReg(dst))
+          hints_[dst - kFirstVirtReg] = src;
+        if (isVirtReg(src) && hints_[src - kFirstVirtReg] == kNoReg)
+          hints_[src - kFirstVirtReg] = dst;
+      }
+    }
+  }
+}
+
+void LinearScan::buildFixedRanges() {
+  fixed_.assign(kNumPhysRegs, {});
+  uint32_t index = 0;
+  for (const auto &bb : mf_.blocks()) {
+    // Physical registers never live across blocks, except for the
+    // arguments at the function entry.
+    int64_t open[kNumPhysRegs];
+    uint32_t last[kNumPhysRegs];
+    std::fill(std::begin(open), std::end(open), -1);
+    auto close = [&](Reg r) {
+      if (open[r] >= 0)
+        fixed_[r].push_back({uint32_t(open[r]), last[r]});
+      open[r] = -1;
+    };
+    for (MInst &inst : bb->insts()) {
+      uint32_t pos = 2 * index++;
+      forEachReg(inst, [&](Reg &r, bool isUse, bool) {
+        if (!isUse || !isPhysReg(r))
+          return;
+        if (open[r] < 0)
+          open[r] = blockStart_[bb->getNumber()];
+        last[r] = pos;
+      });
+      forEachReg(inst, [&](Reg &r, bool, bool isDef) {
+        if (!isDef || !isPhysReg(r))
+          return;
+        close(r);
+        open[r] = pos + 1;
+        last[r] = pos + 1;
+      });
+    }
+    for (Reg r = 0; r < kNumPhysRegs; ++r)
+      close(r);
+  }
+}
+
+bool LinearScan::isBlocked(Reg phys, const Interval &iv) const {
+  const auto &ranges = fixed_[phys];
+  auto it = std::lower_bound(
+      ranges.begin(), ranges.end(), iv.start,
+      [](const std::pair<uint32_t, uint32_t> &r, uint32_t pos) {
+        return r.second < pos;
+      });
+  return it != ranges.end() && it->first <= iv.end;
+}
+
+void LinearScan::allocate() {
+  std::vector<Interval *> order;
+  for (Interval &iv : intervals_)
+    if (iv.start <= iv.end)
+      order.push_back(&iv);
+  std::sort(order.begin(), order.end(), [](Interval *a, Interval *b) {
+    return a->start != b->start ? a->start < b->start : a->vreg < b->vreg;
+  });
+
+  std::vector<Interval *> active;
+  for (Interval *cur : order) {
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [&](Interval *iv) {
+                                  return iv->end < cur->start;
+                                }),
+                 active.end());
+    auto isFree = [&](Reg r) {
+      if (r == kNoReg || isBlocked(r, *cur))
+        return false;
+      return std::none_of(active.begin(), active.end(),
+                          [&](Interval *iv) { return iv->assigned == r; });
+    };
+
+    Reg hint = physFor(hints_[cur->vreg - kFirstVirtReg]);
+    Reg chosen = kNoReg;
+    if (hint != kNoReg &&
+        std::find(std::begin(kAllocatable), std::end(kAllocatable), hint) !=
+            std::end(kAllocatable) &&
+        isFree(hint))
+      chosen = hint;
+    for (unsigned i = 0; chosen == kNoReg && i < std::size(kAllocatable); ++i)
+      if (isFree(kAllocatable[i]))
+        chosen = kAllocatable[i];
+    if (chosen != kNoReg) {
+      cur->assigned = chosen;
+      active.push_back(cur);
+      continue;
+    }
+
+    // Nothing is free: spill whichever of the current interval and the
+    // active ones it could take the register of is cheapest per position.
+    Interval *victim = nullptr;
+    for (Interval *iv : active)
+      if (!isBlocked(iv->assigned, *cur) &&
+          (!victim || iv->weight() < victim->weight()))
+        victim = iv;
+    if (victim && victim->weight() < cur->weight()) {
+      cur->assigned = victim->assigned;
+      victim->assigned = kNoReg;
+      victim->spilled = true;
+      std::replace(active.begin(), active.end(), victim, cur);
+    } else {
+      cur->spilled = true;
+    }
+  }
+}
+
+void LinearScan::rewrite(MInst inst, std::vector<MInst> &out) {
+  auto slot = [&](Reg vreg) {
+    int &fi = spillSlots_[vreg - kFirstVirtReg];
+    if (fi < 0)
+      fi = mf_.createFrameObject(8, 8);
+    return MOperand::makeFrame(fi);
+  };
+  auto isSpilled = [&](Reg r) {
+    return isVirtReg(r) && intervals_[r - kFirstVirtReg].spilled;
+  };
+
+  // Copies from or to the stack need no scratch register.
+  if (inst.isCopy() && (isSpilled(inst.ops[0].reg) ||
+                        isSpilled(inst.ops[1].reg))) {
+    Reg src = inst.ops[0].reg, dst = inst.ops[1].reg;
+    if (!isSpilled(src)) {
+      out.push_back(MInst(MOpcode::Mov, 8, MOperand::makeReg(physFor(src)),
+                          slot(dst)));
+    } else if (!isSpilled(dst)) {
+      out.push_back(MInst(MOpcode::Mov, inst.size, slot(src),
+                          MOperand::makeReg(physFor(dst))));
+    } else if (src != dst) {
+      out.push_back(MInst(MOpcode::Mov, 8, slot(src), MOperand::makeReg(R10)));
+      out.push_back(MInst(MOpcode::Mov, 8, MOperand::makeReg(R10), slot(dst)));
+    }
+    return;
+  }
+  if (inst.opcode == MOpcode::Mov && inst.ops[0].isImm() &&
+      inst.ops[1].isReg() && isSpilled(inst.ops[1].reg)) {
+    out.push_back(MInst(MOpcode::Mov, inst.size, inst.ops[0],
+                        slot(inst.ops[1].reg)));
+    return;
+  }
+
+  // Otherwise spilled registers are loaded into scratch registers before
+  // the instruction and stored back after it.
+  struct Spill {
+    Reg vreg;
+    Reg scratch;
+    bool used = false;
+    bool defined = false;
+  };
+  std::vector<Spill> spills;
+  forEachReg(inst, [&](Reg &r, bool isUse, bool isDef) {
+    if (!isSpilled(r))
+      return;
+    auto it = std::find_if(spills.begin(), spills.end(),
+                           [&](const Spill &s) { return s.vreg == r; });
+    if (it == spills.end())
+      it = spills.insert(spills.end(), {r, kNoReg});
+    it->used |= isUse;
+    it->defined |= isDef;
+  });
+
+  // Only a store to a base-plus-index address can involve three spilled
+  // registers; the address is then formed in the first scratch register.
+  if (spills.size() > 2) {
+    for (MOperand &op : inst.ops) {
+      if (!op.isMem() || !isSpilled(op.reg) || !isSpilled(op.index))
+        continue;
+      out.push_back(
+          MInst(MOpcode::Mov, 8, slot(op.reg), MOperand::makeReg(R10)));
+      out.push_back(
+          MInst(MOpcode::Mov, 8, slot(op.index), MOperand::makeReg(R11)));
+      MOperand addr = MOperand::makeMem(R10);
+      addr.index = R11;
+      addr.scale = op.scale;
+      out.push_back(MInst(MOpcode::Lea, 8, addr, MOperand::makeReg(R10)));
+      Reg base = op.reg, index = op.index;
+      op.reg = R10;
+      op.index = kNoReg;
+      spills.erase(std::remove_if(spills.begin(), spills.end(),
+                                  [&](const Spill &s) {
+                                    return s.vreg == base || s.vreg == index;
+                                  }),
+                   spills.end());
+      spills.front().scratch = R11;
+      break;
+    }
+  } else {
+    for (unsigned i = 0; i < spills.size(); ++i)
+      spills[i].scratch = kScratch[i];
+  }
+
+  for (const Spill &s : spills)
+    if (s.used)
+      out.push_back(
+          MInst(MOpcode::Mov, 8, slot(s.vreg), MOperand::makeReg(s.scratch)));
+  forEachReg(inst, [&](Reg &r, bool, bool) {
+    if (!isVirtReg(r))
+      return;
+    if (isSpilled(r)) {
+      for (const Spill &s : spills)
+        if (s.vreg == r)
+          r = s.scratch;
+    } else {
+      r = physFor(r);
+    }
+  });
+  if (inst.isCopy() && inst.ops[0].reg == inst.ops[1].reg)
+    return;
+  out.push_back(inst);
+  for (const Spill &s : spills)
+    if (s.defined)
+      out.push_back(
+          MInst(MOpcode::Mov, 8, MOperand::makeReg(s.scratch), slot(s.vreg)));
+}
+
+void LinearScan::rewrite() {
+  spillSlots_.assign(mf_.getNumVRegs(), -1);
+  for (const auto &bb : mf_.blocks()) {
+    std::vector<MInst> out;
+    out.reserve(bb->insts().size());
+    for (const MInst &inst : bb->insts())
+      rewrite(inst, out);
+    bb->insts() = std::move(out);
+  }
+}
+
+// The frame below the return address: the saved %rbp (which %rbp points
+// to), the callee-saved registers, the frame objects, and the outgoing
+// stack arguments at the bottom, with %rsp 16-byte aligned at calls.
+void LinearScan::layoutFrame() {
+  for (Reg r : kAllocatable) {
+    bool used = std::any_of(intervals_.begin(), intervals_.end(),
+                            [&](const Interval &iv) {
+                              return !iv.spilled && iv.assigned == r;
+                            });
+    if (used && isCalleeSaved(r))
+      mf_.calleeSavedRegs.push_back(r);
+  }
+  uint32_t saved = 8 * mf_.calleeSavedRegs.size();
+  uint64_t offset = saved;
+  for (FrameObject &obj : mf_.frameObjects()) {
+    offset = (offset + obj.size + obj.align - 1) / obj.align * obj.align;
+    obj.offset = -int64_t(offset);
+  }
+  uint64_t total = (offset + mf_.outgoingArgSize + 15) / 16 * 16;
+  mf_.frameSize = total - saved;
+}
+
+void LinearScan::run() {
+  computeLiveness();
+  buildIntervals();
+  buildFixedRanges();
+  allocate();
+  rewrite();
+  layoutFrame();
+}
+
+} // namespace
+
+void allocateRegisters(MFunction &mf) { LinearScan(mf).run(); }
@@ -0,0 +1,365 @@
+#include "Passes.h"
+#include "TransformUtils.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+
+// Sparse conditional constant propagation (Wegman & Zadeck). Values start
+// out unknown and only move down the lattice unknown -> constant ->
+// overdefined; blocks are only considered once an edge into them has been
+// found to be executable. Loads from constant globals at constant indices
+// are folded to the element they read.
+class SCCPSolver {
+public:
+  explicit SCCPSolver(Function &f) : f_(f) {}
+
+  bool run();
+
+private:
+  struct LatticeVal {
+    enum State : uint8_t { Unknown, Constant, Overdefined };
+    State state = Unknown;
+    int32_t value = 0;
+  };
+
+  LatticeVal getValue(Value *v) {
+    if (auto *c = dyn_cast<ConstantInt>(v))
+      return {LatticeVal::Constant, c->getValue()};
+    if (auto *inst = dyn_cast<Instruction>(v))
+      return values_[inst->aux];
+    return {LatticeVal::Overdefined, 0};
+  }
+  void markConstant(Instruction *inst, int32_t c) {
+    LatticeVal &lv = values_[inst->aux];
+    if (lv.state == LatticeVal::Constant && lv.value == c)
+      return;
+    if (lv.state == LatticeVal::Overdefined)
+      return;
+    // A value can only move down the lattice; a second, different constant
+    // means overdefined.
+    if (lv.state == LatticeVal::Constant) {
+      markOverdefined(inst);
+      return;
+    }
+    lv = {LatticeVal::Constant, c};
+    ssaWork_.push_back(inst);
+  }
+  void markOverdefined(Instruction *inst) {
+    LatticeVal &lv = values_[inst->aux];
+    if (lv.state == LatticeVal::Overdefined)
+      return;
+    lv.state = LatticeVal::Overdefined;
+    ssaWork_.push_back(inst);
+  }
+  bool isEdgeFeasible(BasicBlock *from, BasicBlock *to) const {
+    return feasibleEdges_.count(edgeKey(from, to)) != 0;
+  }
+  uint64_t edgeKey(BasicBlock *from, BasicBlock *to) const {
+    return static_cast<uint64_t>(from->getNumber()) * numBlocks_ +
+           to->getNumber();
+  }
+
+  void markEdgeFeasible(BasicBlock *from, BasicBlock *to);
+  void solve();
+  // Forces the conditions of branches still waiting on unknown values to
+  // overdefined. Returns true if that happened.
+  bool resolveUnknownBranches();
+  void visit(Instruction *inst);
+  void visitPhi(PhiInst *phi);
+  void visitBinary(BinaryInst *bi);
+  void visitGEP(GetElementPtrInst *gep);
+  void visitLoad(LoadInst *li);
+  void visitBranch(BranchInst *br);
+  // Flat i32 element index that a constant GEP chain adds to its global.
+  int64_t getConstantIndex(Value *ptr);
+  bool rewrite();
+
+  Function &f_;
+  unsigned numBlocks_ = 0;
+  std::vector<LatticeVal> values_;
+  std::vector<bool> executable_;
+  std::unordered_set<uint64_t> feasibleEdges_;
+  std::vector<BasicBlock *> blockWork_;
+  std::vector<Instruction *> ssaWork_;
+};
+
+void SCCPSolver::markEdgeFeasible(BasicBlock *from, BasicBlock *to) {
+  if (!feasibleEdges_.insert(edgeKey(from, to)).second)
+    return;
+  if (!executable_[to->getNumber()]) {
+    executable_[to->getNumber()] = true;
+    blockWork_.push_back(to);
+    return;
+  }
+  // The block was already visited; only its phis see the new edge.
+  for (Instruction *inst : *to) {
+    auto *phi = dyn_cast<PhiInst>(inst);
+    if (!phi)
+      break;
+    visitPhi(phi);
+  }
+}
+
+void SCCPSolver::solve() {
+  while (!blockWork_.empty() || !ssaWork_.empty()) {
+    while (!ssaWork_.empty()) {
+      Instruction *inst = ssaWork_.back();
+      ssaWork_.pop_back();
+      for (Use *u = inst->getFirstUse(); u; u = u->getNext()) {
+        auto *user = cast<Instruction>(u->getUser());
+        if (executable_[user->getParent()->getNumber()])
+          visit(user);
+      }
+    }
+    while (!blockWork_.empty()) {
+      BasicBlock *bb = blockWork_.back();
+      blockWork_.pop_back();
+      for (Instruction *inst : *bb)
+        visit(inst);
+    }
+  }
+}
+
+bool SCCPSolver::resolveUnknownBranches() {
+  bool changed = false;
+  for (BasicBlock *bb : f_) {
+    if (!executable_[bb->getNumber()])
+      continue;
+    auto *br = dyn_cast<BranchInst>(bb->getTerminator());
+    if (!br || !br->isConditional())
+      continue;
+    auto *cond = dyn_cast<Instruction>(br->getCondition());
+    if (cond && values_[cond->aux].state == LatticeVal::Unknown) {
+      markOverdefined(cond);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+void SCCPSolver::visit(Instruction *inst) {
+  switch (inst->getKind()) {
+  case Value::Kind::Phi:
+    visitPhi(cast<PhiInst>(inst));
+    break;
+  case Value::Kind::Binary:
+    visitBinary(cast<BinaryInst>(inst));
+    break;
+  case Value::Kind::ICmp: {
+    auto *ci = cast<ICmpInst>(inst);
+    LatticeVal l = getValue(ci->getLHS()), r = getValue(ci->getRHS());
+    if (l.state == LatticeVal::Overdefined || r.state == LatticeVal::Overdefined)
+      markOverdefined(ci);
+    else if (l.state == LatticeVal::Constant && r.state == LatticeVal::Constant)
+      markConstant(ci, ICmpInst::fold(ci->getPredicate(), l.value, r.value));
+    break;
+  }
+  case Value::Kind::Cast: {
+    auto *ci = cast<CastInst>(inst);
+    LatticeVal v = getValue(ci->getOperand(0));
+    if (ci->getOpcode() != CastInst::ZExt || v.state == LatticeVal::Overdefined)
+      markOverdefined(ci);
+    else if (v.state == LatticeVal::Constant)
+      markConstant(ci, v.value);
+    break;
+  }
+  case Value::Kind::GEP:
+    visitGEP(cast<GetElementPtrInst>(inst));
+    break;
+  case Value::Kind::Load:
+    visitLoad(cast<LoadInst>(inst));
+    break;
+  case Value::Kind::Br:
+    visitBranch(cast<BranchInst>(inst));
+    break;
+  case Value::Kind::Store:
+  case Value::Kind::Ret:
+    break;
+  default:
+    markOverdefined(inst);
+    break;
+  }
+}
+
+void SCCPSolver::visitPhi(PhiInst *phi) {
+  if (values_[phi->aux].state == LatticeVal::Overdefined)
+    return;
+  BasicBlock *bb = phi->getParent();
+  for (unsigned i = 0; i < phi->getNumIncoming(); ++i) {
+    if (!isEdgeFeasible(phi->getIncomingBlock(i), bb))
+      continue;
+    LatticeVal v = getValue(phi->getIncomingValue(i));
+    if (v.state == LatticeVal::Unknown)
+      continue;
+    if (v.state == LatticeVal::Overdefined) {
+      markOverdefined(phi);
+      return;
+    }
+    markConstant(phi, v.value);
+    if (values_[phi->aux].state == LatticeVal::Overdefined)
+      return;
+  }
+}
+
+void SCCPSolver::visitBinary(BinaryInst *bi) {
+  LatticeVal l = getValue(bi->getLHS()), r = getValue(bi->getRHS());
+  // x * 0 and x & 0 are zero whatever x is.
+  BinaryInst::Opcode op = bi->getOpcode();
+  if (op == BinaryInst::Mul || op == BinaryInst::And) {
+    if ((l.state == LatticeVal::Constant && l.value == 0) ||
+        (r.state == LatticeVal::Constant && r.value == 0)) {
+      markConstant(bi, 0);
+      return;
+    }
+  }
+  if (l.state == LatticeVal::Overdefined || r.state == LatticeVal::Overdefined) {
+    markOverdefined(bi);
+    return;
+  }
+  if (l.state != LatticeVal::Constant || r.state != LatticeVal::Constant)
+    return;
+  int32_t result;
+  if (BinaryInst::fold(op, l.value, r.value, result))
+    markConstant(bi, result);
+  else
+    markOverdefined(bi);
+}
+
+void SCCPSolver::visitGEP(GetElementPtrInst *gep) {
+  // A GEP is "constant" when it computes a fixed address inside a global;
+  // its lattice value carries no number.
+  LatticeVal::State state = LatticeVal::Constant;
+  Value *base = gep->getPointerOperand();
+  if (auto *inner = dyn_cast<GetElementPtrInst>(base))
+    state = values_[inner->aux].state;
+  else if (!isa<GlobalVariable>(base))
+    state = LatticeVal::Overdefined;
+  for (unsigned i = 0; i < gep->getNumIndices(); ++i)
+    state = std::max(state, getValue(gep->getIndex(i)).state);
+  if (state == LatticeVal::Overdefined)
+    markOverdefined(gep);
+  else if (state == LatticeVal::Constant)
+    markConstant(gep, 0);
+}
+
+int64_t SCCPSolver::getConstantIndex(Value *ptr) {
+  auto *gep = dyn_cast<GetElementPtrInst>(ptr);
+  if (!gep)
+    return 0;
+  int64_t index = getConstantIndex(gep->getPointerOperand());
+  Type *t = gep->getSourceElementType();
+  for (unsigned i = 0; i < gep->getNumIndices(); ++i) {
+    if (i > 0)
+      t = cast<ArrayType>(t)->getElementType();
+    index += static_cast<int64_t>(getValue(gep->getIndex(i)).value) *
+             (t->getSizeInBytes() / 4);
+  }
+  return index;
+}
+
+void SCCPSolver::visitLoad(LoadInst *li) {
+  Value *ptr = li->getPointerOperand();
+  LatticeVal::State state = LatticeVal::Overdefined;
+  GlobalVariable *gv = nullptr;
+  if (auto *gep = dyn_cast<GetElementPtrInst>(ptr)) {
+    state = values_[gep->aux].state;
+    Value *base = gep;
+    while (auto *inner = dyn_cast<GetElementPtrInst>(base))
+      base = inner->getPointerOperand();
+    gv = dyn_cast<GlobalVariable>(base);
+  } else if ((gv = dyn_cast<GlobalVariable>(ptr))) {
+    state = LatticeVal::Constant;
+  }
+  if (state == LatticeVal::Unknown)
+    return;
+  if (state == LatticeVal::Overdefined || !gv || !gv->isConstant() ||
+      !li->getType()->isIntegerTy(32)) {
+    markOverdefined(li);
+    return;
+  }
+  int64_t index = getConstantIndex(ptr);
+  int64_t numElements = gv->getValueType()->getSizeInBytes() / 4;
+  if (index < 0 || index >= numElements) {
+    markOverdefined(li);
+    return;
+  }
+  markConstant(li, gv->getInitialElement(index));
+}
+
+void SCCPSolver::visitBranch(BranchInst *br) {
+  BasicBlock *bb = br->getParent();
+  if (!br->isConditional()) {
+    markEdgeFeasible(bb, br->getSuccessor(0));
+    return;
+  }
+  LatticeVal cond = getValue(br->getCondition());
+  if (cond.state == LatticeVal::Unknown)
+    return;
+  if (cond.state == LatticeVal::Constant) {
+    markEdgeFeasible(bb, br->getSuccessor(cond.value ? 0 : 1));
+    return;
+  }
+  markEdgeFeasible(bb, br->getSuccessor(0));
+  markEdgeFeasible(bb, br->getSuccessor(1));
+}
+
+bool SCCPSolver::rewrite() {
+  bool changed = false;
+  for (BasicBlock *bb : f_) {
+    if (!executable_[bb->getNumber()])
+      continue;
+    for (Instruction *inst : *bb) {
+      if (inst->getType()->isVoidTy() || !inst->hasUses())
+        continue;
+      LatticeVal v = values_[inst->aux];
+      if (v.state != LatticeVal::Constant ||
+          !isa<IntegerType>(inst->getType()))
+        continue;
+      inst->replaceAllUsesWith(
+          f_.getConstantInt(cast<IntegerType>(inst->getType()), v.value));
+      changed = true;
+      if (isInstructionTriviallyDead(inst))
+        inst->eraseFromParent();
+    }
+  }
+  // Fold the branches whose outcome is known; the blocks behind the
+  // infeasible edges are unreachable afterwards.
+  for (BasicBlock *bb : f_) {
+    if (!executable_[bb->getNumber()])
+      continue;
+    auto *br = dyn_cast<BranchInst>(bb->getTerminator());
+    if (!br || !br->isConditional())
+      continue;
+    bool toTrue = isEdgeFeasible(bb, br->getSuccessor(0));
+    bool toFalse = isEdgeFeasible(bb, br->getSuccessor(1));
+    if (toTrue && toFalse)
+      continue;
+    foldBranchTo(bb, br->getSuccessor(toTrue ? 0 : 1));
+    changed = true;
+  }
+  changed |= removeUnreachableBlocks(f_);
+  return changed;
+}
+
+bool SCCPSolver::run() {
+  numBlocks_ = f_.renumberBlocks();
+  unsigned numInsts = 0;
+  for (BasicBlock *bb : f_)
+    for (Instruction *inst : *bb)
+      inst->aux = numInsts++;
+  values_.assign(numInsts, {});
+  executable_.assign(numBlocks_, false);
+
+  executable_[0] = true;
+  blockWork_.push_back(f_.getEntryBlock());
+  do
+    solve();
+  while (resolveUnknownBranches());
+  return rewrite();
+}
+
+} // namespace
+
+bool runSCCP(Function &f) { return SCCPSolver(f).run(); }
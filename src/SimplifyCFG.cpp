@@ -0,0 +1,97 @@
+#include "Passes.h"
+#include "TransformUtils.h"
+
+#include <vector>
+
+namespace {
+
+// Folds a conditional branch whose condition is constant or whose targets
+// are the same block.
+bool foldConditionalBranch(BasicBlock *bb) {
+  auto *br = dyn_cast<BranchInst>(bb->getTerminator());
+  if (!br || !br->isConditional())
+    return false;
+  if (auto *c = dyn_cast<ConstantInt>(br->getCondition())) {
+    foldBranchTo(bb, br->getSuccessor(c->isZero() ? 1 : 0));
+    return true;
+  }
+  if (br->getSuccessor(0) == br->getSuccessor(1)) {
+    foldBranchTo(bb, br->getSuccessor(0));
+    return true;
+  }
+  return false;
+}
+
+// Merges `bb` into its predecessor if that is the only way into `bb` and
+// `bb` is the only way out of it.
+bool mergeIntoPredecessor(BasicBlock *bb) {
+  BasicBlock *pred = bb->getSinglePredecessor();
+  if (!pred || pred == bb || pred->getSingleSuccessor() != bb)
+    return false;
+  while (auto *phi = dyn_cast<PhiInst>(bb->front())) {
+    phi->replaceAllUsesWith(phi->getIncomingValue(0));
+    phi->eraseFromParent();
+  }
+  pred->getTerminator()->eraseFromParent();
+  for (Instruction *inst : *bb) {
+    inst->removeFromParent();
+    pred->push_back(inst);
+  }
+  for (BasicBlock *succ : pred->successors())
+    succ->replacePhiUsesWith(bb, pred);
+  bb->eraseFromParent();
+  return true;
+}
+
+// Sends the predecessors of a block that only jumps on to its successor
+// straight to that successor, and deletes the block.
+bool forwardEmptyBlock(BasicBlock *bb) {
+  BasicBlock *succ = bb->getSingleSuccessor();
+  if (!succ || succ == bb || bb->front() != bb->getTerminator() ||
+      bb == bb->getParent()->getEntryBlock())
+    return false;
+  std::vector<BasicBlock *> preds = bb->predecessors();
+  bool succHasPhis = isa<PhiInst>(succ->front());
+  if (succHasPhis) {
+    // A predecessor that already reaches `succ` directly might need a
+    // different phi value on each of its edges.
+    for (BasicBlock *pred : preds)
+      for (BasicBlock *s : pred->successors())
+        if (s == succ)
+          return false;
+    Arena &arena = bb->getParent()->getArena();
+    for (Instruction *inst : *succ) {
+      auto *phi = dyn_cast<PhiInst>(inst);
+      if (!phi)
+        break;
+      int idx = phi->getBasicBlockIndex(bb);
+      Value *v = phi->getIncomingValue(idx);
+      phi->removeIncoming(idx);
+      for (BasicBlock *pred : preds)
+        phi->addIncoming(arena, v, pred);
+    }
+  }
+  for (Use *u : bb->uses())
+    u->set(succ);
+  bb->eraseFromParent();
+  return true;
+}
+
+} // namespace
+
+bool runSimplifyCFG(Function &f) {
+  bool changed = false;
+  for (bool again = true; again;) {
+    again = removeUnreachableBlocks(f);
+    for (BasicBlock *bb : f) {
+      again |= foldConditionalBranch(bb);
+      if (bb != f.getEntryBlock() && mergeIntoPredecessor(bb)) {
+        again = true;
+        continue;
+      }
+      again |= forwardEmptyBlock(bb);
+    }
+    changed |= again;
+  }
+  return changed;
+}
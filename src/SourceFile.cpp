@@ -0,0 +1,45 @@
+#include "SourceFile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceFile::~SourceFile() {
+  if (mapped_)
+    munmap(const_cast<char *>(data_), size_);
+}
+
+bool SourceFile::open(const char *path, std::string &error) {
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    error = std::string("cannot open ") + path + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    error = std::string("cannot stat ") + path + ": " + std::strerror(errno);
+    ::close(fd);
+    return false;
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ == 0) {
+    // mmap rejects empty mappings; an empty view is all we need.
+    ::close(fd);
+    data_ = "";
+    return true;
+  }
+  void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    error = std::string("cannot map ") + path + ": " + std::strerror(errno);
+    size_ = 0;
+    return false;
+  }
+  madvise(p, size_, MADV_SEQUENTIAL);
+  data_ = static_cast<const char *>(p);
+  mapped_ = true;
+  return true;
+}
@@ -0,0 +1,88 @@
+#include "Passes.h"
+#include "TransformUtils.h"
+
+#include <vector>
+
+namespace {
+
+// Whether `call` is a self call whose result, if any, is returned right
+// away.
+bool isTailSelfCall(const CallInst *call, const Function &f) {
+  if (call->getCallee() != &f)
+    return false;
+  auto *ret = dyn_cast<RetInst>(call->getNextNode());
+  if (!ret)
+    return false;
+  if (call->getType()->isVoidTy())
+    return true;
+  return ret->getReturnValue() == call && call->hasOneUse();
+}
+
+// A pointer into one of the function's own allocas would refer to the
+// wrong frame once the frames are merged.
+bool passesLocalMemory(const CallInst *call) {
+  for (unsigned i = 0; i < call->getNumArgs(); ++i)
+    if (call->getArg(i)->getType()->isPointerTy() &&
+        isa<AllocaInst>(getUnderlyingObject(call->getArg(i))))
+      return true;
+  return false;
+}
+
+} // namespace
+
+// Turns `return f(args)` inside f into a jump back to the start of the
+// function. Each argument is replaced by a phi in the loop header that
+// receives the call's operands on the back edges.
+bool runTailRecursionElimination(Function &f) {
+  std::vector<CallInst *> tailCalls;
+  for (BasicBlock *bb : f) {
+    auto *ret = dyn_cast<RetInst>(bb->getTerminator());
+    if (!ret || !ret->getPrevNode())
+      continue;
+    auto *call = dyn_cast<CallInst>(ret->getPrevNode());
+    if (call && isTailSelfCall(call, f) && !passesLocalMemory(call))
+      tailCalls.push_back(call);
+  }
+  if (tailCalls.empty())
+    return false;
+
+  // The entry block keeps the allocas, which must not run again, and the
+  // rest of it becomes the loop header. Splitting rather than adding a new
+  // entry block keeps the function's first block in place.
+  Arena &arena = f.getArena();
+  BasicBlock *entry = f.getEntryBlock();
+  Instruction *body = nullptr;
+  for (Instruction *inst : *entry) {
+    if (!isa<AllocaInst>(inst)) {
+      if (!body)
+        body = inst;
+    } else if (body) {
+      inst->moveBefore(body);
+    }
+  }
+  BasicBlock *header = entry->splitAt(body, "tailrecurse");
+  entry->push_back(arena.create<BranchInst>(arena, header));
+
+  std::vector<PhiInst *> args;
+  Instruction *first = header->front();
+  for (unsigned i = 0; i < f.getNumArgs(); ++i) {
+    Argument *arg = f.getArg(i);
+    auto *phi = arena.create<PhiInst>(arena, arg->getType(),
+                                      tailCalls.size() + 1);
+    phi->setName(arg->getName());
+    arg->replaceAllUsesWith(phi);
+    phi->addIncoming(arena, arg, entry);
+    phi->insertBefore(first);
+    args.push_back(phi);
+  }
+
+  for (CallInst *call : tailCalls) {
+    BasicBlock *bb = call->getParent();
+    for (unsigned i = 0; i < call->getNumArgs(); ++i)
+      args[i]->addIncoming(arena, call->getArg(i), bb);
+    bb->getTerminator()->eraseFromParent();
+    call->eraseFromParent();
+    bb->push_back(arena.create<BranchInst>(arena, header));
+  }
+  return true;
+}
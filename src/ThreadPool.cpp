@@ -0,0 +1,120 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace {
+
+// The pool the current thread works for, and its index there.
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local int currentIndex = -1;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threads) {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 1; i < threads; ++i)
+    queues_.push_back(std::make_unique<Worker>());
+  for (unsigned i = 1; i < threads; ++i)
+    workers_.emplace_back([this, i] { workerLoop(i - 1); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread &t : workers_)
+    t.join();
+}
+
+void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)> &fn) {
+  if (workers_.empty() || n <= 1) {
+    for (size_t i = 0; i < n; ++i)
+      fn(i);
+    return;
+  }
+  int self = currentPool == this ? currentIndex : -1;
+  std::atomic<size_t> pending{n};
+  {
+    unsigned target = self >= 0 ? self : nextQueue_++ % queues_.size();
+    Worker &w = *queues_[target];
+    std::lock_guard<std::mutex> lock(w.mutex);
+    // The owner pops from the back, so it starts with index 0 while thieves
+    // take the highest indices.
+    for (size_t i = n; i-- > 0;)
+      w.tasks.push_back({&fn, i, &pending});
+    queued_ += n;
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+    wake_.notify_all();
+  }
+
+  while (pending.load(std::memory_order_acquire) > 0) {
+    if (runOne(self))
+      continue;
+    std::unique_lock<std::mutex> lock(sleepMutex_);
+    wake_.wait(lock, [&] {
+      return pending.load(std::memory_order_acquire) == 0 || queued_ > 0;
+    });
+  }
+}
+
+bool ThreadPool::steal(unsigned victim, Task &task) {
+  Worker &w = *queues_[victim];
+  std::lock_guard<std::mutex> lock(w.mutex);
+  if (w.tasks.empty())
+    return false;
+  task = w.tasks.front();
+  w.tasks.pop_front();
+  --queued_;
+  return true;
+}
+
+bool ThreadPool::runOne(int self) {
+  Task task;
+  bool found = false;
+  if (self >= 0) {
+    Worker &w = *queues_[self];
+    std::lock_guard<std::mutex> lock(w.mutex);
+    if (!w.tasks.empty()) {
+      task = w.tasks.back();
+      w.tasks.pop_back();
+      --queued_;
+      found = true;
+    }
+  }
+  unsigned n = queues_.size();
+  unsigned start = self >= 0 ? self + 1 : 0;
+  for (unsigned k = 0; k < n && !found; ++k) {
+    unsigned victim = (start + k) % n;
+    if (static_cast<int>(victim) != self)
+      found = steal(victim, task);
+  }
+  if (!found)
+    return false;
+
+  (*task.fn)(task.index);
+  // The waiting thread may return (and free `pending`) as soon as this
+  // reaches zero, so `task` must not be touched afterwards.
+  if (task.pending->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+    wake_.notify_all();
+  }
+  return true;
+}
+
+void ThreadPool::workerLoop(unsigned self) {
+  currentPool = this;
+  currentIndex = static_cast<int>(self);
+  for (;;) {
+    if (runOne(self))
+      continue;
+    std::unique_lock<std::mutex> lock(sleepMutex_);
+    wake_.wait(lock, [&] { return stop_ || queued_ > 0; });
+    if (stop_)
+      return;
+  }
+}
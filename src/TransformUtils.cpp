@@ -0,0 +1,169 @@
+#include "TransformUtils.h"
+#include "LoopInfo.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+bool isInstructionTriviallyDead(const Instruction *inst) {
+  return !inst->hasUses() && !inst->mayHaveSideEffects();
+}
+
+bool recursivelyDeleteTriviallyDeadInstructions(Instruction *inst) {
+  if (!inst->getParent() || !isInstructionTriviallyDead(inst))
+    return false;
+  std::vector<Instruction *> work{inst};
+  while (!work.empty()) {
+    Instruction *i = work.back();
+    work.pop_back();
+    std::vector<Instruction *> ops;
+    for (Use *u = i->op_begin(); u != i->op_end(); ++u)
+      if (auto *op = dyn_cast<Instruction>(u->get()))
+        ops.push_back(op);
+    i->eraseFromParent();
+    for (Instruction *op : ops)
+      if (op->getParent() && isInstructionTriviallyDead(op))
+        work.push_back(op);
+  }
+  return true;
+}
+
+bool removeUnreachableBlocks(Function &f) {
+  unsigned n = f.renumberBlocks();
+  std::vector<bool> reachable(n, false);
+  std::vector<BasicBlock *> work{f.getEntryBlock()};
+  reachable[0] = true;
+  while (!work.empty()) {
+    BasicBlock *bb = work.back();
+    work.pop_back();
+    unsigned numSuccs = bb->getNumSuccessors();
+    for (unsigned i = 0; i < numSuccs; ++i) {
+      BasicBlock *succ = bb->getSuccessor(i);
+      if (!reachable[succ->getNumber()]) {
+        reachable[succ->getNumber()] = true;
+        work.push_back(succ);
+      }
+    }
+  }
+
+  std::vector<BasicBlock *> dead;
+  for (BasicBlock *bb : f) {
+    if (reachable[bb->getNumber()])
+      continue;
+    dead.push_back(bb);
+    unsigned numSuccs = bb->getNumSuccessors();
+    for (unsigned i = 0; i < numSuccs; ++i) {
+      BasicBlock *succ = bb->getSuccessor(i);
+      if (reachable[succ->getNumber()])
+        succ->removePredecessor(bb);
+    }
+  }
+  if (dead.empty())
+    return false;
+  // Dead blocks may refer to each other, so drop every reference first.
+  for (BasicBlock *bb : dead)
+    for (Instruction *inst : *bb)
+      inst->dropAllReferences();
+  for (BasicBlock *bb : dead)
+    bb->eraseFromParent();
+  return true;
+}
+
+void foldBranchTo(BasicBlock *bb, BasicBlock *dest) {
+  auto *br = cast<BranchInst>(bb->getTerminator());
+  bool kept = false;
+  for (unsigned i = 0; i < br->getNumSuccessors(); ++i) {
+    BasicBlock *succ = br->getSuccessor(i);
+    if (succ == dest && !kept)
+      kept = true;
+    else
+      succ->removePredecessor(bb);
+  }
+  Value *cond = br->isConditional() ? br->getCondition() : nullptr;
+  Arena &arena = bb->getParent()->getArena();
+  arena.create<BranchInst>(arena, dest)->insertBefore(br);
+  br->eraseFromParent();
+  if (auto *inst = dyn_cast<Instruction>(cond))
+    recursivelyDeleteTriviallyDeadInstructions(inst);
+}
+
+bool formPreheaders(Function &f) {
+  // Unreachable predecessors would make a preheader impossible.
+  bool changed = removeUnreachableBlocks(f);
+  DominatorTree dt(f);
+  LoopInfo li(dt);
+  // Collect every header's outside predecessors before touching the CFG:
+  // new blocks have no number in the analyses.
+  std::vector<std::pair<BasicBlock *, std::vector<BasicBlock *>>> headers;
+  for (Loop *loop : li.getLoopsInPostOrder()) {
+    if (loop->getLoopPreheader())
+      continue;
+    std::vector<BasicBlock *> outside;
+    for (BasicBlock *pred : loop->getHeader()->predecessors())
+      if (!loop->contains(pred))
+        outside.push_back(pred);
+    headers.emplace_back(loop->getHeader(), std::move(outside));
+  }
+
+  Arena &arena = f.getArena();
+  for (auto &[header, outside] : headers) {
+    BasicBlock *preheader = f.createBlock("preheader", header);
+    auto isOutside = [&](BasicBlock *bb) {
+      return std::find(outside.begin(), outside.end(), bb) != outside.end();
+    };
+    // Outside entries of the header's phis merge in the preheader.
+    for (Instruction *inst : *header) {
+      auto *phi = dyn_cast<PhiInst>(inst);
+      if (!phi)
+        break;
+      auto *merged = arena.create<PhiInst>(arena, phi->getType(),
+                                           outside.size());
+      for (unsigned i = phi->getNumIncoming(); i-- > 0;) {
+        if (!isOutside(phi->getIncomingBlock(i)))
+          continue;
+        merged->addIncoming(arena, phi->getIncomingValue(i),
+                            phi->getIncomingBlock(i));
+        phi->removeIncoming(i);
+      }
+      Value *v = merged;
+      if (Value *same = merged->hasConstantValue()) {
+        merged->dropAllReferences();
+        v = same;
+      } else {
+        merged->setName(phi->getName());
+        preheader->push_back(merged);
+      }
+      phi->addIncoming(arena, v, preheader);
+    }
+    for (Use *u : header->uses())
+      if (isOutside(cast<Instruction>(u->getUser())->getParent()))
+        u->set(preheader);
+    preheader->push_back(arena.create<BranchInst>(arena, header));
+  }
+  return changed || !headers.empty();
+}
+
+Value *getUnderlyingObject(Value *ptr) {
+  for (;;) {
+    if (auto *gep = dyn_cast<GetElementPtrInst>(ptr))
+      ptr = gep->getPointerOperand();
+    else if (auto *cast = dyn_cast<CastInst>(ptr))
+      ptr = cast->getOperand(0);
+    else
+      return ptr;
+  }
+}
+
+bool mayAlias(Value *a, Value *b) {
+  if (a == b)
+    return true;
+  auto isIdentified = [](Value *v) {
+    return isa<AllocaInst>(v) || isa<GlobalVariable>(v);
+  };
+  if (isIdentified(a) && isIdentified(b))
+    return false;
+  if ((isa<AllocaInst>(a) && isa<Argument>(b)) ||
+      (isa<Argument>(a) && isa<AllocaInst>(b)))
+    return false;
+  return true;
+}
@@ -0,0 +1,163 @@
+#include "Type.h"
+
+#include <cassert>
+#include <map>
+#include <mutex>
+#include <utility>
+
+// Owns the interned types. Types are immortal, so nothing is ever erased.
+class TypeContext {
+public:
+  // Never destroyed, so that types stay valid during static destruction.
+  static TypeContext &get() {
+    static TypeContext *ctx = new TypeContext();
+    return *ctx;
+  }
+
+  Type *voidTy() { return &voidTy_; }
+  Type *labelTy() { return &labelTy_; }
+
+  IntegerType *intTy(unsigned bits) {
+    switch (bits) {
+    case 1:
+      return &i1_;
+    case 8:
+      return &i8_;
+    case 32:
+      return &i32_;
+    case 64:
+      return &i64_;
+    }
+    assert(false && "unsupported integer width");
+    return nullptr;
+  }
+
+  PointerType *pointerTo(Type *elem, std::atomic<PointerType *> &slot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PointerType *p = slot.load(std::memory_order_relaxed);
+    if (!p) {
+      p = new PointerType(elem);
+      slot.store(p, std::memory_order_release);
+    }
+    return p;
+  }
+
+  ArrayType *arrayOf(Type *elem, uint32_t n) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ArrayType *&slot = arrays_[{elem, n}];
+    if (!slot)
+      slot = new ArrayType(elem, n);
+    return slot;
+  }
+
+  FunctionType *functionOf(Type *ret, const std::vector<Type *> &params) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FunctionType *&slot = functions_[{ret, params}];
+    if (!slot)
+      slot = new FunctionType(ret, params);
+    return slot;
+  }
+
+private:
+  TypeContext()
+      : voidTy_(Type::VoidTyID), labelTy_(Type::LabelTyID), i1_(1), i8_(8),
+        i32_(32), i64_(64) {}
+
+  std::mutex mutex_;
+  Type voidTy_;
+  Type labelTy_;
+  IntegerType i1_, i8_, i32_, i64_;
+  std::map<std::pair<Type *, uint32_t>, ArrayType *> arrays_;
+  std::map<std::pair<Type *, std::vector<Type *>>, FunctionType *> functions_;
+};
+
+bool Type::isIntegerTy(unsigned bits) const {
+  return id_ == IntegerTyID &&
+         static_cast<const IntegerType *>(this)->getBitWidth() == bits;
+}
+
+Type *Type::getVoidTy() { return TypeContext::get().voidTy(); }
+Type *Type::getLabelTy() { return TypeContext::get().labelTy(); }
+IntegerType *Type::getInt1Ty() { return TypeContext::get().intTy(1); }
+IntegerType *Type::getInt8Ty() { return TypeContext::get().intTy(8); }
+IntegerType *Type::getInt32Ty() { return TypeContext::get().intTy(32); }
+IntegerType *Type::getInt64Ty() { return TypeContext::get().intTy(64); }
+
+PointerType *Type::getPointerTo() {
+  if (PointerType *p = pointerTo_.load(std::memory_order_acquire))
+    return p;
+  return TypeContext::get().pointerTo(this, pointerTo_);
+}
+
+IntegerType *IntegerType::get(unsigned bits) {
+  return TypeContext::get().intTy(bits);
+}
+
+ArrayType *ArrayType::get(Type *elem, uint32_t numElements) {
+  return TypeContext::get().arrayOf(elem, numElements);
+}
+
+FunctionType *FunctionType::get(Type *ret, const std::vector<Type *> &params) {
+  return TypeContext::get().functionOf(ret, params);
+}
+
+uint64_t Type::getSizeInBytes() const {
+  switch (id_) {
+  case IntegerTyID:
+    return (static_cast<const IntegerType *>(this)->getBitWidth() + 7) / 8;
+  case PointerTyID:
+    return 8;
+  case ArrayTyID: {
+    auto *a = static_cast<const ArrayType *>(this);
+    return a->getElementType()->getSizeInBytes() * a->getNumElements();
+  }
+  default:
+    return 0;
+  }
+}
+
+void Type::print(std::string &out) const {
+  switch (id_) {
+  case VoidTyID:
+    out += "void";
+    break;
+  case LabelTyID:
+    out += "label";
+    break;
+  case IntegerTyID:
+    out += 'i';
+    out += std::to_string(static_cast<const IntegerType *>(this)->getBitWidth());
+    break;
+  case PointerTyID:
+    static_cast<const PointerType *>(this)->getElementType()->print(out);
+    out += '*';
+    break;
+  case ArrayTyID: {
+    auto *a = static_cast<const ArrayType *>(this);
+    out += '[';
+    out += std::to_string(a->getNumElements());
+    out += " x ";
+    a->getElementType()->print(out);
+    out += ']';
+    break;
+  }
+  case FunctionTyID: {
+    auto *f = static_cast<const FunctionType *>(this);
+    f->getReturnType()->print(out);
+    out += " (";
+    for (unsigned i = 0; i < f->getNumParams(); ++i) {
+      if (i)
+        out += ", ";
+      f->getParamType(i)->print(out);
+    }
+    out += ')';
+    break;
+  }
+  }
+}
+
+std::string Type::toString() const {
+  std::string s;
+  print(s);
+  return s;
+}
@@ -1,11 +1,521 @@
+#include "ASTBuilder.h"
+#include "CodeGen.h"
+#include "CompileCache.h"
+#include "FastParser.h"
+#include "IRGen.h"
+#include "IRPrinter.h"
+#include "PassManager.h"
+#include "SourceFile.h"
+#include "SysYLexer.h"
+#include "SysYParser.h"
+#include "ThreadPool.h"
+#include "antlr4-runtime.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+enum class Frontend { Antlr, Fast };
+
+struct Job {
+  std::string input;
+  std::string output;
+};
+
+struct Options {
+  std::vector<Job> jobs;
+  unsigned optLevel = 2;
+  bool timePasses = false;
+  // Emit x86-64 assembly instead of LLVM IR.
+  bool emitAssembly = false;
+  Frontend frontend = Frontend::Antlr;
+  // 0 means one thread per hardware thread.
+  unsigned threads = 0;
+  // Directory of the compilation cache; empty to compile without it.
+  std::string cacheDir = getDefaultCacheDir();
+  uint64_t cacheSize = uint64_t(256) << 20;
+  bool cacheStats = false;
+};
+
+// Reads `<input> <output>` pairs separated by whitespace from a list file.
+bool readBatchFile(const char *path, std::vector<Job> &jobs) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "error: cannot open " << path << std::endl;
+    return false;
+  }
+  Job job;
+  while (in >> job.input) {
+    if (!(in >> job.output)) {
+      std::cerr << "error: " << path << ": missing output file for "
+                << job.input << std::endl;
+      return false;
+    }
+    jobs.push_back(job);
+  }
+  return true;
+}
+
+bool parseThreadCount(std::string_view arg, unsigned &threads) {
+  std::string s(arg);
+  char *end = nullptr;
+  unsigned long n = std::strtoul(s.c_str(), &end, 10);
+  if (s.empty() || *end != '\0') {
+    std::cerr << "error: invalid thread count " << arg << std::endl;
+    return false;
+  }
+  threads = static_cast<unsigned>(n);
+  return true;
+}
+
+bool parseCacheSize(std::string_view arg, uint64_t &size) {
+  std::string s(arg);
+  char *end = nullptr;
+  unsigned long long mib = std::strtoull(s.c_str(), &end, 10);
+  if (s.empty() || *end != '\0') {
+    std::cerr << "error: invalid cache size " << arg << std::endl;
+    return false;
+  }
+  size = static_cast<uint64_t>(mib) << 20;
+  return true;
+}
+
+bool parseOptions(int argc, const char *argv[], Options &opts) {
+  std::vector<const char *> files;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+      opts.optLevel = arg[2] - '0';
+    } else if (arg == "--time-passes") {
+      opts.timePasses = true;
+    } else if (arg == "-S") {
+      opts.emitAssembly = true;
+    } else if (arg == "--frontend=antlr") {
+      opts.frontend = Frontend::Antlr;
+    } else if (arg == "--frontend=fast") {
+      opts.frontend = Frontend::Fast;
+    } else if (arg == "--no-cache") {
+      opts.cacheDir.clear();
+    } else if (arg == "--cache-stats") {
+      opts.cacheStats = true;
+    } else if (arg == "--cache-dir") {
+      if (i + 1 == argc)
+        return false;
+      opts.cacheDir = argv[++i];
+    } else if (arg == "--cache-size") {
+      if (i + 1 == argc || !parseCacheSize(argv[++i], opts.cacheSize))
+        return false;
+    } else if (arg == "--batch" || arg == "-j") {
+      if (i + 1 == argc)
+        return false;
+      const char *value = argv[++i];
+      if (arg == "-j" ? !parseThreadCount(value, opts.threads)
+                      : !readBatchFile(value, opts.jobs))
+        return false;
+    } else if (arg.size() > 2 && arg.substr(0, 2) == "-j") {
+      if (!parseThreadCount(arg.substr(2), opts.threads))
+        return false;
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      std::cerr << "error: unknown option " << arg << std::endl;
+      return false;
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+  if (files.size() % 2 != 0)
+    return false;
+  for (size_t i = 0; i < files.size(); i += 2)
+    opts.jobs.push_back({files[i], files[i + 1]});
+  return !opts.jobs.empty();
+}
+
+// Wall time of the phases of one compile, reported by --time-passes next to
+// the per-pass report.
+class PhaseTimer {
+public:
+  explicit PhaseTimer(bool enabled) : enabled_(enabled) {}
+
+  // Ends the running phase, if any, and starts `name`. A phase that is
+  // started again keeps adding to its time.
+  void start(const char *name) {
+    if (!enabled_)
+      return;
+    stop();
+    current_ = 0;
+    while (current_ < phases_.size() &&
+           std::strcmp(phases_[current_].name, name) != 0)
+      ++current_;
+    if (current_ == phases_.size())
+      phases_.push_back({name, 0});
+    running_ = true;
+    start_ = Clock::now();
+  }
+  void stop() {
+    if (!running_)
+      return;
+    phases_[current_].seconds +=
+        std::chrono::duration<double>(Clock::now() - start_).count();
+    running_ = false;
+  }
+  void print(std::string &out) const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+  struct Phase {
+    const char *name;
+    double seconds;
+  };
+
+  bool enabled_;
+  bool running_ = false;
+  size_t current_ = 0;
+  Clock::time_point start_;
+  std::vector<Phase> phases_;
+};
+
+void PhaseTimer::print(std::string &out) const {
+  char line[96];
+  double total = 0;
+  for (const Phase &p : phases_)
+    total += p.seconds;
+  out += "===--- Compiler phase timing report ---===\n";
+  std::snprintf(line, sizeof(line), "%10s %6s  %s\n", "Time (ms)", "%",
+                "Phase");
+  out += line;
+  for (const Phase &p : phases_) {
+    std::snprintf(line, sizeof(line), "%10.3f %5.1f%%  %s\n",
+                  p.seconds * 1000, total > 0 ? p.seconds / total * 100 : 0.0,
+                  p.name);
+    out += line;
+  }
+  std::snprintf(line, sizeof(line), "%10.3f %5.1f%%  Total\n", total * 1000,
+                100.0);
+  out += line;
+}
+
+// Collects ANTLR's syntax errors in the format of its console listener, so
+// that they are reported together with the other diagnostics of the file.
+class SyntaxErrorCollector : public antlr4::BaseErrorListener {
+public:
+  explicit SyntaxErrorCollector(std::ostream &err) : err_(err) {}
+
+  void syntaxError(antlr4::Recognizer *, antlr4::Token *, size_t line,
+                   size_t charPositionInLine, const std::string &msg,
+                   std::exception_ptr) override {
+    err_ << "line " << line << ":" << charPositionInLine << " " << msg
+         << std::endl;
+  }
+
+private:
+  std::ostream &err_;
+};
+
+CompUnit *parseWithAntlr(const std::string &path, ASTContext &ctx,
+                         PhaseTimer &timer, std::ostream &err) {
+  std::ifstream in(path);
+  if (!in) {
+    err << "error: cannot open " << path << std::endl;
+    return nullptr;
+  }
+  SyntaxErrorCollector errors(err);
+  timer.start("lex");
+  antlr4::ANTLRInputStream input(in);
+  SysYLexer lexer(&input);
+  lexer.removeErrorListeners();
+  lexer.addErrorListener(&errors);
+  antlr4::CommonTokenStream tokens(&lexer);
+  tokens.fill();
+  timer.start("parse");
+  SysYParser parser(&tokens);
+  parser.removeErrorListeners();
+  parser.addErrorListener(&errors);
+  SysYParser::ProgramContext *tree = parser.program();
+  if (lexer.getNumberOfSyntaxErrors() || parser.getNumberOfSyntaxErrors())
+    return nullptr;
+  timer.start("ast");
+  return ASTBuilder(ctx).build(tree);
+}
+
+// The AST refers to identifiers in `source`, which must stay open until the
+// output is written. Tokens are lexed on demand while the AST is built, so
+// the "parse" phase covers all three.
+CompUnit *parseWithFastFrontend(const std::string &path, SourceFile &source,
+                                ASTContext &ctx, PhaseTimer &timer,
+                                std::ostream &err) {
+  std::string error;
+  timer.start("read");
+  if (!source.open(path.c_str(), error)) {
+    err << "error: " << error << std::endl;
+    return nullptr;
+  }
+  timer.start("parse");
+  CompUnit *unit = FastParser(source.contents(), ctx).parse(error);
+  if (!unit)
+    err << path << ": error: " << error << std::endl;
+  return unit;
+}
+
+// Key of a whole output file: the compiler, the options that affect the
+// output, and the source.
+std::string getFileKey(const Options &opts, std::string_view source) {
+  Hasher h;
+  h.update(getCompilerVersion());
+  h.update(std::string_view("file"));
+  h.update(uint64_t(opts.optLevel));
+  h.update(uint64_t(opts.emitAssembly));
+  h.update(uint64_t(opts.frontend));
+  h.update(source);
+  return h.hex();
+}
+
+// The part of the key of a function's text shared by all functions of the
+// module. Besides the function itself, the function passes and the backend
+// read the globals, whose constness and initializers fold into loads, and
+// whether each callee is defined or only declared (see addCallees).
+Hasher getFunctionContext(const Options &opts, const Module &m) {
+  Hasher h;
+  h.update(getCompilerVersion());
+  h.update(std::string_view("function"));
+  h.update(uint64_t(opts.optLevel));
+  h.update(uint64_t(opts.emitAssembly));
+  std::string type;
+  for (const GlobalVariable *g : m.globals()) {
+    type.clear();
+    g->getValueType()->print(type);
+    h.update(g->getName());
+    h.update(type);
+    h.update(uint64_t(g->isConstant()) | uint64_t(g->isPrivate()) << 1);
+    ArrayRef<int32_t> init = g->getInitializer();
+    h.update(std::string_view(reinterpret_cast<const char *>(init.data()),
+                              init.size() * sizeof(int32_t)));
+  }
+  return h;
+}
+
+// Adds the callees of `f` to its key. LICM assumes that a call to a defined
+// function may write any memory, and the backend calls declared functions
+// through the PLT, so a callee that changes between the two under the same
+// name changes the code.
+void addCallees(const Function &f, Hasher &h) {
+  for (BasicBlock *bb : f) {
+    for (Instruction *inst : *bb) {
+      if (auto *call = dyn_cast<CallInst>(inst)) {
+        h.update(call->getCallee()->getName());
+        h.update(uint64_t(call->getCallee()->isDeclaration()));
+      }
+    }
+  }
+}
+
+// Runs the pipeline and renders every function definition into `bodies`,
+// taking the text of functions that need not be optimized again from the
+// cache.
+//
+// Module passes see the whole module, so they always run. After the last
+// of them, every function only goes through function passes, which touch
+// nothing but the function they run on, so its final text depends on its
+// IR at that point, its callees and the context above alone; those are what
+// its key is made of. At -O2 the point is after inlining: an edited function misses,
+// and so do the callers it was inlined into, but not the callers that
+// still call it.
+void optimizeWithCache(const Options &opts, Module &m, PassManager &passes,
+                       ThreadPool &pool, CompileCache &cache,
+                       PhaseTimer &timer, std::vector<std::string> &bodies) {
+  size_t split = 0;
+  for (size_t i = 0; i < passes.getNumEntries(); ++i)
+    if (passes.isModulePass(i))
+      split = i + 1;
+  passes.run(m, 0, split);
+
+  timer.start("cache");
+  std::vector<Function *> definitions;
+  for (const auto &f : m.functions())
+    if (!f->isDeclaration())
+      definitions.push_back(f.get());
+  Hasher context = getFunctionContext(opts, m);
+  std::vector<std::string> keys(definitions.size());
+  std::vector<char> hit(definitions.size());
+  bodies.assign(definitions.size(), {});
+  pool.parallelFor(definitions.size(), [&](size_t i) {
+    std::string ir;
+    printFunction(*definitions[i], ir);
+    Hasher h = context;
+    h.update(ir);
+    addCallees(*definitions[i], h);
+    keys[i] = h.hex();
+    hit[i] = cache.lookup(CompileCache::Function, keys[i], bodies[i]);
+  });
+  std::vector<size_t> misses;
+  std::vector<Function *> functions;
+  for (size_t i = 0; i < definitions.size(); ++i) {
+    if (!hit[i]) {
+      misses.push_back(i);
+      functions.push_back(definitions[i]);
+    }
+  }
+
+  timer.start("optimize");
+  passes.runOnFunctions(functions, split, passes.getNumEntries());
+
+  timer.start(opts.emitAssembly ? "codegen" : "emit");
+  pool.parallelFor(misses.size(), [&](size_t k) {
+    size_t i = misses[k];
+    if (opts.emitAssembly)
+      emitFunction(*definitions[i], bodies[i]);
+    else
+      printFunction(*definitions[i], bodies[i]);
+    cache.store(keys[i], bodies[i]);
+  });
+}
+
+// Compiles one file into `text`, using `pool` for the functions of the
+// module and `cache`, if any, for their text.
+bool generate(const Options &opts, const Job &job, ThreadPool &pool,
+              CompileCache *cache, PassManager &passes, PhaseTimer &timer,
+              std::string &text, std::ostream &err) {
+  SourceFile source;
+  ASTContext astContext;
+  CompUnit *unit =
+      opts.frontend == Frontend::Fast
+          ? parseWithFastFrontend(job.input, source, astContext, timer, err)
+          : parseWithAntlr(job.input, astContext, timer, err);
+  if (!unit)
+    return false;
+
+  timer.start("irgen");
+  Module module;
+  try {
+    IRGen(module).run(unit);
+  } catch (const CompileError &e) {
+    err << job.input << ": error: " << e.what() << std::endl;
+    return false;
+  }
+
+  timer.start("optimize");
+  buildPipeline(passes, opts.optLevel);
+  passes.setTimePasses(opts.timePasses);
+  passes.setThreadPool(&pool);
+  if (cache) {
+    std::vector<std::string> bodies;
+    optimizeWithCache(opts, module, passes, pool, *cache, timer, bodies);
+    if (opts.emitAssembly)
+      emitAssembly(module, bodies, text);
+    else
+      printModule(module, bodies, text);
+    return true;
+  }
+  passes.run(module);
+
+  // Print the whole module into one buffer and write it out in one go.
+  timer.start(opts.emitAssembly ? "codegen" : "emit");
+  if (opts.emitAssembly)
+    emitAssembly(module, text, &pool);
+  else
+    printModule(module, text, &pool);
+  return true;
+}
+
+// Compiles one file, or copies its output out of `cache` if neither the
+// file nor the compiler and its options have changed. Diagnostics and the
+// timing report go to `err`.
+bool compile(const Options &opts, const Job &job, ThreadPool &pool,
+             CompileCache *cache, std::ostream &err) {
+  PhaseTimer timer(opts.timePasses);
+  PassManager passes;
+  std::string text, fileKey;
+  bool cached = false;
+  if (cache) {
+    timer.start("cache");
+    SourceFile source;
+    std::string error;
+    // A file that cannot be read is left to the front end to report.
+    if (source.open(job.input.c_str(), error)) {
+      fileKey = getFileKey(opts, source.contents());
+      cached = cache->lookup(CompileCache::File, fileKey, text);
+    }
+  }
+  if (!cached &&
+      !generate(opts, job, pool, cache, passes, timer, text, err))
+    return false;
+
+  timer.start("write");
+  std::ofstream out(job.output, std::ios::binary);
+  out.write(text.data(), text.size());
+  out.close();
+  timer.stop();
+  if (!out) {
+    err << "error: cannot write " << job.output << std::endl;
+    return false;
+  }
+  if (cache && !cached && !fileKey.empty())
+    cache->store(fileKey, text);
+
+  if (opts.timePasses) {
+    std::string report;
+    timer.print(report);
+    passes.printTimeReport(report);
+    if (opts.jobs.size() > 1)
+      err << job.input << ":\n";
+    err << report;
+  }
+  return true;
+}
+
+} // namespace
 
 int main(int argc, const char *argv[]) {
-  if (argc < 3) {
-    std::cerr << "Usage: ./compiler <input-file> <output-file>"
+  Options opts;
+  if (!parseOptions(argc, argv, opts)) {
+    std::cerr << "Usage: ./compiler [-O0|-O1|-O2] [-S] [--time-passes] "
+                 "[--frontend=antlr|fast] [-j <threads>]\n"
+                 "                  [--no-cache] [--cache-dir <dir>] "
+                 "[--cache-size <MiB>] [--cache-stats]\n"
+                 "                  <input-file> <output-file> "
+                 "[<input-file> <output-file>...]\n"
+                 "       ./compiler [options] --batch <list-file>"
               << std::endl;
     return 1;
   }
-  // TODO: Implement the main function of the compiler.
-  return 0;
-}
\ No newline at end of file
+
+  // Files are compiled in parallel, and so are the functions within each
+  // file. Diagnostics are buffered per file and printed in input order.
+  ThreadPool pool(opts.threads);
+  CompileCache cache;
+  bool useCache =
+      !opts.cacheDir.empty() && cache.open(opts.cacheDir, opts.cacheSize);
+  std::vector<std::ostringstream> diagnostics(opts.jobs.size());
+  std::vector<char> ok(opts.jobs.size());
+  pool.parallelFor(opts.jobs.size(), [&](size_t i) {
+    ok[i] = compile(opts, opts.jobs[i], pool, useCache ? &cache : nullptr,
+                    diagnostics[i]);
+  });
+
+  int status = 0;
+  for (size_t i = 0; i < opts.jobs.size(); ++i) {
+    std::cerr << diagnostics[i].str();
+    if (!ok[i])
+      status = 1;
+  }
+  if (useCache) {
+    // The directory is only scanned when it may have grown.
+    if (cache.getNumStored() || opts.cacheStats)
+      cache.evict();
+    if (opts.cacheStats) {
+      std::string report;
+      cache.printStats(report);
+      std::cerr << report;
+    }
+  } else if (opts.cacheStats) {
+    std::cerr << "compilation cache disabled" << std::endl;
+  }
+  return status;
+}